@@ -31,9 +31,28 @@
 
 
 #include "ActroidBase.h"
+#include "ActroidClient.h"
 
 using namespace RTC;
 
+/*!
+ * @class ActroidConfigListener
+ * @brief Flags a change of the active configuration set
+ */
+class ActroidConfigListener
+  : public RTC::ConfigurationSetNameListener
+{
+ public:
+  ActroidConfigListener(volatile long* pChanged) : m_pChanged(pChanged) {}
+
+  virtual void operator()(const char* /*config_set_name*/) {
+    net::ysuga::atomicStore(m_pChanged, 1);
+  }
+
+ private:
+  volatile long* m_pChanged;
+};
+
 /*!
  * @class Actroid
  * @brief Actroid RTC
@@ -82,7 +101,7 @@ class Actroid
    * 
    * 
    */
-  // virtual RTC::ReturnCode_t onFinalize();
+   virtual RTC::ReturnCode_t onFinalize();
 
   /***
    *
@@ -212,7 +231,7 @@ class Actroid
    * 
    * 
    */
-  // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
+   virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
 
 
  protected:
@@ -238,6 +257,192 @@ class Actroid
    * - DefaultValue: COM1
    */
   std::string m_port;
+  /*!
+   * Attach to the actroidd instance of this name instead of opening port
+   * (empty: open port). The daemon owns the link, so the link settings
+   * are those of the daemon; waypoints of targetTrajectory are sent to
+   * its control socket, telemetry is not available, and NaN targets
+   * always leave the joint as it is. Takes effect on activation.
+   * - Name:  daemon
+   * - DefaultValue: 
+   */
+  std::string m_daemon;
+  /*!
+   * Deadline for each controller reply [ms], or for each request to the
+   * daemon when attached to one
+   * - Name:  timeout
+   * - DefaultValue: 200
+   */
+  int m_timeout;
+  /*!
+   * Run serial set/get cycle in a background thread (1) or in onExecute (0)
+   * - Name:  io_thread
+   * - DefaultValue: 1
+   */
+  int m_ioThread;
+  /*!
+   * 1: the serial I/O runs on one thread shared by all Actroid components
+   * of the process (with io_thread), which waits on all ports at once.
+   * rt_priority and rt_cpus of the first component started set that thread.
+   * - Name:  shared_io
+   * - DefaultValue: 0
+   * - Constraint: (0,1)
+   */
+  int m_sharedIo;
+  /*!
+   * Send set and get packets with one write (1) or one by one (0)
+   * - Name:  pipeline
+   * - DefaultValue: 1
+   */
+  int m_pipeline;
+  /*!
+   * Commands kept in flight by the I/O thread (0: wait for each reply)
+   * - Name:  command_window
+   * - DefaultValue: 0
+   */
+  int m_commandWindow;
+  /*!
+   * Skip set packets when quantized targets are unchanged
+   * - Name:  suppress_unchanged
+   * - DefaultValue: 1
+   */
+  int m_suppressUnchanged;
+  /*!
+   * Resend targets at least this often even if unchanged [ms] (0: never)
+   * - Name:  keepalive
+   * - DefaultValue: 1000
+   */
+  int m_keepalive;
+  /*!
+   * Joint groups read at different rates, name:start:count:period,...
+   * e.g. arms:8:14:1,face:0:8:4,torso:22:2:4 (empty: all joints every cycle)
+   * - Name:  read_groups
+   * - DefaultValue: 
+   */
+  std::string m_readGroups;
+  /*!
+   * Priority lanes for target writes, name:start:count:deadline[ms],...
+   * e.g. face:0:5:0,body:5:19:50 (empty: send every change at once)
+   * - Name:  write_lanes
+   * - DefaultValue: 
+   */
+  std::string m_writeLanes;
+  /*!
+   * Angle limits overriding those of the model, joint:min:max [rad],...
+   * e.g. 8:-1.2:1.5 (empty: limits of the model)
+   * - Name:  calibration
+   * - DefaultValue: 
+   */
+  std::string m_calibration;
+  /*!
+   * Period of telemetry output [ms] (0: no telemetry)
+   * - Name:  telemetry_period
+   * - DefaultValue: 1000
+   */
+  int m_telemetryPeriod;
+  /*!
+   * Record serial traffic to this file (empty: no trace)
+   * - Name:  trace_file
+   * - DefaultValue: 
+   */
+  std::string m_traceFile;
+  /*!
+   * Number of 64 byte records kept in the trace file
+   * - Name:  trace_capacity
+   * - DefaultValue: 65536
+   */
+  int m_traceCapacity;
+  /*!
+   * Interpolation between waypoints of targetTrajectory
+   * - Name:  trajectory_interpolation
+   * - DefaultValue: cubic
+   * - Constraint: (linear,cubic)
+   */
+  std::string m_trajectoryInterpolation;
+  /*!
+   * 1: NaN in targetJoint and targetFace leaves the joint unchanged, and
+   * queued samples are merged joint by joint
+   * - Name:  partial_update
+   * - DefaultValue: 0
+   * - Constraint: (0,1)
+   */
+  int m_partialUpdate;
+  /*!
+   * 1: currentJoint carries angles predicted for the time of output
+   * instead of the last received ones
+   * - Name:  estimator
+   * - DefaultValue: 0
+   * - Constraint: (0,1)
+   */
+  int m_estimator;
+  /*!
+   * Weight of a measurement on the estimated angle
+   * - Name:  estimator_alpha
+   * - DefaultValue: 0.5
+   */
+  double m_estimatorAlpha;
+  /*!
+   * Weight of a measurement on the estimated velocity
+   * - Name:  estimator_beta
+   * - DefaultValue: 0.1
+   */
+  double m_estimatorBeta;
+  /*!
+   * Longest prediction after the last measurement [s]
+   * - Name:  estimator_horizon
+   * - DefaultValue: 0.1
+   */
+  double m_estimatorHorizon;
+  /*!
+   * SCHED_FIFO priority of the I/O thread (0: default scheduling)
+   * - Name:  rt_priority
+   * - DefaultValue: 0
+   * - Constraint: 0<=x<=99
+   */
+  int m_rtPriority;
+  /*!
+   * CPUs the I/O thread is pinned to, e.g. 3 or 2-3 (empty: any)
+   * - Name:  rt_cpus
+   * - DefaultValue: 
+   */
+  std::string m_rtCpus;
+  /*!
+   * 1: lock the memory mapped by the process (mlockall) when the I/O thread starts
+   * - Name:  rt_lock_memory
+   * - DefaultValue: 0
+   * - Constraint: (0,1)
+   */
+  int m_rtLockMemory;
+  /*!
+   * Stack touched by the I/O thread before its first cycle [KB]
+   * - Name:  rt_stack_prefault
+   * - DefaultValue: 64
+   * - Constraint: 0<=x<=512
+   */
+  int m_rtStackPrefault;
+  /*!
+   * Times a packet rejected by the controller (NACK) is sent again
+   * - Name:  nack_retries
+   * - DefaultValue: 2
+   * - Constraint: 0<=x<=10
+   */
+  int m_nackRetries;
+  /*!
+   * Wait before the second reconnect attempt after a link error [ms],
+   * doubled after each further failure
+   * - Name:  reconnect_min
+   * - DefaultValue: 10
+   * - Constraint: x>=1
+   */
+  int m_reconnectMin;
+  /*!
+   * Longest wait between reconnect attempts [ms] (0: no recovery, errors
+   * are raised from onExecute)
+   * - Name:  reconnect_max
+   * - DefaultValue: 1000
+   * - Constraint: x>=0
+   */
+  int m_reconnectMax;
 
   // </rtc-template>
 
@@ -251,6 +456,22 @@ class Actroid
    * RightElbow, LeftShoulderPitch, LeftShoulderYaw, LeftElbow...
    */
   InPort<RTC::TimedDoubleSeq> m_targetJointIn;
+  RTC::TimedDoubleSeq m_targetFace;
+  /*!
+   * Target Face Angle [rad] for lip-sync and expression
+   * Sequence =
+   * Brow, Eyelid, EyeYaw, EyePitch, Mouth (CH1 - CH5)
+   */
+  InPort<RTC::TimedDoubleSeq> m_targetFaceIn;
+  RTC::TimedDoubleSeq m_targetTrajectory;
+  /*!
+   * Timed waypoints, interpolated at the rate of the serial link
+   * Sequence =
+   * for each waypoint: time [s] from reception, then one angle [rad]
+   * per joint in the order of targetJoint. Empty sequence stops the
+   * trajectory. While it runs, targetJoint and targetFace are ignored.
+   */
+  InPort<RTC::TimedDoubleSeq> m_targetTrajectoryIn;
   
   // </rtc-template>
 
@@ -265,6 +486,25 @@ class Actroid
    * RightElbow, LeftShoulderPitch, LeftShoulderYaw, LeftElbow...
    */
   OutPort<RTC::TimedDoubleSeq> m_currentJointOut;
+  RTC::TimedDoubleSeq m_currentJointState;
+  /*!
+   * Freshness of currentJoint, written with it
+   * Sequence =
+   * age [s] of each joint since it was received (-1: never),
+   * then variance [rad^2] of the estimator innovation of each joint,
+   * then stale (1 while the link is recovering and angles are last known)
+   */
+  OutPort<RTC::TimedDoubleSeq> m_currentJointStateOut;
+  RTC::TimedDoubleSeq m_telemetry;
+  /*!
+   * Latency of each stage and error counters, every telemetry_period
+   * Sequence =
+   * for each stage write, ack, read, cycle, convert, publish, execute, jitter:
+   *   count, p50 [us], p99 [us], p999 [us], max [us] (since last output),
+   * then nack, timeout, frame_error, suppressed, io_cycle, dropped_samples,
+   * resync, reconnect (since activation)
+   */
+  OutPort<RTC::TimedDoubleSeq> m_telemetryOut;
   
   // </rtc-template>
 
@@ -293,7 +533,122 @@ class Actroid
   // </rtc-template>
 
 
+  /**
+   * Open from the first activation until finalization, so that the
+   * controller stays online between activations.
+   */
   ogata_lab::ActroidBase *m_pActroid;
+
+  /**
+   * Used instead of m_pActroid while the daemon configuration is set.
+   */
+  ogata_lab::ActroidClient *m_pClient;
+
+  /**
+   * Set by ActroidConfigListener; the configuration is applied by the next onExecute.
+   */
+  volatile long m_configChanged;
+
+  /**
+   * Settings applied by configureLayout(), as returned by layout().
+   */
+  std::string m_appliedLayout;
+  std::string m_appliedTraceFile;
+  int m_appliedTraceCapacity;
+
+  uint64_t m_telemetryTime;
+  ogata_lab::HistogramSnapshot m_telemetryLast[ogata_lab::NUM_STAGE];
+  ogata_lab::HistogramSnapshot m_telemetryInterval;
+
+  /**
+   * Input samples replaced by a newer one before they were applied.
+   */
+  long m_droppedSamples;
+
+  /**
+   * Link failed without I/O thread; reconnect is tried at m_reconnectTime.
+   */
+  bool m_linkDown;
+  int m_reconnectBackoff;
+  uint64_t m_reconnectTime;
+
+  /**
+   * Send targets (if updated) and receive current angles, or try to
+   * reconnect when the link is down.
+   */
+  void updateLink(const bool updated);
+
+  /**
+   * onExecute with the daemon: pass targets to it and publish its angles.
+   */
+  void executeClient();
+
+  /**
+   * Write every sample queued on inport to the targets of joints
+   * [offset, offset+size) of the daemon.
+   */
+  void forwardTargets(InPort<RTC::TimedDoubleSeq>& inport, RTC::TimedDoubleSeq& data,
+                      const int offset, const int size);
+
+  /**
+   * Apply settings which may change while the I/O thread runs.
+   */
+  void configure();
+
+  /**
+   * Apply settings which need the I/O thread stopped: port, timeout, command
+   * window, read groups, write lanes, calibration, rt options and trace. A
+   * changed port is reopened; otherwise the link is left as it is.
+   */
+  void configureLayout();
+
+  /**
+   * Settings applied by configureLayout(), as one string to detect changes.
+   */
+  std::string layout() const;
+
+  /**
+   * Set the configuration variables of the layout from a string of layout().
+   */
+  void setLayout(const std::string& layout);
+
+  /**
+   * Apply changed configuration, restarting the I/O thread only if the layout changed.
+   * If the new layout can not be applied, the link is restarted with the previous one.
+   */
+  void reconfigure();
+
+  /**
+   * Apply changed configuration with the daemon: the timeout of requests
+   * only, the others are warned about.
+   */
+  void reconfigureClient();
+
+  /**
+   * Start the I/O thread, or without it, reconnect in updateLink() if the link is down.
+   */
+  void startLink();
+
+  /**
+   * Warn if a silent controller would overrun the period of the context.
+   */
+  void checkRate(RTC::UniqueId ec_id);
+
+  void publishTelemetry(const uint64_t now);
+
+  /**
+   * Hand waypoints received on targetTrajectory to ActroidBase, or to
+   * the daemon.
+   */
+  void submitTrajectory();
+
+  /**
+   * Read every sample queued on inport and set targets of joints
+   * [offset, offset+size) from the newest one (merged when partial_update).
+   * @return true if any sample was read.
+   */
+  bool readTargets(InPort<RTC::TimedDoubleSeq>& inport, RTC::TimedDoubleSeq& data,
+                   const int offset, const int size);
 };
 
 
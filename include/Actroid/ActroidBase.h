@@ -14,9 +14,22 @@
 #include <string>
 #include <exception>
 
+#include "SnapshotBuffer.h"
+#include "CommandQueue.h"
+#include "ReplyParser.h"
+#include "ReadScheduler.h"
+#include "WriteScheduler.h"
+#include "JointCalibration.h"
+#include "ActroidModel.h"
+#include "Telemetry.h"
+#include "Trajectory.h"
+#include "JointEstimator.h"
+
 namespace net {
   namespace ysuga { 
+    class Transport;
     class SerialPort;
+    class TraceRecorder;
   };
 };
 
@@ -37,58 +50,206 @@ namespace ogata_lab {
     }
 
   };
+
+  /**
+   * Thrown when the controller does not answer before the deadline.
+   */
+  class ActroidTimeoutException : public ActroidException {
+  public:
+    ActroidTimeoutException(const char* msg) : ActroidException(msg) {
+    }
+
+    ~ActroidTimeoutException() throw() {
+    }
+  };
+
+  /**
+   * Thrown when the controller rejects a packet (NACK) more often than the
+   * retries allow.
+   */
+  class ActroidNackException : public ActroidException {
+  public:
+    ActroidNackException(const char* msg) : ActroidException(msg) {
+    }
+
+    ~ActroidNackException() throw() {
+    }
+  };
   
-#define BAUDRATE 115200
-#define NUM_JOINT 24
-#define DEFAULT_RAW_ANGLE (255/2)
+#define DEFAULT_TIMEOUT_MS 200
+#define DEFAULT_KEEPALIVE_MS 1000
+#define DEFAULT_RECONNECT_MIN_MS 10
 
   /**
-  [CH1]眉上下,173,128,0,255
-    [CH2]瞼開閉,0,0,0,255
-    [CH3]眼左右,181,128,0,255
-    [CH4]眼上下,128,128,0,255
-    [CH5]口開閉,0,0,0,255
-    [CH6]首左伸,128,128,0,255
-    [CH7]首右伸,128,128,0,255
-    [CH8]首旋回,128,128,0,255
-    [CH9]左腕上,128,128,0,255
-    [CH10]左腕開,127,128,0,255
-    [CH11]左上腕,128,128,0,255
-    [CH12]左肘,128,128,0,255
-    [CH13]左前腕,128,128,0,255
-    [CH14]左手縦,128,128,0,255
-    [CH15]左手横,128,128,0,255
-    [CH16]右腕上,128,128,0,255
-    [CH17]右腕開,128,128,0,255
-    [CH18]右上腕,128,128,0,255
-    [CH19]右肘,128,128,0,255
-    [CH20]右前腕,128,128,0,255
-    [CH21]右手縦,128,128,0,255
-    [CH22]右手横,128,128,0,255
-    [CH23]胴前後,0,0,0,255
-    [CH24]胴旋回,128,128,0,255
-  **/
-
-  class ActroidBase {
+   * Raw target angles exchanged with the I/O thread.
+   */
+  template<int NumJoint>
+  struct RawTargetFrame {
+    uint8_t angle[NumJoint];
+  };
+
+  /**
+   * Raw joint angle packet (count + angles) exchanged with the I/O thread,
+   * with the reception time of each angle and the targets commanded then.
+   */
+  template<int NumJoint>
+  struct RawCurrentFrame {
+    uint8_t angle[NumJoint+1];
+    uint8_t target[NumJoint];
+    uint64_t time[NumJoint];
+  };
+
+  template<class Model>
+  class ActroidIoThread;
+
+  template<class Model>
+  class ActroidReactorClient;
+
+  class ActroidReactor;
+
+  /**
+   * Controller of one Actroid, specialized for a robot model at compile time.
+   *
+   * Model is a traits type such as ActroidModel. Packet sizes and
+   * conversion loops are sized by Model::NUM_JOINT, so they are fixed at
+   * compile time. Member functions are defined in ActroidBase.cpp and
+   * instantiated there for each model.
+   */
+  template<class Model>
+  class ActroidBaseT {
+    friend class ActroidIoThread<Model>;
+    friend class ActroidReactorClient<Model>;
+  public:
+    enum {
+      NUM_JOINT = Model::NUM_JOINT,
+      FACE_JOINT_START = Model::FACE_JOINT_START,
+      NUM_FACE_JOINT = Model::NUM_FACE_JOINT
+    };
+
+    typedef Model model_type;
+
+  private:
+    // a set packet (header, angles, checksum, stop) and a get reply must fit in a Command.
+    typedef char _packet_size_check[(NUM_JOINT + 5 <= COMMAND_MAX_PACKET && NUM_JOINT + 1 <= COMMAND_MAX_REPLY) ? 1 : -1];
+
   private:
+    net::ysuga::Transport* m_pTransport;
+    bool m_OwnTransport;
     net::ysuga::SerialPort* m_pSerialPort;
+    net::ysuga::TraceRecorder* m_pTrace;
+    std::string m_PortName;
     uint8_t m_CurrentRawAngle[NUM_JOINT+1];
+    uint64_t m_CurrentTime[NUM_JOINT];
     uint8_t m_TargetRawAngle[NUM_JOINT];
+    uint8_t m_CommandedRawAngle[NUM_JOINT];
+    uint8_t m_IoFrame[NUM_JOINT+1];
+    uint64_t m_IoTime[NUM_JOINT];
+    RawTargetFrame<NUM_JOINT> m_IoTarget;
+    JointCalibration<NUM_JOINT> m_Calibration;
+    JointEstimator<NUM_JOINT> m_Estimator;
+    ReadScheduler m_ReadScheduler;
+    WriteScheduler m_WriteScheduler;
+    ReplyParser m_Parser;
+    int m_Timeout;
+    bool m_Pipelined;
+
+    bool m_SuppressUnchanged;
+    int m_KeepAlive;
+    uint8_t m_LastWrittenRawAngle[NUM_JOINT];
+    bool m_LastWriteValid;
+    uint64_t m_LastWriteTime;
+    volatile long m_SuppressedCount;
+
+    CommandQueue* m_pCommandQueue;
+    int m_CommandWindow;
+    const char* m_pCommandError;
+    bool m_CommandTimeout;
+    int m_SetInFlight;
+    bool m_SetRejected;
+    bool m_PendingSet;
+    long m_QueueFrameErrors;
+    long m_QueueResyncs;
+    uint64_t m_LastCycleTime;
+
+    int m_NackRetries;
+    int m_NackRun;
+    int m_ReconnectMin;
+    int m_ReconnectMax;
+    volatile long m_Stale;
+
+    Telemetry m_Telemetry;
+
+    ActroidIoThread<Model>* m_pIoThread;
+    ActroidReactor* m_pReactor;
+    ActroidReactorClient<Model>* m_pReactorClient;
+    bool m_Recovering;
+    uint64_t m_RetryTime;
+    int m_Backoff;
+    int m_IoPriority;
+    uint64_t m_IoCpuMask;
+    bool m_LockMemory;
+    int m_StackPrefault;
+    volatile long m_IoRunning;
+    volatile long m_IoFailed;
+    volatile long m_IoCycleCount;
+    std::string m_IoErrorMessage;
+    SnapshotBuffer<RawTargetFrame<NUM_JOINT> > m_TargetBuffer;
+    SnapshotBuffer<RawCurrentFrame<NUM_JOINT> > m_CurrentBuffer;
+
+    SnapshotBuffer<TrajectoryFrame<NUM_JOINT> > m_TrajectoryBuffer;
+    TrajectoryPlayer<NUM_JOINT> m_Trajectory;
+    volatile long m_TrajectorySubmitted;
+    volatile long m_TrajectoryFinished;
   private:
+    void _initialize() throw(ActroidException);
     void _writePacket(const uint8_t* packet, const int len) throw(ActroidException);
-    void _readRawAngle() throw(ActroidException);
-    void _writeRawAngle() throw(ActroidException);
+    ReplyStatus _readReply(const int replySize, uint8_t* reply, const char* timeoutMessage) throw(ActroidException);
+    void _readAck() throw(ActroidException);
+    void _readRawAngle(uint8_t* frame, uint64_t* time, const int start, const int count) throw(ActroidException);
+    void _writeRawAngle(const uint8_t* target) throw(ActroidException);
+    void _writeReadRawAngle(const uint8_t* target, uint8_t* frame, uint64_t* time, const int start, const int count) throw(ActroidException);
+    void _cycle(const uint8_t* target, const bool write, uint8_t* frame, uint64_t* time) throw(ActroidException);
+    void _publishCurrent();
+    void _updateEstimator();
+    bool _isWriteRequired(const uint8_t* target, const bool requested);
+    bool _stepTrajectory(uint8_t* target);
+    void _onWriteAcked(const uint8_t* target);
+    void _applyRealtime();
+    void _prepareIo();
+    void _setBlocking();
+    void _ioLoop();
+    void _ioLoopSync();
+    void _beginWindow(const int window);
+    void _fillWindow();
+    void _countQueueErrors();
+    void _ioLoopWindowed();
+    bool _stepReactor(const uint64_t now, const bool error, uint64_t& wakeup, bool& relinked);
+    bool _recover();
+    void _reconnect(const uint8_t* target) throw(ActroidException);
+    void _reopenLink() throw(ActroidException);
+    bool _isIoActive() const {
+      return m_pIoThread != NULL || m_pReactor != NULL;
+    }
+    static void _onOnlineDone(const Command* command, void* userData);
+    static void _onSetDone(const Command* command, void* userData);
+    static void _onGetDone(const Command* command, void* userData);
 
   public:
     /**
-     *
+     * Open serial port portName at the baud rate of the model.
      */
-    ActroidBase(const char* portName) throw(ActroidException);
+    ActroidBaseT(const char* portName) throw(ActroidException);
+
+    /**
+     * Use pTransport (e.g. LoopbackTransport) instead of a serial port.
+     * The transport is not deleted by ActroidBaseT.
+     */
+    ActroidBaseT(net::ysuga::Transport* pTransport) throw(ActroidException);
 
     /**
      *
      */
-    ~ActroidBase() throw (ActroidException);
+    ~ActroidBaseT() throw (ActroidException);
 
     /**
      *
@@ -102,6 +263,13 @@ namespace ogata_lab {
 		return m_TargetRawAngle[index];
 	}
 
+    /**
+     * Set raw target without conversion (e.g. to replay recorded packets).
+     */
+    void setTargetRawAngle(const int index, const uint8_t raw) {
+      m_TargetRawAngle[index] = raw;
+    }
+
     /**
      *
      */
@@ -109,14 +277,366 @@ namespace ogata_lab {
 
     double getCurrentAngle(const int index);
 
-    void updateTargetAngles() {
-      this->_writeRawAngle();
+    /**
+     * Set target angles [rad] of joints [0, n) at once.
+     */
+    void setTargetAngles(const double* angles, const int n);
+
+    /**
+     * Get current angles [rad] of joints [0, n) at once.
+     */
+    void getCurrentAngles(double* angles, const int n);
+
+    /**
+     * Current angles [rad] of joints [0, n) predicted for now.
+     *
+     * Angles measured by update*Angles() are filtered per joint (alpha-beta)
+     * and extrapolated with their velocity, so they can be taken more often
+     * than the link delivers them; in I/O thread mode at any rate without
+     * blocking. Extrapolation stops at the commanded target and after the
+     * prediction horizon.
+     * @param age time [s] since each joint was measured, -1 if never (may be NULL)
+     * @param variance mean squared innovation [rad^2] of each joint (may be NULL)
+     */
+    void getEstimatedAngles(double* angles, double* age, double* variance, const int n);
+
+    /**
+     * Gains of the estimator. See JointEstimator::setGains().
+     */
+    void setEstimatorGains(const double alpha, const double beta) {
+      m_Estimator.setGains(alpha, beta);
+    }
+
+    /**
+     * Longest extrapolation [s] of getEstimatedAngles() (default 0.1).
+     */
+    void setEstimatorHorizon(const double horizon) {
+      m_Estimator.setHorizon(horizon);
+    }
+
+    /**
+     * Send target angles. In I/O thread mode, this only hands them to the thread.
+     */
+    void updateTargetAngles() throw(ActroidException);
+
+    /**
+     * Receive current angles. In I/O thread mode, this only copies the newest
+     * angles received by the thread, and rethrows the error which stopped the thread.
+     */
+    void updateCurrentAngles() throw(ActroidException);
+
+    /**
+     * Receive current angles of joints [start, start+count) only.
+     * Not available in I/O thread mode.
+     */
+    void updateCurrentAngles(const int start, const int count) throw(ActroidException);
+
+    /**
+     * Receive current angles of the named joint group.
+     */
+    void updateCurrentAngles(const char* groupName) throw(ActroidException);
+
+    /**
+     * Set joint groups read by each cycle, e.g. "arms:8:14:1,face:0:8:4,torso:22:2:4"
+     * (name:start:count:period). Groups due in a cycle are read with one get packet.
+     * Empty spec reads all joints every cycle. Set before startIoThread().
+     */
+    void setReadSchedule(const char* spec) throw(ActroidException);
+
+    /**
+     * Override angle limits of joints, e.g. "8:-1.2:1.5,9:-0.5:0.5"
+     * (joint:min:max [rad], raw values 0 and 255). Other joints keep the
+     * limits of the model, so an empty spec restores them. Raw targets
+     * are kept, so the joints do not move until new targets are set.
+     * Not while I/O thread is running.
+     */
+    void setCalibration(const char* spec) throw(ActroidException);
+
+    const ReadScheduler& getReadScheduler() const {
+      return m_ReadScheduler;
+    }
+
+    /**
+     * Set priority lanes for target writes, e.g. "face:0:5:0,body:5:19:50"
+     * (name:start:count:deadline[ms]). A changed lane is sent when it has
+     * waited for its deadline, so face channels go out on the next link slot
+     * while body changes are coalesced. Empty spec sends every change at once.
+     * Set before startIoThread().
+     */
+    void setWriteLanes(const char* spec) throw(ActroidException);
+
+    const WriteScheduler& getWriteScheduler() const {
+      return m_WriteScheduler;
+    }
+
+    /**
+     * Move along waypoints instead of the targets set by setTargetAngle().
+     *
+     * Waypoint i is reached time[i] seconds after this call, with angles
+     * [rad] angles[i*NUM_JOINT, (i+1)*NUM_JOINT). The motion starts from the
+     * angles commanded now, and the targets are interpolated on every
+     * cycle: by the I/O thread at the rate of the link, or by
+     * updateAngles(), updateTargetAngles() and updateCurrentAngles() without
+     * it. A new trajectory replaces the running one. Targets from
+     * setTargetAngle() are ignored until the last waypoint is reached or
+     * stopTrajectory() is called; the last waypoint stays the target.
+     * @param count 1 to TRAJECTORY_MAX_WAYPOINTS
+     * @throw ActroidException if times do not increase or an angle is NaN or infinite
+     */
+    void setTrajectory(const double* time, const double* angles, const int count,
+                       const Interpolation interpolation) throw(ActroidException);
+
+    /**
+     * Stop the trajectory where it is now.
+     */
+    void stopTrajectory();
+
+    bool isTrajectoryActive() {
+      return net::ysuga::atomicLoad(&m_TrajectorySubmitted) != net::ysuga::atomicLoad(&m_TrajectoryFinished);
+    }
+
+    /**
+     * Send target angles and receive current angles.
+     * In pipelined mode both packets are sent with one write.
+     */
+    void updateAngles() throw(ActroidException);
+
+    /**
+     * Pipelined mode sends set and get packets back-to-back and waits for
+     * their replies once, instead of waiting for the ack of each packet.
+     */
+    void setPipelined(const bool on) {
+      m_Pipelined = on;
+    }
+
+    bool isPipelined() const {
+      return m_Pipelined;
+    }
+
+    /**
+     * Skip set packets whose raw targets equal the last acknowledged ones.
+     */
+    void setSuppressUnchanged(const bool on) {
+      m_SuppressUnchanged = on;
+    }
+
+    bool isSuppressUnchanged() const {
+      return m_SuppressUnchanged;
+    }
+
+    /**
+     * Resend targets when no set packet has been acknowledged for this period [ms].
+     * 0 disables keep-alive.
+     */
+    void setKeepAliveInterval(const int intervalMs) {
+      m_KeepAlive = intervalMs;
+    }
+
+    int getKeepAliveInterval() const {
+      return m_KeepAlive;
     }
 
-    void updateCurrentAngles() {
-      this->_readRawAngle();
+    /**
+     * Number of set packets skipped because targets did not change.
+     */
+    long getSuppressedFrameCount() {
+      return net::ysuga::atomicLoad(&m_SuppressedCount);
+    }
+
+    /**
+     * Number of commands the I/O thread keeps in flight (0: no command queue).
+     * With a window, the thread does not wait for each reply before sending
+     * the next get (or set) packet. Takes effect on the next startIoThread().
+     */
+    void setCommandWindow(const int window) {
+      m_CommandWindow = window;
+    }
+
+    int getCommandWindow() const {
+      return m_CommandWindow;
+    }
+
+    /**
+     * Run the I/O thread under SCHED_FIFO at priority 1-99 (0: default
+     * scheduling). Takes effect on the next startIoThread(). If the process
+     * is not permitted (CAP_SYS_NICE or RLIMIT_RTPRIO on Linux), the thread
+     * runs with default scheduling and a warning is printed. The thread
+     * cycles as fast as the link allows, so give it a CPU of its own
+     * (setIoThreadAffinity()) or it can starve the caller.
+     */
+    void setIoThreadPriority(const int priority) throw(ActroidException);
+
+    int getIoThreadPriority() const {
+      return m_IoPriority;
+    }
+
+    /**
+     * Pin the I/O thread to CPUs, e.g. "3" or "2-3" (empty: any CPU).
+     * Takes effect on the next startIoThread(), with a warning if it fails.
+     */
+    void setIoThreadAffinity(const char* cpus) throw(ActroidException);
+
+    /**
+     * Lock the memory mapped by the process (mlockall) when the I/O thread
+     * starts, so that it does not wait for page-ins. The control cycle does
+     * not allocate, so later mappings are left unlocked. A warning is
+     * printed if the process is not permitted.
+     */
+    void setLockMemory(const bool on) {
+      m_LockMemory = on;
+    }
+
+    bool isLockMemory() const {
+      return m_LockMemory;
+    }
+
+    /**
+     * Stack [KB] the I/O thread touches before its first cycle, 0 to 512 (0: none).
+     */
+    void setStackPrefault(const int kiloBytes) throw(ActroidException);
+
+    /**
+     * Start background I/O thread which repeats set/get cycle as fast as the link allows.
+     */
+    void startIoThread() throw(ActroidException);
+
+    /**
+     * Let pReactor drive the link instead of a thread of its own, so that
+     * one thread serves several controllers. The link runs the windowed
+     * cycle (a command window of 0 is run as 1) and recovers from errors
+     * as the I/O thread does, but without blocking: the reactor waits on
+     * all ports at once, so a slow or dead controller adds no latency to
+     * the others. The serial port is non-blocking meanwhile, also when
+     * it is reopened. Real-time options are those of the reactor. Everything
+     * else, including telemetry, is kept per instance as with the I/O
+     * thread. Stopped by stopIoThread().
+     */
+    void startIoThread(ActroidReactor* pReactor) throw(ActroidException);
+
+    /**
+     * Stop background I/O thread (or detach from the reactor). Serial port is accessed synchronously again.
+     */
+    void stopIoThread();
+
+    bool isIoThreadRunning() const {
+      return _isIoActive();
+    }
+
+    /**
+     * Number of get cycles completed by I/O thread.
+     */
+    long getIoCycleCount() {
+      return net::ysuga::atomicLoad(&m_IoCycleCount);
+    }
+
+    /**
+     * Stage latencies (write, ack, read, cycle) and NACK, timeout, frame
+     * error and resync counters. A reply broken on the line (e.g. a byte
+     * dropped) counts as a frame error and leaves the angles of that cycle
+     * unchanged; stray bytes around replies are skipped and count as resyncs. Stages are timed after getTelemetry().setEnabled(true).
+     * Other stages may be recorded by the caller.
+     */
+    Telemetry& getTelemetry() {
+      return m_Telemetry;
+    }
+
+    /**
+     * Record serial traffic to a ring file of capacity records (64 bytes each)
+     * until stopTrace(). A running trace is replaced. Only available with
+     * the serial port constructor, and not while I/O thread is running.
+     * The file can be replayed with actroid_replay.
+     */
+    void startTrace(const char* fileName, const int capacity) throw(ActroidException);
+
+    /**
+     * Stop recording and close the trace file. Not while I/O thread is running.
+     */
+    void stopTrace() throw(ActroidException);
+
+    bool isTracing() const {
+      return m_pTrace != NULL;
+    }
+
+    /**
+     * Send a packet again when the controller rejects it (NACK), up to
+     * retries times in a row (default 0). ActroidNackException is thrown
+     * when the retries are used up.
+     */
+    void setNackRetries(const int retries) {
+      m_NackRetries = retries < 0 ? 0 : retries;
+    }
+
+    int getNackRetries() const {
+      return m_NackRetries;
+    }
+
+    /**
+     * Let the I/O thread recover from link errors instead of stopping.
+     *
+     * On an error (write error, NACKs beyond the retries, timeout) the
+     * thread reopens the serial port (drops the received bytes of an
+     * injected transport), puts the controller online, sends the targets
+     * and carries on. A failed attempt is repeated after minMs, then
+     * after twice as long each time up to maxMs, until it succeeds or the
+     * thread is stopped. Meanwhile updateCurrentAngles() returns the last
+     * angles without throwing and isStale() is true.
+     * @param maxMs longest backoff [ms]. 0 disables recovery (default):
+     * the thread stops and its error is rethrown.
+     */
+    void setReconnectBackoff(const int minMs, const int maxMs) {
+      m_ReconnectMin = minMs < 1 ? 1 : minMs;
+      m_ReconnectMax = maxMs <= 0 ? 0 : (maxMs < m_ReconnectMin ? m_ReconnectMin : maxMs);
+    }
+
+    /**
+     * true while the I/O thread is recovering the link, so current angles are not updated.
+     */
+    bool isStale() {
+      return net::ysuga::atomicLoad(&m_Stale) != 0;
+    }
+
+    /**
+     * Reopen the link as the I/O thread does when recovering, for use
+     * without I/O thread. Not while I/O thread is running.
+     */
+    void reconnect() throw(ActroidException);
+
+    /**
+     * Close the serial port and open portName instead, keeping targets,
+     * settings and the trace. If it fails, the link is down until
+     * reconnect() (or the I/O thread) opens portName. Only with the
+     * serial port constructor, and not while I/O thread is running.
+     */
+    void reopen(const char* portName) throw(ActroidException);
+
+    const std::string& getPortName() const {
+      return m_PortName;
+    }
+
+    /**
+     * false after the port failed to reopen, until a reconnect succeeds.
+     */
+    bool isConnected() const {
+      return m_pTransport != NULL;
+    }
+
+    /**
+     * Set deadline [ms] for each ack and joint angle packet.
+     * ActroidTimeoutException is thrown when the controller is silent longer than this.
+     */
+    void setTimeout(const int timeoutMs) {
+      m_Timeout = timeoutMs;
+    }
+
+    int getTimeout() const {
+      return m_Timeout;
     }
     
   };
 
+  /**
+   * Controller of the 24 channel Actroid.
+   */
+  typedef ActroidBaseT<ActroidModel> ActroidBase;
+
 };
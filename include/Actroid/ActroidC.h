@@ -0,0 +1,109 @@
+/**
+ * @file ActroidC.h
+ * @brief C interface of ActroidBase, for controllers linking ActroidCore directly
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ *
+ * Functions returning int return 0 on success and -1 on error; the
+ * message of the last error of a handle is returned by actroid_error().
+ * A handle must not be used by two threads at once. Angles are in [rad].
+ */
+
+#ifndef ACTROID_C_HEADER_INCLUDED
+#define ACTROID_C_HEADER_INCLUDED
+
+#ifndef ACTROID_C_API
+#if defined(WIN32) && defined(ACTROID_CORE_EXPORTS)
+#define ACTROID_C_API __declspec(dllexport)
+#else
+#define ACTROID_C_API
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  typedef struct actroid actroid_t;
+
+  /**
+   * Open serial port port_name (ActroidBase).
+   * @param error receives the message if it fails (may be NULL)
+   * @return NULL on error
+   */
+  ACTROID_C_API actroid_t* actroid_open(const char* port_name, char* error, int error_size);
+
+  /**
+   * Open an ActroidSimulator in this process instead of a serial port, to
+   * run a controller without the robot.
+   * @return NULL on error
+   */
+  ACTROID_C_API actroid_t* actroid_open_simulator(char* error, int error_size);
+
+  /**
+   * Stop the I/O thread, close the port and free the handle.
+   */
+  ACTROID_C_API void actroid_close(actroid_t* actroid);
+
+  ACTROID_C_API const char* actroid_error(const actroid_t* actroid);
+
+  ACTROID_C_API int actroid_num_joint(void);
+
+  ACTROID_C_API int actroid_set_timeout(actroid_t* actroid, int timeout_ms);
+
+  ACTROID_C_API int actroid_set_command_window(actroid_t* actroid, int window);
+
+  /**
+   * See ActroidBaseT::setReconnectBackoff(); max_ms 0 disables recovery.
+   */
+  ACTROID_C_API int actroid_set_reconnect_backoff(actroid_t* actroid, int min_ms, int max_ms);
+
+  ACTROID_C_API int actroid_start_io_thread(actroid_t* actroid);
+
+  ACTROID_C_API int actroid_stop_io_thread(actroid_t* actroid);
+
+  /**
+   * Set targets of joints [0, n); sent by the next actroid_update_*().
+   */
+  ACTROID_C_API int actroid_set_target_angles(actroid_t* actroid, const double* angles, int n);
+
+  ACTROID_C_API int actroid_set_target_angle(actroid_t* actroid, int index, double angle);
+
+  /**
+   * Send targets and receive current angles (only hand them over and
+   * copy the newest ones with the I/O thread).
+   */
+  ACTROID_C_API int actroid_update_angles(actroid_t* actroid);
+
+  ACTROID_C_API int actroid_update_current_angles(actroid_t* actroid);
+
+  /**
+   * Angles received by the last actroid_update_*().
+   */
+  ACTROID_C_API int actroid_get_current_angles(actroid_t* actroid, double* angles, int n);
+
+  /**
+   * See ActroidBaseT::getEstimatedAngles(); age and variance may be NULL.
+   */
+  ACTROID_C_API int actroid_get_estimated_angles(actroid_t* actroid, double* angles,
+                                                 double* age, double* variance, int n);
+
+  /**
+   * Move along count waypoints: time[i] [s] from now, angles
+   * [i*num_joint, (i+1)*num_joint). cubic 0 interpolates linearly.
+   */
+  ACTROID_C_API int actroid_set_trajectory(actroid_t* actroid, const double* time,
+                                           const double* angles, int count, int cubic);
+
+  /**
+   * 1 while the I/O thread recovers the link, 0 otherwise.
+   */
+  ACTROID_C_API int actroid_is_stale(actroid_t* actroid);
+
+  ACTROID_C_API long actroid_io_cycle_count(actroid_t* actroid);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
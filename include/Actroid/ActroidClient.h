@@ -0,0 +1,114 @@
+/**
+ * @file ActroidClient.h
+ * @brief Client of actroidd, the daemon which owns the serial port
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <string>
+
+#include "SharedRegion.h"
+
+namespace ogata_lab {
+
+  /**
+   * A daemon which has not published for this long [ms] is taken as stopped.
+   */
+#define CLIENT_DAEMON_TIMEOUT_MS 1000
+
+  /**
+   * Controller of an Actroid whose serial port is owned by actroidd.
+   *
+   * Targets and angles go through the shared memory of the daemon, so
+   * any number of processes write targets and read angles without a
+   * system call. The daemon applies targets and publishes angles every
+   * period (1 ms by default). Other requests go through the control
+   * socket of the daemon, connected on first use.
+   */
+  class ActroidClient {
+  private:
+    std::string m_Name;
+    SharedRegion m_Region;
+    int m_Socket;
+    std::string m_Received;
+    int m_Timeout;
+
+    void _disconnect();
+    bool _wait(const short events, const uint64_t deadline);
+
+  public:
+    /**
+     * Attach to the actroidd instance name (its -n option).
+     * @throw ActroidException if it is not running.
+     */
+    ActroidClient(const char* name) throw(ActroidException);
+
+    ~ActroidClient();
+
+  public:
+    const std::string& getName() const {
+      return m_Name;
+    }
+
+    int getNumJoint() const {
+      return m_Region.getNumJoint();
+    }
+
+    /**
+     * Deadline [ms] of each request on the control socket (DEFAULT_TIMEOUT_MS).
+     */
+    void setTimeout(const int timeoutMs) {
+      m_Timeout = timeoutMs;
+    }
+
+    int getTimeout() const {
+      return m_Timeout;
+    }
+
+    /**
+     * Set target angles [rad] of joints [offset, offset+n). NaN leaves a
+     * joint as it is, so clients may command disjoint joints.
+     */
+    void setTargetAngles(const int offset, const double* angles, const int n) {
+      m_Region.writeTargets(offset, angles, n);
+    }
+
+    /**
+     * Copy the angles [rad] of joints [0, n) last published by the daemon.
+     * @param age time [s] since each joint was measured, -1 if never (may be NULL)
+     * @param variance as ActroidBaseT::getEstimatedAngles() (may be NULL)
+     * @return false while the daemon recovers its link, or has stopped:
+     * the angles are then the last ones, or left as they were if the
+     * daemon stopped while publishing them.
+     */
+    bool getCurrentAngles(double* angles, double* age, double* variance, const int n);
+
+    /**
+     * Move along waypoints, as ActroidBaseT::setTrajectory() in the daemon.
+     * @param angles getNumJoint() angles [rad] for each waypoint
+     * @throw ActroidException if the daemon refuses them or can not be reached.
+     */
+    void setTrajectory(const double* time, const double* angles, const int count,
+                       const Interpolation interpolation) throw(ActroidException);
+
+    /**
+     * Stop the trajectory of the daemon where it is now.
+     * @throw ActroidException if the daemon can not be reached.
+     */
+    void stopTrajectory() throw(ActroidException) {
+      request("trajectory stop");
+    }
+
+    /**
+     * Send one request (see actroidd -h) on the control socket.
+     * @return reply without the leading "ok".
+     * @throw ActroidTimeoutException if the daemon does not answer before the
+     * timeout; the connection is then dropped and made again by the next request.
+     * @throw ActroidException on an error reply, or if the daemon can not be reached.
+     */
+    std::string request(const char* line) throw(ActroidException);
+  };
+
+};
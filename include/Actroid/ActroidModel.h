@@ -0,0 +1,79 @@
+/**
+ * @file ActroidModel.h
+ * @brief Robot model traits for ActroidBaseT
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace ogata_lab {
+
+  /**
+   * Traits of the 24 channel Actroid.
+   *
+   * A model defines its channel count, serial settings and protocol bytes
+   * as compile time constants, and its joint limits as arrays of NUM_JOINT
+   * entries. To add a model, declare a struct with the same members here,
+   * define its arrays in ActroidModel.cpp and instantiate ActroidBaseT for
+   * it at the end of ActroidBase.cpp.
+   *
+  [CH1]眉上下,173,128,0,255
+    [CH2]瞼開閉,0,0,0,255
+    [CH3]眼左右,181,128,0,255
+    [CH4]眼上下,128,128,0,255
+    [CH5]口開閉,0,0,0,255
+    [CH6]首左伸,128,128,0,255
+    [CH7]首右伸,128,128,0,255
+    [CH8]首旋回,128,128,0,255
+    [CH9]左腕上,128,128,0,255
+    [CH10]左腕開,127,128,0,255
+    [CH11]左上腕,128,128,0,255
+    [CH12]左肘,128,128,0,255
+    [CH13]左前腕,128,128,0,255
+    [CH14]左手縦,128,128,0,255
+    [CH15]左手横,128,128,0,255
+    [CH16]右腕上,128,128,0,255
+    [CH17]右腕開,128,128,0,255
+    [CH18]右上腕,128,128,0,255
+    [CH19]右肘,128,128,0,255
+    [CH20]右前腕,128,128,0,255
+    [CH21]右手縦,128,128,0,255
+    [CH22]右手横,128,128,0,255
+    [CH23]胴前後,0,0,0,255
+    [CH24]胴旋回,128,128,0,255
+   */
+  struct ActroidModel {
+    enum {
+      NUM_JOINT = 24,
+      BAUDRATE = 115200,
+      DEFAULT_RAW_ANGLE = 255/2,
+      FACE_JOINT_START = 0,
+      NUM_FACE_JOINT = 5
+    };
+
+    /**
+     * Protocol bytes.
+     */
+    enum {
+      START = 0xfe,
+      STOP = 0x01,
+      GET = 0x77,
+      SET = 0x74,
+      SET2 = 0x18,
+      ONLINE = 0x55,
+      OFFLINE = 0xdf,
+      ACK = 0x06,
+      NACK = 0x15
+    };
+
+    static const double MaxAngle[NUM_JOINT];
+    static const double MinAngle[NUM_JOINT];
+    static const double DefaultAngle[NUM_JOINT];
+    static const uint8_t DefaultRawAngle[NUM_JOINT];
+    static const double AngleMargin[NUM_JOINT];
+  };
+
+};
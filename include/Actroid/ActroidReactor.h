@@ -0,0 +1,130 @@
+/**
+ * @file ActroidReactor.h
+ * @brief One thread driving the serial links of several controllers
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Thread.h"
+
+namespace ogata_lab {
+
+  /**
+   * Link which a reactor advances without blocking.
+   */
+  class ReactorClient {
+  public:
+    virtual ~ReactorClient() {}
+
+  public:
+    /**
+     * Descriptor which polls readable when bytes are received, -1 if none
+     * (then the client asks for wakeups to poll its transport).
+     */
+    virtual int getFd() = 0;
+
+    /**
+     * Process received bytes, expired deadlines and new commands, without blocking.
+     * @param error the descriptor reported an error or a hang-up.
+     * @param wakeup set to the time (monotonicNanos()) by which step() must
+     * be called again even if nothing is received (0: only on received bytes).
+     * @param relinked set to true if the descriptor was closed and
+     * reopened (getFd() may have changed).
+     * @return false once the link is finished; the client is then dropped.
+     */
+    virtual bool step(const uint64_t now, const bool error, uint64_t& wakeup, bool& relinked) = 0;
+  };
+
+  class ActroidReactorThread;
+
+  /**
+   * Drives the links of several controllers from one thread.
+   *
+   * The thread waits on the descriptors of all clients at once (epoll on
+   * Linux) and steps each client whose descriptor became readable or whose
+   * wakeup time passed. Steps never block, so a slow or silent controller
+   * delays nobody else: its replies, timeouts and reconnects are handled
+   * on its own deadlines. Without epoll the thread steps every client each
+   * millisecond.
+   *
+   * The thread is started by the first add(). Clients are added and
+   * removed by other threads at any time (see ActroidBaseT::startIoThread()).
+   */
+  class ActroidReactor {
+    friend class ActroidReactorThread;
+  private:
+    struct Entry {
+      ReactorClient* pClient;
+      int fd;             ///< watched descriptor (-1: none)
+      uint64_t wakeup;    ///< 0: only when readable
+      bool readable;
+      bool error;
+    };
+
+    net::ysuga::Mutex m_Mutex;
+    std::vector<Entry> m_Entries;
+    ActroidReactorThread* m_pThread;
+    volatile long m_Running;
+    volatile long m_WakeupCount;
+    int m_EpollFd;
+    int m_Priority;
+    uint64_t m_CpuMask;
+
+  private:
+    void _run();
+    void _watch(Entry& entry);
+    void _unwatch(Entry& entry);
+    void _wait(const int timeoutMs);
+
+  public:
+    ActroidReactor();
+
+    /**
+     * Stop the thread. Clients must have been removed.
+     */
+    ~ActroidReactor();
+
+  public:
+    /**
+     * Start stepping pClient, and the thread if it is not running.
+     * @throw net::ysuga::ThreadException if the thread can not be started.
+     */
+    void add(ReactorClient* pClient);
+
+    /**
+     * Wait until pClient is dropped, i.e. its step() returned false. The
+     * client must have been told to finish before.
+     */
+    void remove(ReactorClient* pClient);
+
+    /**
+     * Run the thread under SCHED_FIFO at priority 1-99 (0: default).
+     * Takes effect when the thread starts.
+     */
+    void setThreadPriority(const int priority) {
+      m_Priority = priority;
+    }
+
+    /**
+     * Pin the thread to CPUs (bit i: CPU i, 0: any). Takes effect when the thread starts.
+     */
+    void setThreadAffinity(const uint64_t cpuMask) {
+      m_CpuMask = cpuMask;
+    }
+
+    int getClientCount();
+
+    /**
+     * Number of times the thread woke up, for all clients together.
+     */
+    long getWakeupCount() {
+      return net::ysuga::atomicLoad(&m_WakeupCount);
+    }
+  };
+
+};
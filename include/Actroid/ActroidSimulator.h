@@ -0,0 +1,251 @@
+/**
+ * @file ActroidSimulator.h
+ * @brief Simulated Actroid controller for benchmarks without the robot
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "Thread.h"
+#include "ActroidModel.h"
+
+namespace ogata_lab {
+
+#define SIMULATOR_OUTPUT_SIZE 1024
+
+  /**
+   * Protocol engine of the Actroid controller.
+   *
+   * Bytes written by the host are passed to input(), and reply bytes are
+   * taken by output() once the simulated link has carried them. The link
+   * transfers 10 bits per byte at the configured baud rate in each
+   * direction, and a reply is started after its request has arrived.
+   * Joints follow their targets with a first order lag. Faults (NACK,
+   * dropped reply, corrupted byte) are injected with given probabilities.
+   *
+   * The engine does no I/O by itself; see PtySimulator.
+   */
+  class ActroidSimulator {
+  public:
+    enum {
+      NUM_JOINT = ActroidModel::NUM_JOINT,
+      SET_PACKET_SIZE = ActroidModel::NUM_JOINT + 5
+    };
+
+  private:
+    struct OutputByte {
+      uint8_t data;
+      uint64_t time;
+    };
+
+    uint8_t m_Packet[SET_PACKET_SIZE];
+    int m_PacketSize;
+    OutputByte m_Output[SIMULATOR_OUTPUT_SIZE];
+    int m_OutputHead;
+    int m_OutputCount;
+    uint64_t m_RxFreeTime;
+    uint64_t m_TxFreeTime;
+
+    bool m_Online;
+    double m_Target[NUM_JOINT];
+    double m_Current[NUM_JOINT];
+    uint64_t m_ServoTime;
+
+    int m_Baudrate;
+    double m_ServoLag;
+    int m_Latency;
+    double m_NackRate;
+    double m_DropRate;
+    double m_CorruptRate;
+    uint32_t m_Random;
+
+    long m_SetCount;
+    long m_GetCount;
+    long m_NackCount;
+    long m_DropCount;
+    long m_CorruptCount;
+    long m_FrameErrorCount;
+    long m_OverrunCount;
+
+  private:
+    uint64_t _byteTime() const;
+    bool _chance(const double rate);
+    void _updateServo(const uint64_t now);
+    void _send(const uint8_t* data, const int size, const uint64_t now);
+    void _onPacket(const uint64_t now);
+    int _expectedSize() const;
+
+  public:
+    ActroidSimulator();
+
+    ~ActroidSimulator() {}
+
+  public:
+    /**
+     * Baud rate of the simulated link. 0 transfers bytes without delay.
+     */
+    void setBaudrate(const int baudrate) {
+      m_Baudrate = baudrate;
+    }
+
+    int getBaudrate() const {
+      return m_Baudrate;
+    }
+
+    /**
+     * Time constant [ms] of the joints following their targets. 0 moves them at once.
+     */
+    void setServoLag(const double lagMs) {
+      m_ServoLag = lagMs;
+    }
+
+    /**
+     * Processing time [us] of the controller before each reply.
+     */
+    void setLatency(const int latencyUs) {
+      m_Latency = latencyUs;
+    }
+
+    /**
+     * Probability of answering a valid packet with NACK.
+     */
+    void setNackRate(const double rate) {
+      m_NackRate = rate;
+    }
+
+    /**
+     * Probability of not answering a packet at all.
+     */
+    void setDropRate(const double rate) {
+      m_DropRate = rate;
+    }
+
+    /**
+     * Probability of corrupting each reply byte.
+     */
+    void setCorruptRate(const double rate) {
+      m_CorruptRate = rate;
+    }
+
+    void setSeed(const uint32_t seed) {
+      m_Random = seed ? seed : 1;
+    }
+
+    /**
+     * Reset joints to the default raw angles of the model and drop pending bytes.
+     */
+    void reset();
+
+    /**
+     * Bytes written by the host at time now [ns].
+     */
+    void input(const uint8_t* data, const int size, const uint64_t now);
+
+    /**
+     * Take reply bytes which have arrived at the host by time now [ns].
+     * @return number of bytes copied to data.
+     */
+    int output(uint8_t* data, const int maxSize, const uint64_t now);
+
+    /**
+     * Time [ns] when the next reply byte arrives at the host, or 0 if none is pending.
+     */
+    uint64_t getNextOutputTime() const {
+      return m_OutputCount == 0 ? 0 : m_Output[m_OutputHead].time;
+    }
+
+    bool isOnline() const {
+      return m_Online;
+    }
+
+    /**
+     * Current raw angle of joint at time now [ns].
+     */
+    uint8_t getRawAngle(const int index, const uint64_t now);
+
+    uint8_t getTargetRawAngle(const int index) const {
+      return (uint8_t)(m_Target[index] + 0.5);
+    }
+
+    long getSetCount() const {
+      return m_SetCount;
+    }
+
+    long getGetCount() const {
+      return m_GetCount;
+    }
+
+    long getNackCount() const {
+      return m_NackCount;
+    }
+
+    long getDropCount() const {
+      return m_DropCount;
+    }
+
+    long getCorruptCount() const {
+      return m_CorruptCount;
+    }
+
+    /**
+     * Number of bytes skipped or packets rejected because they were malformed.
+     */
+    long getFrameErrorCount() const {
+      return m_FrameErrorCount;
+    }
+
+    /**
+     * Number of reply bytes lost because the host did not read them.
+     */
+    long getOverrunCount() const {
+      return m_OverrunCount;
+    }
+  };
+
+  /**
+   * Runs an ActroidSimulator behind a pseudo terminal.
+   *
+   * The slave side (getSlaveName()) can be opened by SerialPort like the
+   * real controller. The simulator is serviced by its own thread, so it
+   * must not be accessed by others between start() and stop().
+   * Not available on Windows.
+   */
+  class PtySimulator : public net::ysuga::Thread {
+  private:
+    ActroidSimulator* m_pSimulator;
+    int m_Master;
+    int m_Slave;
+    std::string m_SlaveName;
+    volatile long m_Running;
+
+  public:
+    /**
+     * Open a pseudo terminal. Throws ComException when it can not be opened.
+     */
+    PtySimulator(ActroidSimulator* pSimulator);
+
+    virtual ~PtySimulator();
+
+  public:
+    const std::string& getSlaveName() const {
+      return m_SlaveName;
+    }
+
+    /**
+     * Start serving the simulator.
+     */
+    void start();
+
+    /**
+     * Stop serving the simulator.
+     */
+    void stop();
+
+    virtual void run();
+  };
+
+};
@@ -0,0 +1,253 @@
+/**
+ * @file CommandQueue.h
+ * @brief Windowed command queue for Actroid serial protocol
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "SerialPort.h"
+#include "ReplyParser.h"
+
+namespace ogata_lab {
+
+#define COMMAND_QUEUE_SIZE 16
+#define COMMAND_MAX_PACKET 32
+#define COMMAND_MAX_REPLY 32
+
+  enum CommandStatus {
+    COMMAND_FREE,
+    COMMAND_QUEUED,   ///< waiting for a slot in the window
+    COMMAND_SENT,     ///< waiting for ack
+    COMMAND_ACKED,    ///< ack received, waiting for reply data
+    COMMAND_DONE,
+    COMMAND_NACK,
+    COMMAND_TIMEOUT,
+    COMMAND_LOST,     ///< reply broken on the line (not complete before the deadline, while the line was not silent)
+    COMMAND_ABORTED
+  };
+
+  class Command;
+
+  /**
+   * Called when the command is completed (DONE, NACK, TIMEOUT, LOST or ABORTED).
+   * The command is released after the callback returns.
+   */
+  typedef void (*CommandCallback)(const Command* command, void* userData);
+
+  /**
+   * One command and its reply. Owned by CommandQueue (pool allocated).
+   */
+  class Command {
+    friend class CommandQueue;
+  private:
+    uint8_t m_Packet[COMMAND_MAX_PACKET];
+    int m_PacketSize;
+    uint8_t m_Reply[COMMAND_MAX_REPLY];
+    int m_ReplySize;
+    CommandStatus m_Status;
+    uint64_t m_SentTime;
+    uint64_t m_Deadline;
+    CommandCallback m_Callback;
+    void* m_UserData;
+
+  public:
+    Command() : m_Status(COMMAND_FREE) {}
+
+    CommandStatus getStatus() const {
+      return m_Status;
+    }
+
+    /**
+     * true if the command will not change any more.
+     */
+    bool isDone() const {
+      return m_Status >= COMMAND_DONE;
+    }
+
+    const uint8_t* getPacket() const {
+      return m_Packet;
+    }
+
+    const uint8_t* getReply() const {
+      return m_Reply;
+    }
+
+    int getReplySize() const {
+      return m_ReplySize;
+    }
+  };
+
+  /**
+   * Keeps up to 'window' commands in flight on one transport (serial port).
+   *
+   * Replies are matched to commands in FIFO order: each command first gets
+   * ACK (0x06) or NACK (0x15), then replySize bytes of data, starting with
+   * their count, if it was acked. Replies are parsed by ReplyParser, so
+   * stray bytes are skipped. A reply which is not complete at its deadline
+   * although bytes arrived after the command was written was broken on the
+   * line: its command completes as COMMAND_LOST, and the replies which
+   * follow are realigned. Only a silent line is COMMAND_TIMEOUT.
+   * The queue is not thread safe; one thread submits and services it.
+   */
+  class CommandQueue {
+  private:
+    net::ysuga::Transport* m_pTransport;
+    Command m_Pool[COMMAND_QUEUE_SIZE];
+    int m_Fifo[COMMAND_QUEUE_SIZE];
+    int m_Head;
+    int m_Count;
+    int m_InFlight;
+    int m_TxOffset;   ///< bytes of the first command not in flight already written
+    uint64_t m_TxBlockedTime;   ///< since when flush() has not written everything (0: it has)
+    int m_Window;
+    int m_Timeout;
+    ReplyParser m_Parser;
+    uint64_t m_LastRxTime;
+
+    long m_NackCount;
+    long m_TimeoutCount;
+    long m_FrameErrorCount;
+    bool m_Unexpected;   ///< bytes came while nothing was in flight
+
+  private:
+    Command* _at(const int position) {
+      return &m_Pool[m_Fifo[(m_Head + position) % COMMAND_QUEUE_SIZE]];
+    }
+    void _complete(const CommandStatus status);
+    void _expectNext();
+    void _receive();
+    void _parse(const uint8_t* data, const int size);
+    void _checkTimeout(const uint64_t now);
+
+  public:
+    CommandQueue(net::ysuga::Transport* pTransport, const int window = 2);
+
+    ~CommandQueue() {}
+
+  public:
+    /**
+     * Use pTransport from now on (e.g. a reopened port). Call clear() before.
+     */
+    void setTransport(net::ysuga::Transport* pTransport) {
+      m_pTransport = pTransport;
+    }
+
+    /**
+     * Maximum number of commands in flight (1 to COMMAND_QUEUE_SIZE).
+     */
+    void setWindow(const int window);
+
+    int getWindow() const {
+      return m_Window;
+    }
+
+    /**
+     * Deadline [ms] for each command, counted from when it is written.
+     */
+    void setTimeout(const int timeoutMs) {
+      m_Timeout = timeoutMs;
+    }
+
+    /**
+     * Queue command. It is written by flush() or service() once the window has room.
+     * @param replySize number of data bytes following the ack.
+     * @param callback completion callback. If NULL, the caller must release() the command.
+     * @return command, or NULL if the queue is full.
+     */
+    Command* submit(const uint8_t* packet, const int size, const int replySize,
+		    CommandCallback callback = NULL, void* userData = NULL);
+
+    /**
+     * Write queued commands as long as the window has room, with one write.
+     * A command is in flight once all of its bytes are written; if the
+     * transport takes only a part (non-blocking port), the rest is written
+     * by the next flush.
+     * @throw ComTimeoutException if the transport has not taken the
+     * commands for the timeout.
+     */
+    void flush();
+
+    /**
+     * Flush, then wait up to timeoutMs for replies and complete commands.
+     * Returns as soon as some bytes have been processed.
+     */
+    void service(const int timeoutMs);
+
+    /**
+     * Process bytes received so far and expired deadlines, then flush,
+     * without waiting. For callers which wait on the transport themselves
+     * (e.g. ActroidReactor).
+     */
+    void poll();
+
+    /**
+     * Deadline (monotonicNanos()) of the oldest command in flight, 0 if none.
+     */
+    uint64_t getDeadline() {
+      return m_InFlight > 0 ? _at(0)->m_Deadline : 0;
+    }
+
+    /**
+     * Service the queue until the command is done.
+     * @return false if the command is not done within timeoutMs.
+     */
+    bool wait(const Command* command, const int timeoutMs);
+
+    /**
+     * Return a completed command without callback to the pool.
+     */
+    void release(const Command* command);
+
+    /**
+     * Abort all commands. Commands in flight are abandoned, so Rx buffer should be flushed.
+     */
+    void clear();
+
+    int getCount() const {
+      return m_Count;
+    }
+
+    int getInFlightCount() const {
+      return m_InFlight;
+    }
+
+    bool hasRoom() const {
+      return m_Count < m_Window;
+    }
+
+    /**
+     * True if commands in the window are still to be written by flush().
+     */
+    bool hasUnsent() const {
+      return m_InFlight < m_Count && m_InFlight < m_Window;
+    }
+
+    long getNackCount() const {
+      return m_NackCount;
+    }
+
+    long getTimeoutCount() const {
+      return m_TimeoutCount;
+    }
+
+    /**
+     * Bursts of bytes received while no reply was expected, such as late
+     * replies; one burst lasts until the next command is sent.
+     */
+    long getFrameErrorCount() const {
+      return m_FrameErrorCount;
+    }
+
+    /**
+     * Number of times bytes were skipped to find a reply (ReplyParser::getResyncCount()).
+     */
+    long getResyncCount() const {
+      return m_Parser.getResyncCount();
+    }
+  };
+
+};
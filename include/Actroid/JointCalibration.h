@@ -0,0 +1,100 @@
+/**
+ * @file JointCalibration.h
+ * @brief Precomputed conversion between joint angles and raw values
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace ogata_lab {
+
+#define RAW_ANGLE_RANGE 256
+
+  /**
+   * Conversion tables for NumJoint joints.
+   *
+   * Angle limits are reduced to a clamp range, a range and an offset per
+   * joint when constructed, and raw values are converted back with a
+   * 256-entry table per joint. Parameters are stored as separate arrays
+   * (structure of arrays), so the batch loops compile to straight vector
+   * code. Raw values are computed in the same order of operations as the
+   * original ActroidBase::setTargetAngle(): a scale and offset folded into
+   * one multiply-add truncate one count low on exact boundaries.
+   */
+  template<int NumJoint>
+  class JointCalibration {
+  private:
+    double m_Lower[NumJoint];
+    double m_Upper[NumJoint];
+    double m_Range[NumJoint];
+    double m_Offset[NumJoint];
+    double m_Table[NumJoint][RAW_ANGLE_RANGE];
+
+  public:
+    /**
+     * @param minAngle lower limit of each joint [rad] (raw value 0)
+     * @param maxAngle upper limit of each joint [rad] (raw value 255)
+     * @param margin targets are clamped to [min+margin, max-margin] [rad]
+     */
+    JointCalibration(const double* minAngle, const double* maxAngle, const double* margin) {
+      setLimits(minAngle, maxAngle, margin);
+    }
+
+    void setLimits(const double* minAngle, const double* maxAngle, const double* margin) {
+      for (int i = 0;i < NumJoint;i++) {
+        double range = maxAngle[i] - minAngle[i];
+        m_Lower[i] = minAngle[i] + margin[i];
+        m_Upper[i] = maxAngle[i] - margin[i];
+        m_Range[i] = range;
+        m_Offset[i] = minAngle[i] * 255.0 / range;
+        for (int raw = 0;raw < RAW_ANGLE_RANGE;raw++) {
+          m_Table[i][raw] = (raw * range) / 255.0 + minAngle[i];
+        }
+      }
+    }
+
+    /**
+     * Convert one target angle [rad] to raw value.
+     */
+    uint8_t toRaw(const int index, double angle) const {
+      if (angle >= m_Upper[index]) {
+        angle = m_Upper[index];
+      } else if (angle <= m_Lower[index]) {
+        angle = m_Lower[index];
+      }
+      return (uint8_t)(angle * 255.0 / m_Range[index] - m_Offset[index]);
+    }
+
+    /**
+     * Convert one raw value to angle [rad].
+     */
+    double toAngle(const int index, const uint8_t raw) const {
+      return m_Table[index][raw];
+    }
+
+    /**
+     * Convert target angles of joints [0, n) to raw values.
+     */
+    void toRaw(const double* angle, uint8_t* raw, const int n) const {
+      for (int i = 0;i < n;i++) {
+        double a = angle[i];
+        a = a > m_Upper[i] ? m_Upper[i] : a;
+        a = a < m_Lower[i] ? m_Lower[i] : a;
+        raw[i] = (uint8_t)(a * 255.0 / m_Range[i] - m_Offset[i]);
+      }
+    }
+
+    /**
+     * Convert raw values of joints [0, n) to angles.
+     */
+    void toAngle(const uint8_t* raw, double* angle, const int n) const {
+      for (int i = 0;i < n;i++) {
+        angle[i] = m_Table[i][raw[i]];
+      }
+    }
+  };
+
+};
@@ -0,0 +1,117 @@
+/**
+ * @file JointEstimator.h
+ * @brief Alpha-beta estimate of joint angles between measurements
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ogata_lab {
+
+  /**
+   * Per-joint alpha-beta filter for NumJoint joints.
+   *
+   * Each measured angle corrects the angle and velocity estimates of its
+   * joint. Between measurements the angle is extrapolated with the
+   * velocity, for at most the prediction horizon, and never past the
+   * commanded target when moving towards it, since the servo stops there.
+   */
+  template<int NumJoint>
+  class JointEstimator {
+  private:
+    double m_Alpha;
+    double m_Beta;
+    double m_Horizon;
+    double m_Angle[NumJoint];
+    double m_Velocity[NumJoint];
+    double m_Variance[NumJoint];
+    uint64_t m_Time[NumJoint];
+
+  public:
+    JointEstimator() : m_Alpha(0.5), m_Beta(0.1), m_Horizon(0.1) {
+      for (int j = 0;j < NumJoint;j++) {
+        m_Angle[j] = m_Velocity[j] = m_Variance[j] = 0;
+        m_Time[j] = 0;
+      }
+    }
+
+  public:
+    /**
+     * @param alpha weight of a measurement on the angle (0, 1]
+     * @param beta weight of a measurement on the velocity [0, 2)
+     */
+    void setGains(const double alpha, const double beta) {
+      m_Alpha = alpha;
+      m_Beta = beta;
+    }
+
+    /**
+     * Longest extrapolation [s] after the last measurement.
+     */
+    void setHorizon(const double horizon) {
+      m_Horizon = horizon;
+    }
+
+    /**
+     * Time (monotonicNanos()) of the last measurement of joint j, 0 if none.
+     */
+    uint64_t getTime(const int j) const {
+      return m_Time[j];
+    }
+
+    /**
+     * Correct joint j with angle z [rad] measured at time t.
+     */
+    void measure(const int j, const double z, const uint64_t t) {
+      if (m_Time[j] == 0) {
+        m_Angle[j] = z;
+        m_Velocity[j] = 0;
+        m_Variance[j] = 0;
+        m_Time[j] = t;
+        return;
+      }
+      if (t <= m_Time[j]) {
+        return;
+      }
+      const double dt = (t - m_Time[j]) * 1e-9;
+      const double r = z - (m_Angle[j] + m_Velocity[j] * dt);
+      m_Angle[j] += m_Velocity[j] * dt + m_Alpha * r;
+      m_Velocity[j] += m_Beta * r / dt;
+      m_Variance[j] += (r * r - m_Variance[j]) / 16;
+      m_Time[j] = t;
+    }
+
+    /**
+     * Estimate joints [0, n) at now.
+     * @param target commanded angles [rad]
+     * @param age time [s] since the last measurement of each joint (may be NULL)
+     * @param variance mean squared innovation [rad^2] of each joint (may be NULL)
+     */
+    void estimate(const double* target, const uint64_t now, double* angles,
+                  double* age, double* variance, const int n) const {
+      for (int j = 0;j < n;j++) {
+        double dt = now > m_Time[j] ? (now - m_Time[j]) * 1e-9 : 0;
+        if (age) {
+          age[j] = m_Time[j] ? dt : -1;
+        }
+        if (variance) {
+          variance[j] = m_Variance[j];
+        }
+        if (dt > m_Horizon) {
+          dt = m_Horizon;
+        }
+        double x = m_Angle[j] + m_Velocity[j] * dt;
+        if ((m_Velocity[j] > 0 && m_Angle[j] <= target[j] && x > target[j]) ||
+            (m_Velocity[j] < 0 && m_Angle[j] >= target[j] && x < target[j])) {
+          x = target[j];
+        }
+        angles[j] = x;
+      }
+    }
+  };
+
+};
@@ -0,0 +1,60 @@
+/**
+ * @file LoopbackTransport.h
+ * @brief In-process transport to an ActroidSimulator
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "SerialPort.h"
+#include "ActroidSimulator.h"
+
+namespace ogata_lab {
+
+  /**
+   * Transport which hands bytes to an ActroidSimulator in the same thread.
+   *
+   * No tty or system call is involved, so protocol, conversion and
+   * scheduling code can be measured alone. Replies become readable when
+   * the simulated link has carried them; with baud rate 0 they are
+   * readable as soon as the request is written. The simulator must not be
+   * used by others while the transport is in use.
+   */
+  class LoopbackTransport : public net::ysuga::Transport {
+  private:
+    ActroidSimulator* m_pSimulator;
+
+  private:
+    bool _waitUntil(const uint64_t deadline);
+
+  public:
+    LoopbackTransport(ActroidSimulator* pSimulator) : m_pSimulator(pSimulator) {}
+
+    virtual ~LoopbackTransport() {}
+
+  public:
+    ActroidSimulator* getSimulator() {
+      return m_pSimulator;
+    }
+
+    virtual void flushRxBuffer();
+
+    virtual int write(const void* src, const unsigned int size);
+
+    virtual int writev(const net::ysuga::IoBuffer* buffers, const int count);
+
+    /**
+     * Returns false at once when no reply is pending, even if timeoutMs is
+     * negative, because nothing can arrive without a write.
+     */
+    virtual bool waitForRxData(const int timeoutMs);
+
+    virtual int readExact(void *dst, const unsigned int size, const int timeoutMs);
+
+    virtual int readAvailable(void *dst, const unsigned int maxSize);
+  };
+
+};
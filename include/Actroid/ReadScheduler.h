@@ -0,0 +1,89 @@
+/**
+ * @file ReadScheduler.h
+ * @brief Joint group scheduler for partial joint angle reads
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ogata_lab {
+
+  /**
+   * One entry of a joint spec "name:start:count:value".
+   */
+  struct JointSpec {
+    std::string name;
+    int start;
+    int count;
+    int value;
+  };
+
+  /**
+   * Split a comma separated joint spec such as "arms:8:14:1,face:0:8:4".
+   * @return false if the spec is malformed.
+   */
+  bool parseJointSpec(const std::string& spec, std::vector<JointSpec>& entries);
+
+  /**
+   * Named range of joints read every 'period' cycles.
+   */
+  struct JointGroup {
+    std::string name;
+    int start;
+    int count;
+    int period;
+  };
+
+  /**
+   * Decides which joints are read in each cycle.
+   *
+   * Each cycle, the groups which are due are merged into one contiguous
+   * range, so one get packet is sent per cycle. Without groups, all joints
+   * are read every cycle.
+   */
+  class ReadScheduler {
+  private:
+    std::vector<JointGroup> m_Groups;
+    unsigned long m_Cycle;
+    int m_NumJoint;
+
+  public:
+    ReadScheduler(const int numJoint) : m_Cycle(0), m_NumJoint(numJoint) {}
+
+    ~ReadScheduler() {}
+
+  public:
+    /**
+     * @return false if the range is out of joints or period is not positive.
+     */
+    bool addGroup(const char* name, const int start, const int count, const int period);
+
+    /**
+     * Replace groups by a spec such as "arms:8:14:1,face:0:8:4,torso:22:2:4"
+     * (name:start:count:period, comma separated). Empty spec removes all groups.
+     * @return false if the spec is invalid. Groups are unchanged then.
+     */
+    bool parse(const std::string& spec);
+
+    void clear() {
+      m_Groups.clear();
+      m_Cycle = 0;
+    }
+
+    const JointGroup* find(const char* name) const;
+
+    const std::vector<JointGroup>& getGroups() const {
+      return m_Groups;
+    }
+
+    /**
+     * Range to be read in the next cycle.
+     */
+    void next(int& start, int& count);
+  };
+
+};
@@ -0,0 +1,104 @@
+/**
+ * @file ReplyParser.h
+ * @brief Incremental, self-resynchronizing parser of controller replies
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace ogata_lab {
+
+  enum ReplyStatus {
+    REPLY_PENDING,
+    REPLY_DONE,
+    REPLY_NACK
+  };
+
+  /**
+   * State machine for one reply of the controller: ACK (0x06) or NACK
+   * (0x15), then, if acked and replySize > 0, replySize bytes of data
+   * starting with their count (replySize - 1), as in joint angle packets.
+   *
+   * Bytes which can not start the expected part are skipped instead of
+   * failing the reply: a stray or duplicated byte before the ack or the
+   * count costs nothing but the skipped bytes, and leftovers of a broken
+   * reply are dropped while the next one is looked for. Each run of
+   * skipped bytes counts as one resync.
+   *
+   * Bytes are fed as they arrive, in chunks of any size. parse() never
+   * consumes more than getNeeded() bytes, so the caller can read exactly
+   * that many without taking bytes of the next reply.
+   */
+  class ReplyParser {
+  private:
+    enum State {
+      WAIT_ACK,
+      WAIT_COUNT,
+      WAIT_DATA,
+      FINISHED
+    };
+
+    State m_State;
+    ReplyStatus m_Status;
+    uint8_t* m_pReply;
+    int m_ReplySize;
+    int m_Received;
+    bool m_Started;
+    bool m_Skipping;
+    long m_ResyncCount;
+
+  private:
+    void _skip();
+
+  public:
+    ReplyParser();
+
+  public:
+    /**
+     * Start looking for a reply of replySize data bytes, stored into reply.
+     */
+    void expect(const int replySize, uint8_t* reply);
+
+    /**
+     * Consume bytes until the reply is complete.
+     * @return number of bytes consumed (less than size once the reply is complete).
+     */
+    int parse(const uint8_t* data, const int size);
+
+    ReplyStatus getStatus() const {
+      return m_Status;
+    }
+
+    /**
+     * true once the ack of the reply has been received.
+     */
+    bool isAcked() const {
+      return m_State == WAIT_COUNT || m_State == WAIT_DATA || m_Status == REPLY_DONE;
+    }
+
+    /**
+     * true if any byte has been consumed since expect(). A reply which is
+     * started but not complete at its deadline was broken on the line,
+     * while one which is not started was not answered.
+     */
+    bool isStarted() const {
+      return m_Started;
+    }
+
+    /**
+     * Least number of bytes which completes the reply (0 when complete).
+     */
+    int getNeeded() const;
+
+    /**
+     * Number of times bytes were skipped to find the expected reply.
+     */
+    long getResyncCount() const {
+      return m_ResyncCount;
+    }
+  };
+
+};
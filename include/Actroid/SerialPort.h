@@ -87,20 +87,108 @@ namespace net {
 			virtual ~ComOpenException(void) throw() {}
 		};
 
+		/**
+		 * @brief This exception is thrown when the expected data does not arrive before the deadline.
+		 */
+		class LIBYSUGA_API ComTimeoutException : public ComException  {
+		public:
+			ComTimeoutException(void) : ComException ("COM Timeout") {}
+			virtual ~ComTimeoutException(void) throw() {}
+		};
+
+
+
+
+		/**
+		 * @brief one chunk of gather write.
+		 */
+		struct LIBYSUGA_API IoBuffer {
+			const void* data;
+			unsigned int size;
+		};
+
+
+		/***************************************************
+		 * Transport
+		 *
+		 * @brief Byte stream to a device.
+		 *
+		 * Implemented by SerialPort, and by in-process
+		 * transports which do not need a tty.
+		 ***************************************************/
+		class LIBYSUGA_API Transport
+		{
+		public:
+			virtual ~Transport() {}
+
+		public:
+			/**
+			 * @brief flush receive buffer.
+			 */
+			virtual void flushRxBuffer() = 0;
+
+			/**
+			 * @brief write data.
+			 * @return bytes written.
+			 */
+			virtual int write(const void* src, const unsigned int size) = 0;
+
+			/**
+			 * @brief write several chunks back-to-back.
+			 * @return total bytes written.
+			 */
+			virtual int writev(const IoBuffer* buffers, const int count) = 0;
+
+			/**
+			 * @brief wait until received data becomes readable.
+			 * @param timeoutMs maximum wait [ms]. negative value waits forever.
+			 * @return true if data arrived, false if timeout.
+			 */
+			virtual bool waitForRxData(const int timeoutMs) = 0;
+
+			/**
+			 * @brief read exactly size bytes.
+			 * @param timeoutMs deadline for whole data [ms]. negative value waits forever.
+			 * @return size
+			 * @throw ComTimeoutException if size bytes do not arrive before the deadline.
+			 */
+			virtual int readExact(void *dst, const unsigned int size, const int timeoutMs) = 0;
+
+			/**
+			 * @brief read bytes already received without waiting.
+			 * @return number of bytes read (may be zero).
+			 */
+			virtual int readAvailable(void *dst, const unsigned int maxSize) = 0;
+
+			/**
+			 * @brief descriptor which polls readable when data is received,
+			 * so that one thread can wait on several transports (epoll).
+			 * @return -1 if there is none.
+			 */
+			virtual int getFd() const {
+				return -1;
+			}
+		};
 
 
+		class TraceRecorder;
 
 		/***************************************************
 		 * SerialPort
 		 *
 		 * @brief Portable Serial Port Class
 		 ***************************************************/
-		class LIBYSUGA_API SerialPort
+		class LIBYSUGA_API SerialPort : public Transport
 		{
 		private:
 #ifdef WIN32
 
 			HANDLE m_hComm;
+
+			/**
+			 * @brief ReadTotalTimeoutConstant currently set to the port (-1 if unknown)
+			 */
+			int m_ReadTimeout;
 #else
 
 			/**
@@ -109,6 +197,15 @@ namespace net {
 			int m_Fd;
 #endif
 
+			/**
+			 * @brief traffic tap (NULL: off)
+			 */
+			TraceRecorder* m_pTrace;
+
+			/**
+			 * @brief writes and reads return what the port takes at once.
+			 */
+			bool m_NonBlocking;
 
 
 		public:
@@ -123,14 +220,14 @@ namespace net {
 			/**
 			 * @brief Destructor
 			 */
-			~SerialPort();
+			virtual ~SerialPort();
 
 		public:
 			/**
 			 * @brief flush receive buffer.
 			 * @return zero if success.
 			 */
-			void flushRxBuffer();
+			virtual void flushRxBuffer();
 
 			/**
 			 * @brief flush transmit buffer.
@@ -149,13 +246,86 @@ namespace net {
 			 * @brief write data to Tx Buffer of Serial Port.
 			 *
 			 */
-			int write(const void* src, const unsigned int size);
+			virtual int write(const void* src, const unsigned int size);
+
+			/**
+			 * @brief write several chunks back-to-back with one system call.
+			 * @return total bytes written.
+			 */
+			virtual int writev(const IoBuffer* buffers, const int count);
 
 			/**
 			 * @brief read data from RxBuffer of Serial Port 
 			 			 */
 			int read(void *dst, const unsigned int size);
 
+			/**
+			 * @brief wait until Rx Buffer becomes readable.
+			 *
+			 * The calling thread sleeps in the kernel (poll) instead of polling the buffer size.
+			 * @param timeoutMs maximum wait [ms]. negative value waits forever.
+			 * @return true if data arrived, false if timeout.
+			 */
+			virtual bool waitForRxData(const int timeoutMs);
+
+			/**
+			 * @brief read exactly size bytes from Rx Buffer.
+			 *
+			 * Bytes are consumed as soon as they arrive. The deadline is
+			 * computed once per call, so partial arrivals do not extend it.
+			 * @param timeoutMs deadline for whole data [ms]. negative value waits forever.
+			 * @return size
+			 * @throw ComTimeoutException if size bytes do not arrive before the deadline.
+			 */
+			virtual int readExact(void *dst, const unsigned int size, const int timeoutMs);
+
+			/**
+			 * @brief read bytes already stored in Rx Buffer without waiting.
+			 * @return number of bytes read (may be zero).
+			 */
+			virtual int readAvailable(void *dst, const unsigned int maxSize);
+
+			/**
+			 * @brief file descriptor of the port (-1 on Windows).
+			 */
+			virtual int getFd() const {
+#ifdef WIN32
+				return -1;
+#else
+				return m_Fd;
+#endif
+			}
+
+			/**
+			 * @brief never block in write() and read().
+			 *
+			 * Non-blocking writes return the bytes the Tx buffer took,
+			 * possibly zero; unsent bytes are dropped on close. For a
+			 * thread serving several ports (ActroidReactor). Windows
+			 * ports keep writing synchronously.
+			 */
+			void setNonBlocking(const bool on);
+
+			bool isNonBlocking() const {
+				return m_NonBlocking;
+			}
+
+		public:
+			/**
+			 * @brief record every byte written to and read from the port.
+			 *
+			 * The recorder is not deleted by SerialPort. NULL stops
+			 * recording. Must not be changed while another thread
+			 * uses the port.
+			 */
+			void setTraceRecorder(TraceRecorder* pTrace) {
+				m_pTrace = pTrace;
+			}
+
+			TraceRecorder* getTraceRecorder() {
+				return m_pTrace;
+			}
+
 		};
 
 	};//namespace ysuga
@@ -0,0 +1,125 @@
+/**
+ * @file SharedRegion.h
+ * @brief Targets and angles of one Actroid in shared memory
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "ActroidBase.h"
+
+namespace ogata_lab {
+
+#define SHARED_MAGIC 0x41435452
+#define SHARED_VERSION 1
+#define SHARED_MAX_JOINT 64
+#define SHARED_LINE 64
+
+  /**
+   * Memory shared by actroidd and its clients. Processes sharing it must
+   * have the same ABI (e.g. all 64 bit).
+   *
+   * Each block is a seqlock: its writer makes sequence odd, writes and
+   * makes it even again; readers copy the block and retry if sequence
+   * was odd or changed meanwhile. Readers never block the writer.
+   */
+  struct SharedLayout {
+    uint32_t magic;          ///< SHARED_MAGIC while the daemon runs
+    uint32_t version;
+    int32_t numJoint;
+    int32_t pid;             ///< of the daemon
+    char pad0[SHARED_LINE - 16];
+
+    // written by clients under targetLock, read by the daemon.
+    volatile long targetLock;
+    volatile long targetSequence;
+    double target[SHARED_MAX_JOINT];    ///< [rad], NaN: not set
+    char pad1[SHARED_LINE];
+
+    // written by the daemon only.
+    volatile long currentSequence;
+    long stale;
+    long cycleCount;
+    uint64_t time;                      ///< monotonicNanos() of publication
+    double current[SHARED_MAX_JOINT];   ///< [rad]
+    double age[SHARED_MAX_JOINT];       ///< [s] at time, -1: never measured
+    double variance[SHARED_MAX_JOINT];  ///< [rad^2]
+  };
+
+  /**
+   * Shared memory of one actroidd instance (POSIX only).
+   */
+  class SharedRegion {
+  private:
+    std::string m_Name;
+    SharedLayout* m_pLayout;
+    bool m_Owner;
+    long m_TargetSequence;
+
+  public:
+    /**
+     * Create the region of instance name (the daemon), or attach to it.
+     * @param numJoint joints published, up to SHARED_MAX_JOINT (create only)
+     * @throw ActroidException if it can not be mapped, or nobody created it.
+     */
+    SharedRegion(const char* name, const bool create, const int numJoint = 0) throw(ActroidException);
+
+    /**
+     * Unmap. The creator also removes the region; attached clients keep
+     * their mapping but see the daemon stopped.
+     */
+    ~SharedRegion();
+
+  public:
+    /**
+     * Shared memory object of instance name.
+     */
+    static std::string memoryName(const char* name);
+
+    /**
+     * Control socket of instance name.
+     */
+    static std::string socketPath(const char* name);
+
+    int getNumJoint() const {
+      return m_pLayout->numJoint;
+    }
+
+    /**
+     * false once the daemon stopped.
+     */
+    bool isAlive() const;
+
+    /**
+     * Client side. Set targets [rad] of joints [offset, offset+n); NaN
+     * leaves a joint as it is. Writers exclude each other for the copy only.
+     */
+    void writeTargets(const int offset, const double* angles, const int n);
+
+    /**
+     * Client side. Copy the angles of joints [0, n) last published.
+     * age and variance may be NULL.
+     * @return sequence of the publication, 0 if none yet or if the daemon
+     * died or stopped while publishing; nothing is copied then.
+     */
+    long readCurrent(double* angles, double* age, double* variance, const int n,
+                     uint64_t& time, bool& stale, long& cycleCount);
+
+    /**
+     * Daemon side. Copy all targets if a client wrote since the last call.
+     * @return false if unchanged.
+     */
+    bool readTargets(double* angles);
+
+    /**
+     * Daemon side. Publish angles of all joints; age and variance may be NULL.
+     */
+    void publishCurrent(const double* angles, const double* age, const double* variance,
+                        const bool stale, const long cycleCount);
+  };
+
+};
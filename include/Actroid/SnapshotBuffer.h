@@ -0,0 +1,93 @@
+/**
+ * @file SnapshotBuffer.h
+ * @brief Lock-free latest-value exchange between two threads
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include "Thread.h"
+
+namespace ogata_lab {
+
+  /**
+   * Single writer / single reader buffer which always hands the newest value to the reader.
+   *
+   * The writer fills its back slot and swaps it with the spare slot; the reader swaps the
+   * spare slot with its front slot only when a new value is marked. Each side does one
+   * atomic exchange and never waits for the other, so neither can stall the other thread.
+   * Intermediate values are overwritten (latest wins).
+   */
+  template<typename T>
+  class SnapshotBuffer {
+  private:
+    enum {
+      INDEX_MASK = 0x03,
+      NEW_FLAG = 0x04
+    };
+
+    T m_Slots[3];
+    long m_Back;
+    long m_Front;
+    volatile long m_Spare;
+
+  public:
+    SnapshotBuffer() : m_Back(0), m_Front(1), m_Spare(2) {
+    }
+
+    /**
+     * Writer side. Slot to be filled before publish().
+     */
+    T& back() {
+      return m_Slots[m_Back];
+    }
+
+    /**
+     * Writer side. Hand back() to the reader.
+     */
+    void publish() {
+      m_Back = net::ysuga::atomicExchange(&m_Spare, m_Back | NEW_FLAG) & INDEX_MASK;
+    }
+
+    /**
+     * Writer side. Copy value and publish.
+     */
+    void write(const T& value) {
+      back() = value;
+      publish();
+    }
+
+    /**
+     * Reader side. Take the newest value if any.
+     * @return true if front() has been updated.
+     */
+    bool update() {
+      if (!(net::ysuga::atomicLoad(&m_Spare) & NEW_FLAG)) {
+        return false;
+      }
+      m_Front = net::ysuga::atomicExchange(&m_Spare, m_Front) & INDEX_MASK;
+      return true;
+    }
+
+    /**
+     * Reader side. The newest value taken by update().
+     */
+    const T& front() const {
+      return m_Slots[m_Front];
+    }
+
+    /**
+     * Reader side. Copy the newest value if any.
+     * @return true if value has been updated.
+     */
+    bool read(T& value) {
+      if (!update()) {
+        return false;
+      }
+      value = front();
+      return true;
+    }
+  };
+
+};
@@ -0,0 +1,168 @@
+/**
+ * @file Telemetry.h
+ * @brief Latency histograms and error counters of the control cycle
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "Thread.h"
+
+namespace ogata_lab {
+
+  // values below 32 [ns] have own buckets, then 16 buckets per power of two up to 2^48 [ns].
+#define HISTOGRAM_LINEAR 32
+#define HISTOGRAM_SUB_BUCKETS 16
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR + 43 * HISTOGRAM_SUB_BUCKETS)
+
+  /**
+   * Copy of histogram counts, owned by one reader.
+   */
+  struct HistogramSnapshot {
+    long count[HISTOGRAM_BUCKETS];
+    long total;
+
+    HistogramSnapshot();
+
+    /**
+     * @param percentile 0 to 100
+     * @return value [ns] (bucket midpoint), 0 if empty.
+     */
+    uint64_t getValueAtPercentile(const double percentile) const;
+
+    /**
+     * @return largest value [ns] (bucket midpoint), 0 if empty.
+     */
+    uint64_t getMax() const;
+  };
+
+  /**
+   * Log-linear histogram of latencies [ns] (HDR style, about 6% resolution).
+   *
+   * record() is wait-free: it only increments one counter atomically, so
+   * any thread can record while another thread reads.
+   */
+  class LatencyHistogram {
+  private:
+    volatile long m_Count[HISTOGRAM_BUCKETS];
+
+  public:
+    LatencyHistogram();
+
+  public:
+    static int bucketIndex(const uint64_t value);
+
+    static uint64_t bucketValue(const int index);
+
+    void record(const uint64_t value) {
+      net::ysuga::atomicAdd(&m_Count[bucketIndex(value)], 1);
+    }
+
+    /**
+     * Counts recorded since 'previous' was taken. previous is updated to now.
+     */
+    void readInterval(HistogramSnapshot& previous, HistogramSnapshot& interval);
+  };
+
+  enum TelemetryStage {
+    STAGE_WRITE,    ///< writing packets to the transport
+    STAGE_ACK,      ///< waiting for ack
+    STAGE_READ,     ///< waiting for joint angle reply
+    STAGE_CYCLE,    ///< one set/get cycle
+    STAGE_CONVERT,  ///< InPort read and target conversion in onExecute
+    STAGE_PUBLISH,  ///< current angle conversion and OutPort write in onExecute
+    STAGE_EXECUTE,  ///< whole onExecute
+    STAGE_JITTER,   ///< difference between the durations of consecutive cycles
+    NUM_STAGE
+  };
+
+  enum TelemetryCounter {
+    COUNTER_NACK,
+    COUNTER_TIMEOUT,
+    COUNTER_FRAME_ERROR,
+    COUNTER_RESYNC,       ///< stray bytes skipped to find a reply
+    COUNTER_RECONNECT,    ///< link reopened after an error
+    NUM_COUNTER
+  };
+
+  /**
+   * Latency of each stage of the control cycle and error counters.
+   *
+   * Stages are timed only while enabled, so that a disabled instance costs
+   * no clock reads. Counters are always maintained.
+   */
+  class Telemetry {
+  private:
+    volatile long m_Enabled;
+    LatencyHistogram m_Stage[NUM_STAGE];
+    volatile long m_Counter[NUM_COUNTER];
+    uint64_t m_LastCycle;
+
+  public:
+    Telemetry();
+
+  public:
+    void setEnabled(const bool on) {
+      net::ysuga::atomicStore(&m_Enabled, on ? 1 : 0);
+    }
+
+    bool isEnabled() {
+      return net::ysuga::atomicLoad(&m_Enabled) != 0;
+    }
+
+    /**
+     * Start time of a stage, 0 when disabled.
+     */
+    uint64_t start() {
+      return isEnabled() ? net::ysuga::monotonicNanos() : 0;
+    }
+
+    /**
+     * Record stage which began at 'since' (returned by start()).
+     * @return now, so that the next stage can start from here (0 when disabled).
+     */
+    uint64_t record(const TelemetryStage stage, const uint64_t since) {
+      if (since == 0 || !isEnabled()) {
+        return 0;
+      }
+      uint64_t now = net::ysuga::monotonicNanos();
+      m_Stage[stage].record(now - since);
+      return now;
+    }
+
+    /**
+     * Record STAGE_CYCLE which began at 'since', and its difference from
+     * the previous cycle as STAGE_JITTER. Called by one thread at a time.
+     * @return now (0 when disabled).
+     */
+    uint64_t recordCycle(const uint64_t since) {
+      uint64_t now = record(STAGE_CYCLE, since);
+      if (now == 0) {
+        m_LastCycle = 0;
+        return 0;
+      }
+      uint64_t cycle = now - since;
+      if (m_LastCycle) {
+        m_Stage[STAGE_JITTER].record(cycle > m_LastCycle ? cycle - m_LastCycle : m_LastCycle - cycle);
+      }
+      m_LastCycle = cycle;
+      return now;
+    }
+
+    void count(const TelemetryCounter counter, const long n = 1) {
+      net::ysuga::atomicAdd(&m_Counter[counter], n);
+    }
+
+    long getCount(const TelemetryCounter counter) {
+      return net::ysuga::atomicLoad(&m_Counter[counter]);
+    }
+
+    LatencyHistogram& getHistogram(const TelemetryStage stage) {
+      return m_Stage[stage];
+    }
+  };
+
+};
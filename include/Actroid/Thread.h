@@ -0,0 +1,235 @@
+/********************************************************
+ * Thread.h
+ *
+ * Portable Thread Class Library for Windows and Unix.
+ * @date 2026/10/17
+ ********************************************************/
+
+#ifndef THREAD_HEADER_INCLUDED
+#define THREAD_HEADER_INCLUDED
+
+#include <exception>
+#include <string>
+#include <stdint.h>
+
+#ifndef LIBYSUGA_API
+#if defined(WIN32) && defined(LIBYSUGA_EXPORTS)
+#define LIBYSUGA_API __declspec(dllexport)
+#else
+#define LIBYSUGA_API
+#endif
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace net {
+	namespace ysuga {
+
+		/**
+		 * @brief This exception is thrown when thread can not be started.
+		 */
+		class LIBYSUGA_API ThreadException : public std::exception {
+		private:
+			std::string msg;
+		public:
+			ThreadException(const char* msg) {this->msg = msg;}
+			virtual ~ThreadException() throw() {}
+		public:
+			const char* what() const throw() {return msg.c_str();}
+		};
+
+		/***************************************************
+		 * Thread
+		 *
+		 * @brief Portable Thread Class. Override run().
+		 ***************************************************/
+		class LIBYSUGA_API Thread
+		{
+		private:
+#ifdef WIN32
+			HANDLE m_hThread;
+#else
+			pthread_t m_Thread;
+#endif
+			bool m_Started;
+
+		public:
+			/**
+			 * @brief Constructor
+			 */
+			Thread();
+
+			/**
+			 * @brief Destructor. Thread must be joined before.
+			 */
+			virtual ~Thread();
+
+		public:
+			/**
+			 * @brief start thread. run() is called in the new thread.
+			 */
+			void start();
+
+			/**
+			 * @brief wait until run() returns.
+			 */
+			void join();
+
+			/**
+			 * @brief thread body.
+			 */
+			virtual void run() = 0;
+
+		public:
+			/**
+			 * @brief sleep current thread.
+			 * @param milliSeconds sleep time [ms]
+			 */
+			static void sleep(const unsigned long milliSeconds);
+
+			/**
+			 * @brief run current thread under SCHED_FIFO (time critical priority on Windows).
+			 * @param priority 1-99, or 0 for default scheduling
+			 * @return false if not permitted (e.g. without CAP_SYS_NICE)
+			 */
+			static bool setCurrentPriority(const int priority);
+
+			/**
+			 * @brief pin current thread to CPUs (bit i: CPU i).
+			 * @return false if not permitted or not supported
+			 */
+			static bool setCurrentAffinity(const uint64_t cpuMask);
+
+			/**
+			 * @brief touch bytes of stack below the caller, so that they are
+			 * not faulted in later. Must be well below the stack size.
+			 */
+			static void prefaultStack(const unsigned long bytes);
+		};
+
+		/***************************************************
+		 * Mutex
+		 *
+		 * @brief Portable mutual exclusion (not recursive).
+		 ***************************************************/
+		class LIBYSUGA_API Mutex
+		{
+		private:
+#ifdef WIN32
+			CRITICAL_SECTION m_Section;
+#else
+			pthread_mutex_t m_Mutex;
+#endif
+
+			Mutex(const Mutex&);
+			Mutex& operator=(const Mutex&);
+
+		public:
+			Mutex();
+			~Mutex();
+
+		public:
+			void lock();
+			void unlock();
+		};
+
+		/**
+		 * @brief locks a Mutex for the scope of the guard.
+		 */
+		class MutexGuard
+		{
+		private:
+			Mutex& m_Mutex;
+
+		public:
+			MutexGuard(Mutex& mutex) : m_Mutex(mutex) {m_Mutex.lock();}
+			~MutexGuard() {m_Mutex.unlock();}
+		};
+
+		/**
+		 * @brief parse CPU list such as "2" or "0,2-3" into a mask (bit i: CPU i, up to 63).
+		 * @return false on syntax error
+		 */
+		LIBYSUGA_API bool parseCpuList(const char* list, uint64_t& cpuMask);
+
+		/**
+		 * @brief lock pages mapped by the process now into memory (mlockall).
+		 * Later mappings are not locked, so that thread creation does not
+		 * fail against RLIMIT_MEMLOCK.
+		 * @return false if not permitted (e.g. RLIMIT_MEMLOCK) or not supported
+		 */
+		LIBYSUGA_API bool lockMemory();
+
+		/**
+		 * @brief monotonic clock [ns]. Not affected by system time change.
+		 */
+		LIBYSUGA_API uint64_t monotonicNanos();
+
+		/**
+		 * @brief atomic operations with full memory barrier.
+		 */
+		inline long atomicLoad(volatile long* p) {
+#ifdef WIN32
+			return InterlockedCompareExchange(p, 0, 0);
+#else
+			return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#endif
+		}
+
+		inline void atomicStore(volatile long* p, const long value) {
+#ifdef WIN32
+			InterlockedExchange(p, value);
+#else
+			__atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+#endif
+		}
+
+		inline long atomicExchange(volatile long* p, const long value) {
+#ifdef WIN32
+			return InterlockedExchange(p, value);
+#else
+			return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST);
+#endif
+		}
+
+		inline long atomicAdd(volatile long* p, const long value) {
+#ifdef WIN32
+			return InterlockedExchangeAdd(p, value) + value;
+#else
+			return __atomic_add_fetch(p, value, __ATOMIC_SEQ_CST);
+#endif
+		}
+
+		/**
+		 * @brief store value if *p equals expected.
+		 * @return previous value of *p
+		 */
+		inline long atomicCompareExchange(volatile long* p, const long expected, const long value) {
+#ifdef WIN32
+			return InterlockedCompareExchange(p, value, expected);
+#else
+			long previous = expected;
+			__atomic_compare_exchange_n(p, &previous, value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+			return previous;
+#endif
+		}
+
+		/**
+		 * @brief full memory barrier, e.g. between the data and the sequence of a seqlock.
+		 */
+		inline void atomicFence() {
+#ifdef WIN32
+			MemoryBarrier();
+#else
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+		}
+
+	};//namespace ysuga
+};//namespace net
+
+#endif
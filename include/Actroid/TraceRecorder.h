@@ -0,0 +1,110 @@
+/********************************************************
+ * TraceRecorder.h
+ *
+ * Binary trace of serial traffic in a memory mapped ring file.
+ * @date 2026/10/17
+ ********************************************************/
+
+#ifndef TRACE_RECORDER_HEADER_INCLUDED
+#define TRACE_RECORDER_HEADER_INCLUDED
+
+#include <stdint.h>
+
+#include "SerialPort.h"
+
+namespace net {
+	namespace ysuga {
+
+#define TRACE_MAGIC "YSTRACE1"
+#define TRACE_RECORD_DATA 48
+
+		enum TraceDirection {
+			TRACE_TX = 0,
+			TRACE_RX = 1
+		};
+
+		/**
+		 * @brief file header. The ring of TraceRecord follows immediately.
+		 */
+		struct TraceHeader {
+			char magic[8];
+			uint32_t recordSize;    ///< sizeof(TraceRecord)
+			uint32_t reserved;
+			uint64_t capacity;      ///< number of records in the ring
+			uint64_t count;         ///< records written since open. record i is at i % capacity.
+			uint64_t startTime;     ///< monotonicNanos() at open
+			uint8_t padding[24];
+		};
+
+		/**
+		 * @brief one chunk of traffic (64 bytes). Longer transfers use several records.
+		 */
+		struct TraceRecord {
+			uint64_t time;          ///< monotonicNanos()
+			uint8_t direction;      ///< TraceDirection
+			uint8_t size;           ///< valid bytes in data
+			uint8_t reserved[6];
+			uint8_t data[TRACE_RECORD_DATA];
+		};
+
+		/***************************************************
+		 * TraceRecorder
+		 *
+		 * @brief Appends timestamped TX/RX records to a ring file.
+		 *
+		 * The file is created with its full size and mapped into
+		 * memory at open, and every page is touched then, so
+		 * record() is a clock read and a copy into mapped memory:
+		 * no system call and no page fault on the I/O path. When
+		 * the ring is full the oldest records are overwritten. The
+		 * header count is advanced after the record is complete,
+		 * so the file stays readable if the process dies.
+		 *
+		 * record() must be called from one thread at a time.
+		 ***************************************************/
+		class LIBYSUGA_API TraceRecorder
+		{
+		private:
+#ifdef WIN32
+			HANDLE m_hFile;
+			HANDLE m_hMapping;
+#else
+			int m_Fd;
+#endif
+			size_t m_MapSize;
+			TraceHeader* m_pHeader;
+			TraceRecord* m_pRecord;
+
+		public:
+			/**
+			 * @brief Constructor. Create (or overwrite) filename.
+			 *
+			 * @param filename trace file
+			 * @param capacity number of records in the ring (64 bytes each)
+			 * @throw ComException if the file can not be created or mapped.
+			 */
+			TraceRecorder(const char* filename, const unsigned int capacity);
+
+			/**
+			 * @brief Destructor. Unmap and close the file.
+			 */
+			~TraceRecorder();
+
+		public:
+			/**
+			 * @brief append size bytes of traffic in direction.
+			 */
+			void record(const TraceDirection direction, const void* data, const unsigned int size);
+
+			/**
+			 * @brief number of records written since open.
+			 */
+			uint64_t getCount() const {
+				return m_pHeader->count;
+			}
+		};
+
+	};//namespace ysuga
+};//namespace net
+
+#endif
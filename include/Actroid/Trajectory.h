@@ -0,0 +1,145 @@
+/**
+ * @file Trajectory.h
+ * @brief Timed waypoints interpolated at the rate of the control cycle
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ogata_lab {
+
+#define TRAJECTORY_MAX_WAYPOINTS 64
+
+  enum Interpolation {
+    INTERPOLATION_LINEAR,
+    INTERPOLATION_CUBIC   ///< cubic Hermite, at rest on the first and last waypoint
+  };
+
+  /**
+   * Waypoints of NumJoint joints, exchanged with the I/O thread.
+   */
+  template<int NumJoint>
+  struct TrajectoryFrame {
+    long id;
+    int count;                                             ///< 0 stops the trajectory
+    Interpolation interpolation;
+    double time[TRAJECTORY_MAX_WAYPOINTS];                 ///< [s] from start, increasing
+    double angle[TRAJECTORY_MAX_WAYPOINTS][NumJoint];      ///< [rad]
+  };
+
+  /**
+   * Evaluates a TrajectoryFrame at the time of each cycle.
+   *
+   * The angles at start() are an implicit first waypoint at time 0, so a
+   * new trajectory continues from wherever the joints are commanded now.
+   * After the last waypoint its angles are held. The frame is not copied
+   * and must not change while the player uses it.
+   */
+  template<int NumJoint>
+  class TrajectoryPlayer {
+  private:
+    const TrajectoryFrame<NumJoint>* m_pFrame;
+    uint64_t m_StartTime;
+    int m_Segment;
+    double m_Origin[NumJoint];
+    double m_Last[NumJoint];
+
+    // waypoint k, where 0 is the origin and k >= 1 is frame waypoint k-1.
+    double _time(const int k) const {
+      return k == 0 ? 0.0 : m_pFrame->time[k-1];
+    }
+
+    const double* _point(const int k) const {
+      return k == 0 ? m_Origin : m_pFrame->angle[k-1];
+    }
+
+    // velocity at waypoint k (finite difference of neighbours, 0 at both ends).
+    double _tangent(const int k, const int j) const {
+      if (k == 0 || k == m_pFrame->count) {
+        return 0.0;
+      }
+      return (_point(k+1)[j] - _point(k-1)[j]) / (_time(k+1) - _time(k-1));
+    }
+
+  public:
+    TrajectoryPlayer() : m_pFrame(NULL), m_StartTime(0), m_Segment(0) {}
+
+  public:
+    /**
+     * @param origin commanded angles [rad] now
+     */
+    void start(const TrajectoryFrame<NumJoint>* pFrame, const double* origin, const uint64_t now) {
+      m_pFrame = pFrame;
+      m_StartTime = now;
+      m_Segment = 0;
+      for (int j = 0;j < NumJoint;j++) {
+        m_Origin[j] = m_Last[j] = origin[j];
+      }
+    }
+
+    void stop() {
+      m_pFrame = NULL;
+    }
+
+    bool isActive() const {
+      return m_pFrame != NULL;
+    }
+
+    long getId() const {
+      return m_pFrame ? m_pFrame->id : 0;
+    }
+
+    /**
+     * Angles [rad] last returned by evaluate().
+     */
+    const double* getLastAngles() const {
+      return m_Last;
+    }
+
+    /**
+     * Angles [rad] at now (monotonicNanos()). now must not go back.
+     * @return false if the last waypoint has been reached.
+     */
+    bool evaluate(const uint64_t now, double* angles) {
+      const int last = m_pFrame->count;
+      double t = (now - m_StartTime) * 1e-9;
+      while (m_Segment < last && t >= _time(m_Segment+1)) {
+        m_Segment++;
+      }
+      if (m_Segment == last) {
+        const double* p = _point(last);
+        for (int j = 0;j < NumJoint;j++) {
+          angles[j] = m_Last[j] = p[j];
+        }
+        return false;
+      }
+
+      const int k = m_Segment;
+      const double h = _time(k+1) - _time(k);
+      const double s = (t - _time(k)) / h;
+      const double* p0 = _point(k);
+      const double* p1 = _point(k+1);
+      if (m_pFrame->interpolation == INTERPOLATION_LINEAR) {
+        for (int j = 0;j < NumJoint;j++) {
+          angles[j] = m_Last[j] = p0[j] + (p1[j] - p0[j]) * s;
+        }
+      } else {
+        const double s2 = s * s, s3 = s2 * s;
+        const double h00 = 2 * s3 - 3 * s2 + 1;
+        const double h10 = s3 - 2 * s2 + s;
+        const double h01 = -2 * s3 + 3 * s2;
+        const double h11 = s3 - s2;
+        for (int j = 0;j < NumJoint;j++) {
+          angles[j] = m_Last[j] = h00 * p0[j] + h10 * h * _tangent(k, j)
+            + h01 * p1[j] + h11 * h * _tangent(k+1, j);
+        }
+      }
+      return true;
+    }
+  };
+
+};
@@ -0,0 +1,87 @@
+/**
+ * @file WriteScheduler.h
+ * @brief Priority lanes for target angle writes
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ogata_lab {
+
+  /**
+   * Named range of joints whose changes must be sent within 'deadline' [ms].
+   */
+  struct JointLane {
+    std::string name;
+    int start;
+    int count;
+    int deadline;
+    bool dirty;
+    uint64_t dirtySince;
+  };
+
+  /**
+   * Decides when changed targets are sent.
+   *
+   * A set packet always carries all joints. When a lane's targets differ
+   * from the last written ones, the lane becomes dirty, and a set packet
+   * is due once the lane has been dirty for its deadline. Lanes with a
+   * short deadline (face, lip-sync) go out on the next link slot, while
+   * changes in lanes with a long deadline (body) are coalesced into
+   * fewer packets. Joints outside any lane are sent immediately.
+   */
+  class WriteScheduler {
+  private:
+    std::vector<JointLane> m_Lanes;
+    int m_NumJoint;
+
+  public:
+    WriteScheduler(const int numJoint) : m_NumJoint(numJoint) {}
+
+    ~WriteScheduler() {}
+
+  public:
+    /**
+     * @return false if the range is out of joints or deadline is negative.
+     */
+    bool addLane(const char* name, const int start, const int count, const int deadlineMs);
+
+    /**
+     * Replace lanes by a spec such as "face:0:5:0,body:5:19:50"
+     * (name:start:count:deadline[ms], comma separated). Empty spec removes all lanes.
+     * @return false if the spec is invalid. Lanes are unchanged then.
+     */
+    bool parse(const std::string& spec);
+
+    void clear() {
+      m_Lanes.clear();
+    }
+
+    bool empty() const {
+      return m_Lanes.empty();
+    }
+
+    const std::vector<JointLane>& getLanes() const {
+      return m_Lanes;
+    }
+
+    /**
+     * @param target targets to be sent.
+     * @param written targets sent last time.
+     * @param now monotonic time [ns]
+     * @return true if a set packet should be sent now.
+     */
+    bool isDue(const uint8_t* target, const uint8_t* written, const uint64_t now);
+
+    /**
+     * Clear dirty state after a set packet has been acknowledged.
+     */
+    void onWritten();
+  };
+
+};
@@ -7,7 +7,17 @@
  * $Id$
  */
 
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+
 #include "Actroid.h"
+#include "ActroidReactor.h"
+
+/**
+ * Drives the links of every Actroid component of the process with shared_io.
+ */
+static ogata_lab::ActroidReactor s_reactor;
 
 // Module specification
 // <rtc-template block="module_spec">
@@ -21,17 +31,90 @@ static const char* actroid_spec[] =
     "category",          "Experimenta",
     "activity_type",     "PERIODIC",
     "kind",              "DataFlowComponent",
-    "max_instance",      "1",
+    "max_instance",      "8",
     "language",          "C++",
     "lang_type",         "compile",
     // Configuration variables
     "conf.default.debug", "1",
     "conf.default.port", "COM2",
+    "conf.default.daemon", "",
+    "conf.default.timeout", "200",
+    "conf.default.io_thread", "1",
+    "conf.default.shared_io", "0",
+    "conf.default.pipeline", "1",
+    "conf.default.command_window", "0",
+    "conf.default.suppress_unchanged", "1",
+    "conf.default.keepalive", "1000",
+    "conf.default.read_groups", "",
+    "conf.default.calibration", "",
+    "conf.default.write_lanes", "",
+    "conf.default.telemetry_period", "1000",
+    "conf.default.trace_file", "",
+    "conf.default.trace_capacity", "65536",
+    "conf.default.trajectory_interpolation", "cubic",
+    "conf.default.partial_update", "0",
+    "conf.default.estimator", "0",
+    "conf.default.estimator_alpha", "0.5",
+    "conf.default.estimator_beta", "0.1",
+    "conf.default.estimator_horizon", "0.1",
+    "conf.default.rt_priority", "0",
+    "conf.default.rt_cpus", "",
+    "conf.default.rt_lock_memory", "0",
+    "conf.default.rt_stack_prefault", "64",
+    "conf.default.nack_retries", "2",
+    "conf.default.reconnect_min", "10",
+    "conf.default.reconnect_max", "1000",
     // Widget
     "conf.__widget__.debug", "text",
     "conf.__widget__.port", "text",
+    "conf.__widget__.daemon", "text",
+    "conf.__widget__.timeout", "text",
+    "conf.__widget__.io_thread", "radio",
+    "conf.__widget__.shared_io", "radio",
+    "conf.__widget__.pipeline", "radio",
+    "conf.__widget__.command_window", "spin",
+    "conf.__widget__.suppress_unchanged", "radio",
+    "conf.__widget__.keepalive", "text",
+    "conf.__widget__.read_groups", "text",
+    "conf.__widget__.calibration", "text",
+    "conf.__widget__.write_lanes", "text",
+    "conf.__widget__.telemetry_period", "text",
+    "conf.__widget__.trace_file", "text",
+    "conf.__widget__.trace_capacity", "text",
+    "conf.__widget__.trajectory_interpolation", "radio",
+    "conf.__widget__.partial_update", "radio",
+    "conf.__widget__.estimator", "radio",
+    "conf.__widget__.estimator_alpha", "text",
+    "conf.__widget__.estimator_beta", "text",
+    "conf.__widget__.estimator_horizon", "text",
+    "conf.__widget__.rt_priority", "spin",
+    "conf.__widget__.rt_cpus", "text",
+    "conf.__widget__.rt_lock_memory", "radio",
+    "conf.__widget__.rt_stack_prefault", "text",
+    "conf.__widget__.nack_retries", "spin",
+    "conf.__widget__.reconnect_min", "text",
+    "conf.__widget__.reconnect_max", "text",
 	"exec_cxt.periodic.rate", "10",
     // Constraints
+    "conf.__constraints__.io_thread", "(0,1)",
+    "conf.__constraints__.shared_io", "(0,1)",
+    "conf.__constraints__.pipeline", "(0,1)",
+    "conf.__constraints__.command_window", "0<=x<=16",
+    "conf.__constraints__.suppress_unchanged", "(0,1)",
+    "conf.__constraints__.telemetry_period", "x>=0",
+    "conf.__constraints__.trace_capacity", "x>=1",
+    "conf.__constraints__.trajectory_interpolation", "(linear,cubic)",
+    "conf.__constraints__.partial_update", "(0,1)",
+    "conf.__constraints__.estimator", "(0,1)",
+    "conf.__constraints__.estimator_alpha", "0<x<=1",
+    "conf.__constraints__.estimator_beta", "0<=x<2",
+    "conf.__constraints__.estimator_horizon", "x>=0",
+    "conf.__constraints__.rt_priority", "0<=x<=99",
+    "conf.__constraints__.rt_lock_memory", "(0,1)",
+    "conf.__constraints__.rt_stack_prefault", "0<=x<=512",
+    "conf.__constraints__.nack_retries", "0<=x<=10",
+    "conf.__constraints__.reconnect_min", "x>=1",
+    "conf.__constraints__.reconnect_max", "x>=0",
     ""
   };
 // </rtc-template>
@@ -44,9 +127,14 @@ Actroid::Actroid(RTC::Manager* manager)
     // <rtc-template block="initializer">
   : RTC::DataFlowComponentBase(manager),
     m_targetJointIn("targetJoint", m_targetJoint),
-    m_currentJointOut("currentJoint", m_currentJoint)
+    m_targetFaceIn("targetFace", m_targetFace),
+    m_targetTrajectoryIn("targetTrajectory", m_targetTrajectory),
+    m_currentJointOut("currentJoint", m_currentJoint),
+    m_currentJointStateOut("currentJointState", m_currentJointState),
+    m_telemetryOut("telemetry", m_telemetry)
 
     // </rtc-template>
+    , m_pActroid(NULL), m_pClient(NULL), m_configChanged(0), m_appliedTraceCapacity(0), m_linkDown(false)
 {
 }
 
@@ -65,9 +153,13 @@ RTC::ReturnCode_t Actroid::onInitialize()
   // <rtc-template block="registration">
   // Set InPort buffers
   addInPort("targetJoint", m_targetJointIn);
+  addInPort("targetFace", m_targetFaceIn);
+  addInPort("targetTrajectory", m_targetTrajectoryIn);
   
   // Set OutPort buffer
   addOutPort("currentJoint", m_currentJointOut);
+  addOutPort("currentJointState", m_currentJointStateOut);
+  addOutPort("telemetry", m_telemetryOut);
   
   // Set service provider to Ports
   
@@ -81,17 +173,58 @@ RTC::ReturnCode_t Actroid::onInitialize()
   // Bind variables and configuration variable
   bindParameter("debug", m_debug, "1");
   bindParameter("port", m_port, "COM1");
+  bindParameter("daemon", m_daemon, "");
+  bindParameter("timeout", m_timeout, "200");
+  bindParameter("io_thread", m_ioThread, "1");
+  bindParameter("shared_io", m_sharedIo, "0");
+  bindParameter("pipeline", m_pipeline, "1");
+  bindParameter("command_window", m_commandWindow, "0");
+  bindParameter("suppress_unchanged", m_suppressUnchanged, "1");
+  bindParameter("keepalive", m_keepalive, "1000");
+  bindParameter("read_groups", m_readGroups, "");
+  bindParameter("calibration", m_calibration, "");
+  bindParameter("write_lanes", m_writeLanes, "");
+  bindParameter("telemetry_period", m_telemetryPeriod, "1000");
+  bindParameter("trace_file", m_traceFile, "");
+  bindParameter("trace_capacity", m_traceCapacity, "65536");
+  bindParameter("trajectory_interpolation", m_trajectoryInterpolation, "cubic");
+  bindParameter("partial_update", m_partialUpdate, "0");
+  bindParameter("estimator", m_estimator, "0");
+  bindParameter("estimator_alpha", m_estimatorAlpha, "0.5");
+  bindParameter("estimator_beta", m_estimatorBeta, "0.1");
+  bindParameter("estimator_horizon", m_estimatorHorizon, "0.1");
+  bindParameter("rt_priority", m_rtPriority, "0");
+  bindParameter("rt_cpus", m_rtCpus, "");
+  bindParameter("rt_lock_memory", m_rtLockMemory, "0");
+  bindParameter("rt_stack_prefault", m_rtStackPrefault, "64");
+  bindParameter("nack_retries", m_nackRetries, "2");
+  bindParameter("reconnect_min", m_reconnectMin, "10");
+  bindParameter("reconnect_max", m_reconnectMax, "1000");
   // </rtc-template>
+
+  // output sequences are sized once here and keep their buffers, so
+  // onExecute only fills them in.
+  m_currentJoint.data.length(ogata_lab::ActroidBase::NUM_JOINT);
+  m_currentJointState.data.length(ogata_lab::ActroidBase::NUM_JOINT * 2 + 1);
+  m_telemetry.data.length(ogata_lab::NUM_STAGE * 5 + 8);
+
+  // changes are applied by the next onExecute, on the thread which owns m_pActroid.
+  addConfigurationSetNameListener(ON_UPDATE_CONFIG_SET, new ActroidConfigListener(&m_configChanged));
+  addConfigurationSetNameListener(ON_ACTIVATE_CONFIG_SET, new ActroidConfigListener(&m_configChanged));
   
   return RTC::RTC_OK;
 }
 
-/*
+
 RTC::ReturnCode_t Actroid::onFinalize()
 {
+  // the session outlives activations, so the port is closed only here.
+  delete m_pActroid;
+  m_pActroid = NULL;
+  delete m_pClient;
+  m_pClient = NULL;
   return RTC::RTC_OK;
 }
-*/
 
 /*
 RTC::ReturnCode_t Actroid::onStartup(RTC::UniqueId ec_id)
@@ -110,50 +243,458 @@ RTC::ReturnCode_t Actroid::onShutdown(RTC::UniqueId ec_id)
 
 RTC::ReturnCode_t Actroid::onActivated(RTC::UniqueId ec_id)
 {
+  net::ysuga::atomicStore(&m_configChanged, 0);
+  m_droppedSamples = 0;
+  if (!m_daemon.empty()) {
+    // actroidd owns the port, so a session of this component is closed.
+    delete m_pActroid;
+    m_pActroid = NULL;
+    m_appliedTraceFile.clear();
+    m_appliedTraceCapacity = 0;
+    if (!m_pClient || m_pClient->getName() != m_daemon) {
+      delete m_pClient;
+      m_pClient = NULL;
+      m_pClient = new ogata_lab::ActroidClient(m_daemon.c_str());
+    }
+    // requests are made from onExecute, which must not wait for the daemon.
+    m_pClient->setTimeout(m_timeout);
+    return RTC::RTC_OK;
+  }
+  delete m_pClient;
+  m_pClient = NULL;
+
   // Here for Actroid, open COM port and initialize each joints.
-  m_pActroid = new ogata_lab::ActroidBase(m_port.c_str());
-  m_currentJoint.data.length(NUM_JOINT);
+  // The port stays open after deactivation, so only the first activation opens it.
+  bool opened = false;
+  if (!m_pActroid) {
+    m_pActroid = new ogata_lab::ActroidBase(m_port.c_str());
+    opened = true;
+  }
+  configureLayout();
+  configure();
+  for (int i = 0;i < ogata_lab::NUM_STAGE;i++) {
+    m_telemetryLast[i] = ogata_lab::HistogramSnapshot();
+  }
+  m_telemetryTime = net::ysuga::monotonicNanos();
+  checkRate(ec_id);
 
-  //for (uint32_t i = 0;i < NUM_JOINT;i++) {
-   // m_pActroid->setTargetAngle(i, 0);
-  //}
-  m_pActroid->updateTargetAngles();
+  if (opened) {
+    m_pActroid->updateTargetAngles();
+  }
+  startLink();
   return RTC::RTC_OK;
 }
 
 
 RTC::ReturnCode_t Actroid::onDeactivated(RTC::UniqueId ec_id)
 {
-  // Here, finalize (cleanup) Actroid.
-  delete m_pActroid;
+  // Here, the I/O thread is stopped; the controller stays online and
+  // holds the last targets until the next activation.
+  if (m_pActroid) {
+    m_pActroid->stopIoThread();
+  }
   return RTC::RTC_OK;
 }
 
+void Actroid::configure()
+{
+  m_pActroid->setPipelined(m_pipeline != 0);
+  m_pActroid->setSuppressUnchanged(m_suppressUnchanged != 0);
+  m_pActroid->setKeepAliveInterval(m_keepalive);
+  m_pActroid->setEstimatorGains(m_estimatorAlpha, m_estimatorBeta);
+  m_pActroid->setEstimatorHorizon(m_estimatorHorizon);
+  m_pActroid->setNackRetries(m_nackRetries);
+  m_pActroid->setReconnectBackoff(m_reconnectMin, m_reconnectMax);
+  m_pActroid->getTelemetry().setEnabled(m_telemetryPeriod > 0);
+}
+
+void Actroid::configureLayout()
+{
+  if (m_port != m_pActroid->getPortName()) {
+    try {
+      m_pActroid->reopen(m_port.c_str());
+      m_linkDown = false;
+    } catch (ogata_lab::ActroidException& e) {
+      // retried by the I/O thread or by updateLink().
+      if (m_reconnectMax <= 0) {
+        throw;
+      }
+      std::cerr << "[Actroid] can not open " << m_port << " (" << e.what() << "), reconnecting." << std::endl;
+    }
+  }
+  m_pActroid->setTimeout(m_timeout);
+  m_pActroid->setCommandWindow(m_commandWindow);
+  m_pActroid->setReadSchedule(m_readGroups.c_str());
+  m_pActroid->setWriteLanes(m_writeLanes.c_str());
+  m_pActroid->setCalibration(m_calibration.c_str());
+  m_pActroid->setIoThreadPriority(m_rtPriority);
+  m_pActroid->setIoThreadAffinity(m_rtCpus.c_str());
+  m_pActroid->setLockMemory(m_rtLockMemory != 0);
+  m_pActroid->setStackPrefault(m_rtStackPrefault);
+  if (m_traceFile != m_appliedTraceFile || m_traceCapacity != m_appliedTraceCapacity) {
+    m_pActroid->stopTrace();
+    // cleared first, so that a trace which fails to start is started again on restore.
+    m_appliedTraceFile.clear();
+    m_appliedTraceCapacity = 0;
+    if (!m_traceFile.empty()) {
+      m_pActroid->startTrace(m_traceFile.c_str(), m_traceCapacity);
+    }
+    m_appliedTraceFile = m_traceFile;
+    m_appliedTraceCapacity = m_traceCapacity;
+  }
+  m_appliedLayout = layout();
+}
+
+std::string Actroid::layout() const
+{
+  std::ostringstream os;
+  os << m_port << '\n' << m_ioThread << '\n' << m_sharedIo << '\n' << m_timeout << '\n' << m_commandWindow << '\n'
+     << m_readGroups << '\n' << m_writeLanes << '\n' << m_calibration << '\n'
+     << m_rtPriority << '\n' << m_rtCpus << '\n' << m_rtLockMemory << '\n'
+     << m_rtStackPrefault << '\n' << m_traceFile << '\n' << m_traceCapacity;
+  return os.str();
+}
+
+void Actroid::setLayout(const std::string& layout)
+{
+  std::istringstream is(layout);
+  std::string line;
+  std::getline(is, m_port);
+  std::getline(is, line); m_ioThread = atoi(line.c_str());
+  std::getline(is, line); m_sharedIo = atoi(line.c_str());
+  std::getline(is, line); m_timeout = atoi(line.c_str());
+  std::getline(is, line); m_commandWindow = atoi(line.c_str());
+  std::getline(is, m_readGroups);
+  std::getline(is, m_writeLanes);
+  std::getline(is, m_calibration);
+  std::getline(is, line); m_rtPriority = atoi(line.c_str());
+  std::getline(is, m_rtCpus);
+  std::getline(is, line); m_rtLockMemory = atoi(line.c_str());
+  std::getline(is, line); m_rtStackPrefault = atoi(line.c_str());
+  std::getline(is, m_traceFile);
+  std::getline(is, line); m_traceCapacity = atoi(line.c_str());
+}
+
+void Actroid::reconfigure()
+{
+  if (layout() == m_appliedLayout) {
+    configure();
+    return;
+  }
+  // the port stays open (unless it is the one changed) while the thread is restarted.
+  m_pActroid->stopIoThread();
+  try {
+    configureLayout();
+  } catch (ogata_lab::ActroidException& e) {
+    // the link is restarted with the layout it had; the configuration set keeps the values asked for.
+    std::cerr << "[Actroid] configuration not applied (" << e.what() << "), keeping the previous one." << std::endl;
+    const std::string requested = layout();
+    setLayout(m_appliedLayout);
+    try {
+      configureLayout();
+    } catch (ogata_lab::ActroidException&) {
+      setLayout(requested);
+      throw;
+    }
+    setLayout(requested);
+  }
+  configure();
+  startLink();
+}
+
+void Actroid::reconfigureClient()
+{
+  m_pClient->setTimeout(m_timeout);
+  // actroidd takes no configuration on its control socket.
+  std::cerr << "[Actroid] attached to actroidd " << m_pClient->getName()
+            << ": only timeout is applied, the link keeps the settings of the daemon";
+  if (m_daemon != m_pClient->getName()) {
+    std::cerr << "; daemon " << m_daemon << " is attached on the next activation";
+  }
+  std::cerr << "." << std::endl;
+}
+
+void Actroid::startLink()
+{
+  if (m_ioThread) {
+    // a link lost meanwhile is recovered by the thread.
+    m_linkDown = false;
+    if (m_sharedIo) {
+      uint64_t mask;
+      // the options of the component which starts the shared thread apply.
+      s_reactor.setThreadPriority(m_rtPriority);
+      if (net::ysuga::parseCpuList(m_rtCpus.c_str(), mask)) {
+        s_reactor.setThreadAffinity(mask);
+      }
+      m_pActroid->startIoThread(&s_reactor);
+    } else {
+      m_pActroid->startIoThread();
+    }
+  } else if (!m_linkDown && (m_pActroid->isStale() || !m_pActroid->isConnected())) {
+    m_linkDown = true;
+    m_reconnectBackoff = m_reconnectMin;
+    m_reconnectTime = 0;
+  }
+}
+
+void Actroid::checkRate(RTC::UniqueId ec_id)
+{
+  const double rate = getExecutionRate(ec_id);
+  if (!m_ioThread && rate > 0 && m_timeout > 1000.0 / rate) {
+    std::cerr << "[Actroid] timeout " << m_timeout << " ms is longer than the period of "
+              << rate << " Hz: a silent controller overruns the cycle." << std::endl;
+  }
+}
+
 
 RTC::ReturnCode_t Actroid::onExecute(RTC::UniqueId ec_id)
 {
   // Here, periodically called method is placed.
 
-  if (m_targetJointIn.isNew()) {
-    m_targetJointIn.read();
-    
-    for (uint32_t i = 0;i < m_targetJoint.data.length();i++) {
-      m_pActroid->setTargetAngle(i, m_targetJoint.data[i]);
+  if (m_pClient) {
+    if (net::ysuga::atomicExchange(&m_configChanged, 0)) {
+      reconfigureClient();
     }
-    m_pActroid->updateTargetAngles();
+    executeClient();
+    return RTC::RTC_OK;
+  }
+
+  if (net::ysuga::atomicExchange(&m_configChanged, 0)) {
+    reconfigure();
+    checkRate(ec_id);
+  }
+
+  ogata_lab::Telemetry& telemetry = m_pActroid->getTelemetry();
+  uint64_t start = telemetry.start();
+  bool updated = false;
+  // a producer faster than this context queues samples; only the newest is applied.
+  if (readTargets(m_targetJointIn, m_targetJoint, 0, ogata_lab::ActroidBase::NUM_JOINT)) {
+    updated = true;
   }
 
-  m_pActroid->updateCurrentAngles();
-  for (int i = 0;i < NUM_JOINT;i++) {
-    m_currentJoint.data[i] = m_pActroid->getCurrentAngle(i);
+  if (readTargets(m_targetFaceIn, m_targetFace,
+                  ogata_lab::ActroidBase::FACE_JOINT_START, ogata_lab::ActroidBase::NUM_FACE_JOINT)) {
+    updated = true;
+  }
+
+  int n = 0;
+  while (m_targetTrajectoryIn.isNew()) {
+    m_targetTrajectoryIn.read();
+    n++;
+  }
+  if (n > 0) {
+    m_droppedSamples += n - 1;
+    submitTrajectory();
+  }
+
+  telemetry.record(ogata_lab::STAGE_CONVERT, start);
+
+  updateLink(updated);
+
+  uint64_t t = telemetry.start();
+  double* age = m_currentJointState.data.get_buffer();
+  double* variance = age + ogata_lab::ActroidBase::NUM_JOINT;
+  variance[ogata_lab::ActroidBase::NUM_JOINT] = (m_linkDown || m_pActroid->isStale()) ? 1 : 0;
+  if (m_estimator) {
+    m_pActroid->getEstimatedAngles(m_currentJoint.data.get_buffer(), age, variance, ogata_lab::ActroidBase::NUM_JOINT);
+  } else {
+    double estimated[ogata_lab::ActroidBase::NUM_JOINT];
+    m_pActroid->getCurrentAngles(m_currentJoint.data.get_buffer(), ogata_lab::ActroidBase::NUM_JOINT);
+    m_pActroid->getEstimatedAngles(estimated, age, variance, ogata_lab::ActroidBase::NUM_JOINT);
   }
   setTimestamp<RTC::TimedDoubleSeq>(m_currentJoint);
  
   m_currentJointOut.write();
+  m_currentJointState.tm = m_currentJoint.tm;
+  m_currentJointStateOut.write();
+  t = telemetry.record(ogata_lab::STAGE_PUBLISH, t);
+  telemetry.record(ogata_lab::STAGE_EXECUTE, start);
+
+  if (t && t - m_telemetryTime >= (uint64_t)m_telemetryPeriod * 1000000) {
+    publishTelemetry(t);
+  }
   
   return RTC::RTC_OK;
 }
 
+void Actroid::executeClient()
+{
+  forwardTargets(m_targetJointIn, m_targetJoint, 0, ogata_lab::ActroidBase::NUM_JOINT);
+  forwardTargets(m_targetFaceIn, m_targetFace,
+                 ogata_lab::ActroidBase::FACE_JOINT_START, ogata_lab::ActroidBase::NUM_FACE_JOINT);
+  // waypoints are interpolated by the daemon; a newer trajectory replaces
+  // an older one there anyway, so only the newest costs a request.
+  int n = 0;
+  while (m_targetTrajectoryIn.isNew()) {
+    m_targetTrajectoryIn.read();
+    n++;
+  }
+  if (n > 0) {
+    m_droppedSamples += n - 1;
+    submitTrajectory();
+  }
+
+  double* age = m_currentJointState.data.get_buffer();
+  double* variance = age + ogata_lab::ActroidBase::NUM_JOINT;
+  bool fresh = m_pClient->getCurrentAngles(m_currentJoint.data.get_buffer(), age, variance,
+                                           ogata_lab::ActroidBase::NUM_JOINT);
+  variance[ogata_lab::ActroidBase::NUM_JOINT] = fresh ? 0 : 1;
+  setTimestamp<RTC::TimedDoubleSeq>(m_currentJoint);
+  m_currentJointOut.write();
+  m_currentJointState.tm = m_currentJoint.tm;
+  m_currentJointStateOut.write();
+}
+
+void Actroid::forwardTargets(InPort<RTC::TimedDoubleSeq>& inport, RTC::TimedDoubleSeq& data,
+                             const int offset, const int size)
+{
+  // writing to the daemon costs a copy, so every sample is passed on in order.
+  while (inport.isNew()) {
+    inport.read();
+    int length = data.data.length();
+    if (length > size) {
+      length = size;
+    }
+    m_pClient->setTargetAngles(offset, data.data.get_buffer(), length);
+  }
+}
+
+void Actroid::updateLink(const bool updated)
+{
+  uint64_t now = net::ysuga::monotonicNanos();
+  try {
+    if (m_linkDown) {
+      if (now < m_reconnectTime) {
+        return;
+      }
+      m_pActroid->reconnect();
+      m_linkDown = false;
+    }
+    if (updated) {
+      m_pActroid->updateAngles();
+    } else {
+      m_pActroid->updateCurrentAngles();
+    }
+  } catch (ogata_lab::ActroidException& e) {
+    // the I/O thread recovers by itself; without it the link is reopened here.
+    if (m_ioThread || m_reconnectMax <= 0) {
+      throw;
+    }
+    if (!m_linkDown) {
+      std::cerr << "[Actroid] link error (" << e.what() << "), reconnecting." << std::endl;
+      m_linkDown = true;
+      m_reconnectBackoff = m_reconnectMin;
+    } else {
+      m_reconnectBackoff = m_reconnectBackoff * 2 < m_reconnectMax ? m_reconnectBackoff * 2 : m_reconnectMax;
+    }
+    m_reconnectTime = net::ysuga::monotonicNanos() + (uint64_t)m_reconnectBackoff * 1000000;
+  }
+}
+
+bool Actroid::readTargets(InPort<RTC::TimedDoubleSeq>& inport, RTC::TimedDoubleSeq& data,
+                          const int offset, const int size)
+{
+  int n = 0;
+  while (inport.isNew()) {
+    inport.read();
+    n++;
+    if (m_partialUpdate) {
+      // NaN leaves the joint as it is, so every sample is merged in order.
+      for (int i = 0;i < (int)data.data.length() && i < size;i++) {
+        if (data.data[i] == data.data[i]) {
+          m_pActroid->setTargetAngle(offset + i, data.data[i]);
+        }
+      }
+    }
+  }
+  if (n == 0) {
+    return false;
+  }
+  m_droppedSamples += n - 1;
+  if (!m_partialUpdate) {
+    int length = data.data.length();
+    if (length > size) {
+      length = size;
+    }
+    if (offset == 0) {
+      m_pActroid->setTargetAngles(data.data.get_buffer(), length);
+    } else {
+      for (int i = 0;i < length;i++) {
+        m_pActroid->setTargetAngle(offset + i, data.data[i]);
+      }
+    }
+  }
+  return true;
+}
+
+void Actroid::submitTrajectory()
+{
+  const int stride = ogata_lab::ActroidBase::NUM_JOINT + 1;
+  const int length = m_targetTrajectory.data.length();
+  if (length == 0) {
+    try {
+      if (m_pClient) {
+        m_pClient->stopTrajectory();
+      } else {
+        m_pActroid->stopTrajectory();
+      }
+    } catch (ogata_lab::ActroidException& e) {
+      std::cerr << "[Actroid] targetTrajectory ignored: " << e.what() << std::endl;
+    }
+    return;
+  }
+  if (length % stride != 0 || length / stride > TRAJECTORY_MAX_WAYPOINTS) {
+    std::cerr << "[Actroid] targetTrajectory ignored: length " << length
+              << " is not a multiple of " << stride << " or too long." << std::endl;
+    return;
+  }
+  const int count = length / stride;
+  double time[TRAJECTORY_MAX_WAYPOINTS];
+  double angles[TRAJECTORY_MAX_WAYPOINTS * ogata_lab::ActroidBase::NUM_JOINT];
+  for (int i = 0;i < count;i++) {
+    time[i] = m_targetTrajectory.data[i * stride];
+    for (int j = 0;j < ogata_lab::ActroidBase::NUM_JOINT;j++) {
+      angles[i * ogata_lab::ActroidBase::NUM_JOINT + j] = m_targetTrajectory.data[i * stride + 1 + j];
+    }
+  }
+  const ogata_lab::Interpolation interpolation =
+    m_trajectoryInterpolation == "linear" ? ogata_lab::INTERPOLATION_LINEAR : ogata_lab::INTERPOLATION_CUBIC;
+  try {
+    if (m_pClient) {
+      m_pClient->setTrajectory(time, angles, count, interpolation);
+    } else {
+      m_pActroid->setTrajectory(time, angles, count, interpolation);
+    }
+  } catch (ogata_lab::ActroidException& e) {
+    std::cerr << "[Actroid] targetTrajectory ignored: " << e.what() << std::endl;
+  }
+}
+
+void Actroid::publishTelemetry(const uint64_t now)
+{
+  ogata_lab::Telemetry& telemetry = m_pActroid->getTelemetry();
+  int n = 0;
+  for (int i = 0;i < ogata_lab::NUM_STAGE;i++) {
+    telemetry.getHistogram((ogata_lab::TelemetryStage)i).readInterval(m_telemetryLast[i], m_telemetryInterval);
+    m_telemetry.data[n++] = m_telemetryInterval.total;
+    m_telemetry.data[n++] = m_telemetryInterval.getValueAtPercentile(50) / 1000.0;
+    m_telemetry.data[n++] = m_telemetryInterval.getValueAtPercentile(99) / 1000.0;
+    m_telemetry.data[n++] = m_telemetryInterval.getValueAtPercentile(99.9) / 1000.0;
+    m_telemetry.data[n++] = m_telemetryInterval.getMax() / 1000.0;
+  }
+  m_telemetry.data[n++] = telemetry.getCount(ogata_lab::COUNTER_NACK);
+  m_telemetry.data[n++] = telemetry.getCount(ogata_lab::COUNTER_TIMEOUT);
+  m_telemetry.data[n++] = telemetry.getCount(ogata_lab::COUNTER_FRAME_ERROR);
+  m_telemetry.data[n++] = m_pActroid->getSuppressedFrameCount();
+  m_telemetry.data[n++] = m_pActroid->getIoCycleCount();
+  m_telemetry.data[n++] = m_droppedSamples;
+  m_telemetry.data[n++] = telemetry.getCount(ogata_lab::COUNTER_RESYNC);
+  m_telemetry.data[n++] = telemetry.getCount(ogata_lab::COUNTER_RECONNECT);
+  setTimestamp<RTC::TimedDoubleSeq>(m_telemetry);
+  m_telemetryOut.write();
+  m_telemetryTime = now;
+}
+
 /*
 RTC::ReturnCode_t Actroid::onAborting(RTC::UniqueId ec_id)
 {
@@ -181,12 +722,14 @@ RTC::ReturnCode_t Actroid::onStateUpdate(RTC::UniqueId ec_id)
 }
 */
 
-/*
+
 RTC::ReturnCode_t Actroid::onRateChanged(RTC::UniqueId ec_id)
 {
+  // the I/O thread runs at the rate of the link; only the synchronous cycle depends on this one.
+  checkRate(ec_id);
   return RTC::RTC_OK;
 }
-*/
+
 
 
 
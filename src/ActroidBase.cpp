@@ -8,194 +8,1320 @@
  */
 
 #include "SerialPort.h"
+#include "TraceRecorder.h"
 #include "ActroidBase.h"
+#include "ActroidReactor.h"
 
-#ifdef WIN32
-#define _USE_MATH_DEFINES
-#endif
-#include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <iostream>
 
 using namespace ogata_lab;
 using namespace net::ysuga;
 
+namespace ogata_lab {
+  /**
+   * Background thread which owns the serial port while running.
+   */
+  template<class Model>
+  class ActroidIoThread : public Thread {
+  private:
+    ActroidBaseT<Model>* m_pActroid;
+  public:
+    ActroidIoThread(ActroidBaseT<Model>* pActroid) : m_pActroid(pActroid) {}
+    virtual ~ActroidIoThread() {}
+    virtual void run() {
+      m_pActroid->_ioLoop();
+    }
+  };
 
-static const uint8_t _start = 0xfe;
-static const uint8_t _stop  = 0x01;
-static const uint8_t _get = 0x77;
-static const uint8_t _set = 0x74;
-static const uint8_t _set2 = 0x18;
-static const uint8_t _online = 0x55;
-static const uint8_t _offline = 0xdf;
+  /**
+   * Link of one controller, stepped by an ActroidReactor.
+   */
+  template<class Model>
+  class ActroidReactorClient : public ReactorClient {
+  private:
+    ActroidBaseT<Model>* m_pActroid;
+  public:
+    ActroidReactorClient(ActroidBaseT<Model>* pActroid) : m_pActroid(pActroid) {}
+    virtual ~ActroidReactorClient() {}
+    virtual int getFd() {
+      return m_pActroid->m_pTransport ? m_pActroid->m_pTransport->getFd() : -1;
+    }
+    virtual bool step(const uint64_t now, const bool error, uint64_t& wakeup, bool& relinked) {
+      return m_pActroid->_stepReactor(now, error, wakeup, relinked);
+    }
+  };
+};
 
-static const uint8_t _ack = 0x06;
-static const uint8_t _nack = 0x15;
 
-static const uint8_t _num_joint = 24;
+template<class Model>
+ActroidBaseT<Model>::ActroidBaseT(const char* portName) throw(ActroidException)
+  : m_Calibration(Model::MinAngle, Model::MaxAngle, Model::AngleMargin),
+    m_ReadScheduler(NUM_JOINT), m_WriteScheduler(NUM_JOINT)
+{
+  try {
+    m_pSerialPort = new SerialPort(portName, Model::BAUDRATE);
+  } catch (ComException& e) {
+    throw ActroidException(e.what());
+  }
+  m_PortName = portName;
+  m_pTransport = m_pSerialPort;
+  m_OwnTransport = true;
+  _initialize();
+}
 
-static const uint8_t online_command[] = {_start, _online, _stop};
-static const uint8_t offline_command[] = {_start, _online, _stop};
-static const uint8_t joint_read_command[] = {_start, _get, 0, _num_joint, _stop};
+template<class Model>
+ActroidBaseT<Model>::ActroidBaseT(Transport* pTransport) throw(ActroidException)
+  : m_pTransport(pTransport), m_OwnTransport(false), m_pSerialPort(NULL),
+    m_Calibration(Model::MinAngle, Model::MaxAngle, Model::AngleMargin),
+    m_ReadScheduler(NUM_JOINT), m_WriteScheduler(NUM_JOINT)
+{
+  _initialize();
+}
 
+template<class Model>
+void ActroidBaseT<Model>::_initialize() throw(ActroidException)
+{
+  m_pTrace = NULL;
+  m_Timeout = DEFAULT_TIMEOUT_MS;
+  m_Pipelined = false;
+  m_SuppressUnchanged = true;
+  m_KeepAlive = DEFAULT_KEEPALIVE_MS;
+  m_LastWriteValid = false;
+  m_LastWriteTime = 0;
+  m_SuppressedCount = 0;
+  m_pCommandQueue = NULL;
+  m_CommandWindow = 0;
+  m_pCommandError = NULL;
+  m_CommandTimeout = false;
+  m_pIoThread = NULL;
+  m_pReactor = NULL;
+  m_pReactorClient = NULL;
+  m_Recovering = false;
+  m_NackRetries = 0;
+  m_NackRun = 0;
+  m_SetRejected = false;
+  m_ReconnectMin = DEFAULT_RECONNECT_MIN_MS;
+  m_ReconnectMax = 0;
+  m_Stale = 0;
+  m_IoPriority = 0;
+  m_IoCpuMask = 0;
+  m_LockMemory = false;
+  m_StackPrefault = 0;
+  m_IoRunning = 0;
+  m_IoFailed = 0;
+  m_IoCycleCount = 0;
+  m_TrajectorySubmitted = 0;
+  m_TrajectoryFinished = 0;
+  m_pCommandQueue = new CommandQueue(m_pTransport);
+  const uint8_t online_command[] = {Model::START, Model::ONLINE, Model::STOP};
+  try {
+    _writePacket(online_command, 3);
+  } catch (ActroidException& e) {
+    // the destructor is not called when the constructor throws.
+    delete m_pCommandQueue;
+    if (m_OwnTransport) {
+      delete m_pTransport;
+    }
+    throw;
+  }
 
-#define RADIANS(x) ((x)/180.0*M_PI)
+  m_CurrentRawAngle[0] = NUM_JOINT;
+  for (int i = 0;i < NUM_JOINT;i++) {
+    m_CurrentRawAngle[i+1] = Model::DefaultRawAngle[i];
+    m_CurrentTime[i] = 0;
+    //m_TargetRawAngle[i] = _DefaultRawAngle[i];
+	setTargetAngle(i, Model::DefaultAngle[i]);
+  }
+  memcpy(m_CommandedRawAngle, m_TargetRawAngle, NUM_JOINT);
 
-/*
-static const double _MaxAngle[NUM_JOINT] = {
-  RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255),
-  RADIANS(120.0), RADIANS(58), RADIANS(45), RADIANS(112.312+14.497), RADIANS(90.0), RADIANS(25.833), RADIANS(28.423),
-  RADIANS(120.0), RADIANS(58), RADIANS(45), RADIANS(112.312+14.497), RADIANS(90.0), RADIANS(25.833), RADIANS(28.423),
-  RADIANS(255), RADIANS(255)
-};
-*/
+}
 
-static const double _MaxAngle[NUM_JOINT] = {
-  RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255),
-  RADIANS(120.0), RADIANS(58), RADIANS(45), RADIANS(140), RADIANS(90.0), RADIANS(25.833), RADIANS(28.423),
-  RADIANS(120.0), RADIANS(58), RADIANS(45), RADIANS(140), RADIANS(90.0), RADIANS(25.833), RADIANS(28.423),
-  RADIANS(255), RADIANS(255)
-};
+template<class Model>
+ActroidBaseT<Model>::~ActroidBaseT() throw(ActroidException)
+{
+  stopIoThread();
+  const uint8_t offline_command[] = {Model::START, Model::ONLINE, Model::STOP};
+  if (m_pTransport) {
+    _writePacket(offline_command, 3);
+  }
+  delete m_pCommandQueue;
+  if (m_OwnTransport) {
+    delete m_pTransport;
+  }
+  delete m_pTrace;
+}
 
-/*
-static const double _MinAngle[NUM_JOINT] = {
-  RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0),
-  RADIANS(-14.0), RADIANS(-15.0), RADIANS(-45.0), RADIANS(14.497), RADIANS(-65.0), RADIANS(-15.458), RADIANS(-39.876),
-  RADIANS(-14.0), RADIANS(-15.0), RADIANS(-45.0), RADIANS(14.497), RADIANS(-65.0), RADIANS(-15.458), RADIANS(-39.876),
-  RADIANS(0), RADIANS(0)
-};
-*/
+template<class Model>
+void ActroidBaseT<Model>::_writePacket(const uint8_t* packet, const int len) throw(ActroidException)
+{
+  if (!m_pTransport) {
+    throw ActroidException("Not connected.");
+  }
+  for (int attempt = 0;;attempt++) {
+    uint64_t t = m_Telemetry.start();
+    try {
+      if (m_pTransport->write(packet, len) != len) {
+        throw ActroidException("Packet Write Error");
+      }
+    } catch (ComException& e) {
+      throw ActroidException(e.what());
+    }
+    m_Telemetry.record(STAGE_WRITE, t);
+    try {
+      _readAck();
+      return;
+    } catch (ActroidNackException& e) {
+      if (attempt >= m_NackRetries) {
+        throw;
+      }
+    }
+  }
+}
 
+/**
+ * Read one reply (ack, then replySize bytes of data) with m_Parser, which
+ * skips stray bytes. Only the bytes the reply still needs are read, so the
+ * next reply stays in the transport.
+ * @return REPLY_DONE, REPLY_NACK, or REPLY_PENDING if the reply was broken on the line.
+ * @throw ActroidTimeoutException if nothing arrived before the deadline.
+ */
+template<class Model>
+ReplyStatus ActroidBaseT<Model>::_readReply(const int replySize, uint8_t* reply, const char* timeoutMessage) throw(ActroidException)
+{
+  uint8_t buf[NUM_JOINT+2];
+  const long resync = m_Parser.getResyncCount();
+  const uint64_t deadline = monotonicNanos() + (uint64_t)m_Timeout * 1000000;
+  m_Parser.expect(replySize, reply);
+  try {
+    while (m_Parser.getStatus() == REPLY_PENDING) {
+      uint64_t now = monotonicNanos();
+      int wait = now < deadline ? (int)((deadline - now + 999999) / 1000000) : 0;
+      if (m_pTransport->waitForRxData(wait)) {
+        int size = m_pTransport->readAvailable(buf, m_Parser.getNeeded());
+        m_Parser.parse(buf, size);
+      }
+      // checked on every pass: a hung-up tty polls readable but reads nothing.
+      if (m_Parser.getStatus() == REPLY_PENDING && monotonicNanos() >= deadline) {
+        break;
+      }
+    }
+  } catch (ComException& e) {
+    throw ActroidException(e.what());
+  }
+  if (m_Parser.getResyncCount() != resync) {
+    m_Telemetry.count(COUNTER_RESYNC, m_Parser.getResyncCount() - resync);
+  }
+  if (m_Parser.getStatus() == REPLY_PENDING && !m_Parser.isStarted()) {
+    m_Telemetry.count(COUNTER_TIMEOUT);
+    throw ActroidTimeoutException(timeoutMessage);
+  }
+  return m_Parser.getStatus();
+}
 
-static const double _MinAngle[NUM_JOINT] = {
-  RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0),
-  RADIANS(-18.0), RADIANS(-15.0), RADIANS(-45.0), RADIANS(20), RADIANS(-65.0), RADIANS(-15.458), RADIANS(-39.876),
-  RADIANS(-18.0), RADIANS(-15.0), RADIANS(-45.0), RADIANS(20), RADIANS(-65.0), RADIANS(-15.458), RADIANS(-39.876),
-  RADIANS(0), RADIANS(0)
-};
+template<class Model>
+void ActroidBaseT<Model>::_readAck() throw(ActroidException)
+{
+  uint64_t t = m_Telemetry.start();
+  ReplyStatus status = _readReply(0, NULL, "Ack timeout.");
+  if (status == REPLY_PENDING) {
+    // only stray bytes arrived: the controller did not ack.
+    m_Telemetry.count(COUNTER_TIMEOUT);
+    throw ActroidTimeoutException("Ack timeout.");
+  }
+  m_Telemetry.record(STAGE_ACK, t);
 
-static const double _DefaultAngle[NUM_JOINT] = {
-  RADIANS(128), RADIANS(128), RADIANS(128), RADIANS(128), 
-  RADIANS(0), RADIANS(128), RADIANS(128), RADIANS(128),
-  RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(90),  RADIANS(0), RADIANS(0), RADIANS(0),
-  RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(90),  RADIANS(0), RADIANS(0), RADIANS(0),
-  RADIANS(0), RADIANS(128)
-};
+  if (status != REPLY_DONE) {
+    m_Telemetry.count(COUNTER_NACK);
+    throw ActroidNackException("Nack received.");
+  }
+}
 
+template<class Model>
+static void _buildGetPacket(const int start, const int count, uint8_t* command)
+{
+  command[0] = Model::START;
+  command[1] = Model::GET;
+  command[2] = start;
+  command[3] = count;
+  command[4] = Model::STOP;
+}
 
-static const uint8_t _DefaultRawAngle[NUM_JOINT] = {
-  DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE,
-  DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, 143, 86,
+/**
+ * Check reply of get packet (count + angles) and copy angles into frame.
+ * @return false if the reply is invalid.
+ */
+static bool _mergeReply(const uint8_t* reply, const int start, const int count, uint8_t* frame, uint64_t* time)
+{
+  if(reply[0] != count) {
+    return false;
+  }
+  memcpy(frame + 1 + start, reply + 1, count);
+  uint64_t now = monotonicNanos();
+  for (int i = start;i < start + count;i++) {
+    time[i] = now;
+  }
+  return true;
+}
 
-  128, 218, 128, 128, 128,
-  113, 210, 0, 0, 0,
+template<class Model>
+void ActroidBaseT<Model>::_readRawAngle(uint8_t* frame, uint64_t* time, const int start, const int count) throw(ActroidException)
+{
+  uint8_t command[5];
+  uint8_t reply[NUM_JOINT+1];
+  if (!m_pTransport) {
+    throw ActroidException("Not connected.");
+  }
+  _buildGetPacket<Model>(start, count, command);
+  uint64_t t;
+  ReplyStatus status;
+  for (int attempt = 0;;attempt++) {
+    t = m_Telemetry.start();
+    try {
+      if (m_pTransport->write(command, 5) != 5) {
+        throw ActroidException("Packet Write Error");
+      }
+    } catch (ComException& e) {
+      throw ActroidException(e.what());
+    }
+    t = m_Telemetry.record(STAGE_WRITE, t);
+    status = _readReply(count+1, reply, "Joint angle packet timeout.");
+    if (status != REPLY_NACK) {
+      break;
+    }
+    m_Telemetry.count(COUNTER_NACK);
+    if (attempt >= m_NackRetries) {
+      throw ActroidNackException("Nack received.");
+    }
+  }
+  if (status == REPLY_PENDING) {
+    // broken on the line: keep the previous angles, the next cycle reads them again.
+    m_Telemetry.count(COUNTER_FRAME_ERROR);
+    return;
+  }
+  m_Telemetry.record(STAGE_READ, t);
+  _mergeReply(reply, start, count, frame, time);
+}
 
-  DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE
-};
+template<class Model>
+static void _buildSetPacket(const uint8_t* target, uint8_t* command)
+{
+  command[0] = Model::START;
+  command[1] = Model::SET;
+  command[2] = Model::SET2;
+  
+  uint8_t sum = Model::SET2;
+  for (int i = 0;i < Model::NUM_JOINT;i++) {
+    sum += target[i];
+    command[3 + i] = target[i];
+  }
+  command[3 + Model::NUM_JOINT] = ~sum + 1;
+  command[4 + Model::NUM_JOINT] = Model::STOP;
+}
 
-static const double _AngleMargin[NUM_JOINT] = {
-	0.001, 0.001, 0.001, 0.001, 0.001, 0.001, 0.001, 0.001, 
-	0.040, 0.040, 0.001, 0.1, 0.001, 0.001, 0.001,
-	0.001, 0.001, 0.001, 0.05, 0.001, 0.001, 0.001,
-	0.001, 0.001
+template<class Model>
+void ActroidBaseT<Model>::_writeRawAngle(const uint8_t* target) throw(ActroidException)
+{
+  uint8_t command[NUM_JOINT + 5];
+  _buildSetPacket<Model>(target, command);
+  _writePacket(command, NUM_JOINT+5);
+  _onWriteAcked(target);
+}
 
-};
+template<class Model>
+void ActroidBaseT<Model>::_writeReadRawAngle(const uint8_t* target, uint8_t* frame, uint64_t* time, const int start, const int count) throw(ActroidException)
+{
+  uint8_t command[NUM_JOINT + 5];
+  uint8_t getCommand[5];
+  uint8_t reply[NUM_JOINT+1];
+  if (!m_pTransport) {
+    throw ActroidException("Not connected.");
+  }
+  _buildSetPacket<Model>(target, command);
+  _buildGetPacket<Model>(start, count, getCommand);
+
+  // set and get packets leave in one write, and their replies (ack, ack, joint angles)
+  // are parsed as one stream. This saves one turnaround of the link.
+  IoBuffer buffers[2];
+  buffers[0].data = command;
+  buffers[0].size = NUM_JOINT + 5;
+  buffers[1].data = getCommand;
+  buffers[1].size = sizeof(getCommand);
+
+  uint64_t t = m_Telemetry.start();
+  try {
+    if (m_pTransport->writev(buffers, 2) != NUM_JOINT + 5 + (int)sizeof(getCommand)) {
+      throw ActroidException("Packet Write Error");
+    }
+  } catch (ComException& e) {
+    throw ActroidException(e.what());
+  }
+  t = m_Telemetry.record(STAGE_WRITE, t);
+  ReplyStatus setStatus = _readReply(0, NULL, "Pipelined reply timeout.");
+  if (setStatus == REPLY_PENDING) {
+    m_Telemetry.count(COUNTER_TIMEOUT);
+    throw ActroidTimeoutException("Pipelined reply timeout.");
+  }
+  t = m_Telemetry.record(STAGE_ACK, t);
+  ReplyStatus getStatus = _readReply(count+1, reply, "Pipelined reply timeout.");
+
+  if (setStatus == REPLY_DONE) {
+    _onWriteAcked(target);
+  }
+  if (setStatus == REPLY_NACK || getStatus == REPLY_NACK) {
+    m_Telemetry.count(COUNTER_NACK, (setStatus == REPLY_NACK ? 1 : 0) + (getStatus == REPLY_NACK ? 1 : 0));
+    if (getStatus == REPLY_DONE) {
+      // only the set was rejected: the angles are valid.
+      m_Telemetry.record(STAGE_READ, t);
+      _mergeReply(reply, start, count, frame, time);
+    }
+    if (m_NackRetries == 0) {
+      throw ActroidNackException("Nack received.");
+    }
+    // retry the rejected packet alone, with its own bounded retries.
+    if (setStatus == REPLY_NACK) {
+      _writeRawAngle(target);
+    }
+    if (getStatus == REPLY_NACK) {
+      _readRawAngle(frame, time, start, count);
+    }
+    return;
+  }
+  if (getStatus == REPLY_PENDING) {
+    m_Telemetry.count(COUNTER_FRAME_ERROR);
+    return;
+  }
+  m_Telemetry.record(STAGE_READ, t);
+  _mergeReply(reply, start, count, frame, time);
+}
 
-ActroidBase::ActroidBase(const char* portName) throw(ActroidException)
+template<class Model>
+void ActroidBaseT<Model>::updateTargetAngles() throw(ActroidException)
 {
-  m_pSerialPort = new SerialPort(portName, BAUDRATE);
-  _writePacket(online_command, 3);
+  if (_isIoActive()) {
+    memcpy(m_TargetBuffer.back().angle, m_TargetRawAngle, NUM_JOINT);
+    m_TargetBuffer.publish();
+  } else {
+    _stepTrajectory(m_TargetRawAngle);
+    if (_isWriteRequired(m_TargetRawAngle, true)) {
+      _writeRawAngle(m_TargetRawAngle);
+    }
+  }
+}
 
-  m_CurrentRawAngle[0] = 0;
-  for (int i = 0;i < NUM_JOINT;i++) {
-    m_CurrentRawAngle[i+1] = _DefaultRawAngle[i];
-    //m_TargetRawAngle[i] = _DefaultRawAngle[i];
-	setTargetAngle(i, _DefaultAngle[i]);
+template<class Model>
+void ActroidBaseT<Model>::updateCurrentAngles() throw(ActroidException)
+{
+  if (_isIoActive()) {
+    if (atomicLoad(&m_IoFailed)) {
+      throw ActroidException(m_IoErrorMessage.c_str());
+    }
+    if (m_CurrentBuffer.update()) {
+      const RawCurrentFrame<NUM_JOINT>& frame = m_CurrentBuffer.front();
+      memcpy(m_CurrentRawAngle, frame.angle, NUM_JOINT+1);
+      memcpy(m_CommandedRawAngle, frame.target, NUM_JOINT);
+      memcpy(m_CurrentTime, frame.time, sizeof(m_CurrentTime));
+      _updateEstimator();
+    }
+  } else {
+    // only a due keep-alive frame or trajectory target is sent here.
+    bool moving = _stepTrajectory(m_TargetRawAngle);
+    _cycle(m_TargetRawAngle, _isWriteRequired(m_TargetRawAngle, moving), m_CurrentRawAngle, m_CurrentTime);
+    _updateEstimator();
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::updateAngles() throw(ActroidException)
+{
+  if (_isIoActive()) {
+    updateTargetAngles();
+    updateCurrentAngles();
+  } else {
+    _stepTrajectory(m_TargetRawAngle);
+    _cycle(m_TargetRawAngle, _isWriteRequired(m_TargetRawAngle, true), m_CurrentRawAngle, m_CurrentTime);
+    _updateEstimator();
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_cycle(const uint8_t* target, const bool write, uint8_t* frame, uint64_t* time) throw(ActroidException)
+{
+  int start, count;
+  uint64_t t = m_Telemetry.start();
+  m_ReadScheduler.next(start, count);
+  if (!write) {
+    _readRawAngle(frame, time, start, count);
+  } else if (m_Pipelined) {
+    _writeReadRawAngle(target, frame, time, start, count);
+  } else {
+    _writeRawAngle(target);
+    _readRawAngle(frame, time, start, count);
+  }
+  m_Telemetry.recordCycle(t);
+}
+
+template<class Model>
+void ActroidBaseT<Model>::updateCurrentAngles(const int start, const int count) throw(ActroidException)
+{
+  if (start < 0 || count <= 0 || start + count > NUM_JOINT) {
+    throw ActroidException("Invalid joint range.");
   }
+  if (_isIoActive()) {
+    throw ActroidException("Range read is not available while I/O thread is running.");
+  }
+  _readRawAngle(m_CurrentRawAngle, m_CurrentTime, start, count);
+  _updateEstimator();
+}
 
+template<class Model>
+void ActroidBaseT<Model>::updateCurrentAngles(const char* groupName) throw(ActroidException)
+{
+  const JointGroup* group = m_ReadScheduler.find(groupName);
+  if (!group) {
+    throw ActroidException("Unknown joint group.");
+  }
+  updateCurrentAngles(group->start, group->count);
 }
 
-ActroidBase::~ActroidBase() throw(ActroidException)
+template<class Model>
+void ActroidBaseT<Model>::setWriteLanes(const char* spec) throw(ActroidException)
 {
-  _writePacket(offline_command, 3);
-  delete m_pSerialPort;
+  if (_isIoActive()) {
+    throw ActroidException("Write lanes can not be changed while I/O thread is running.");
+  }
+  if (!m_WriteScheduler.parse(spec)) {
+    throw ActroidException("Invalid write lanes.");
+  }
 }
 
-void ActroidBase::_writePacket(const uint8_t* packet, const int len) throw(ActroidException)
+template<class Model>
+void ActroidBaseT<Model>::setCalibration(const char* spec) throw(ActroidException)
 {
-  if (m_pSerialPort->write(packet, len) != len) {
-    throw ActroidException("Packet Write Error");
+  if (_isIoActive()) {
+    throw ActroidException("Calibration can not be changed while I/O thread is running.");
+  }
+  double minAngle[NUM_JOINT];
+  double maxAngle[NUM_JOINT];
+  memcpy(minAngle, Model::MinAngle, sizeof(minAngle));
+  memcpy(maxAngle, Model::MaxAngle, sizeof(maxAngle));
+  std::string s(spec);
+  std::string::size_type pos = 0;
+  while (pos < s.length()) {
+    std::string::size_type end = s.find(',', pos);
+    if (end == std::string::npos) {
+      end = s.length();
+    }
+    std::string item = s.substr(pos, end - pos);
+    pos = end + 1;
+    if (item.find_first_not_of(" \t") == std::string::npos) {
+      continue;
+    }
+    int joint;
+    double lower, upper;
+    char rest;
+    if (sscanf(item.c_str(), "%d:%lf:%lf %c", &joint, &lower, &upper, &rest) != 3 ||
+        joint < 0 || joint >= NUM_JOINT || lower + 2 * Model::AngleMargin[joint] >= upper) {
+      throw ActroidException("Invalid calibration.");
+    }
+    minAngle[joint] = lower;
+    maxAngle[joint] = upper;
   }
+  m_Calibration.setLimits(minAngle, maxAngle, Model::AngleMargin);
+}
 
-  uint8_t ack;
-  while(m_pSerialPort->getSizeInRxBuffer() < 1) {
-	  Sleep(1);
+template<class Model>
+void ActroidBaseT<Model>::setReadSchedule(const char* spec) throw(ActroidException)
+{
+  if (_isIoActive()) {
+    throw ActroidException("Read schedule can not be changed while I/O thread is running.");
   }
+  if (!m_ReadScheduler.parse(spec)) {
+    throw ActroidException("Invalid read schedule.");
+  }
+}
 
-  m_pSerialPort->read(&ack, 1);
-  if (ack != _ack) {
-    throw ActroidException("Nack received.");
+template<class Model>
+void ActroidBaseT<Model>::startTrace(const char* fileName, const int capacity) throw(ActroidException)
+{
+  if (_isIoActive()) {
+    throw ActroidException("Trace can not be started while I/O thread is running.");
+  }
+  if (!m_pSerialPort) {
+    throw ActroidException("Trace is available only on a serial port.");
+  }
+  if (capacity <= 0) {
+    throw ActroidException("Invalid trace capacity.");
   }
+  stopTrace();
+  try {
+    m_pTrace = new TraceRecorder(fileName, capacity);
+  } catch (ComException& e) {
+    throw ActroidException(e.what());
+  }
+  m_pSerialPort->setTraceRecorder(m_pTrace);
 }
 
-void ActroidBase::_readRawAngle() throw(ActroidException)
+template<class Model>
+void ActroidBaseT<Model>::stopTrace() throw(ActroidException)
 {
-  _writePacket(joint_read_command, 5);
-  while(m_pSerialPort->getSizeInRxBuffer() < NUM_JOINT+1) {
-	  Sleep(10);
+  if (_isIoActive()) {
+    throw ActroidException("Trace can not be stopped while I/O thread is running.");
   }
-  m_pSerialPort->read(m_CurrentRawAngle, NUM_JOINT+1);
-  if(m_CurrentRawAngle[0] != 24) {
-    throw ActroidException("Invalid Joint Angle Packet Received.");
+  if (m_pSerialPort) {
+    m_pSerialPort->setTraceRecorder(NULL);
   }
+  delete m_pTrace;
+  m_pTrace = NULL;
 }
 
-void ActroidBase::_writeRawAngle() throw(ActroidException)
+template<class Model>
+bool ActroidBaseT<Model>::_isWriteRequired(const uint8_t* target, const bool requested)
 {
+  uint64_t now = monotonicNanos();
+  if (m_KeepAlive > 0 && now - m_LastWriteTime >= (uint64_t)m_KeepAlive * 1000000) {
+    return true;
+  }
+  if (!m_LastWriteValid) {
+    return requested;
+  }
+  bool changed = memcmp(target, m_LastWrittenRawAngle, NUM_JOINT) != 0;
+  if (m_WriteScheduler.empty()) {
+    if (!requested) {
+      return false;
+    }
+    if (!m_SuppressUnchanged || changed) {
+      return true;
+    }
+  } else if (changed) {
+    // changes wait until the deadline of their lane.
+    return m_WriteScheduler.isDue(target, m_LastWrittenRawAngle, now);
+  }
+  if (requested) {
+    atomicAdd(&m_SuppressedCount, 1);
+  }
+  return false;
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_onWriteAcked(const uint8_t* target)
+{
+  memcpy(m_LastWrittenRawAngle, target, NUM_JOINT);
+  m_LastWriteValid = true;
+  m_LastWriteTime = monotonicNanos();
+  m_WriteScheduler.onWritten();
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_prepareIo()
+{
+  // drop values left from the previous run.
+  m_TargetBuffer.update();
+  m_CurrentBuffer.update();
+  memcpy(m_TargetBuffer.back().angle, m_TargetRawAngle, NUM_JOINT);
+  m_TargetBuffer.publish();
+  memcpy(m_CommandedRawAngle, m_TargetRawAngle, NUM_JOINT);
+  m_IoFailed = 0;
+  m_Stale = 0;
+  atomicStore(&m_IoRunning, 1);
+}
+
+template<class Model>
+void ActroidBaseT<Model>::startIoThread() throw(ActroidException)
+{
+  if (_isIoActive()) {
+    return;
+  }
+  _prepareIo();
+  m_pIoThread = new ActroidIoThread<Model>(this);
+  try {
+    m_pIoThread->start();
+  } catch (ThreadException& e) {
+    delete m_pIoThread;
+    m_pIoThread = NULL;
+    throw ActroidException(e.what());
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::startIoThread(ActroidReactor* pReactor) throw(ActroidException)
+{
+  if (_isIoActive()) {
+    return;
+  }
+  if (!m_pTransport && m_ReconnectMax <= 0) {
+    throw ActroidException("Not connected.");
+  }
+  if (m_pSerialPort) {
+    try {
+      m_pSerialPort->setNonBlocking(true);
+    } catch (ComException& e) {
+      throw ActroidException(e.what());
+    }
+  }
+  _prepareIo();
+  memcpy(m_IoTarget.angle, m_TargetRawAngle, NUM_JOINT);
+  memcpy(m_IoFrame, m_CurrentRawAngle, NUM_JOINT+1);
+  memcpy(m_IoTime, m_CurrentTime, sizeof(m_IoTime));
+  // the reactor never waits for a reply, so even stop-and-wait goes through the queue.
+  _beginWindow(m_CommandWindow > 0 ? m_CommandWindow : 1);
+  m_Recovering = m_pTransport == NULL;
+  m_RetryTime = 0;
+  m_Backoff = m_ReconnectMin;
+  if (m_Recovering) {
+    atomicStore(&m_Stale, 1);
+  }
+  m_pReactorClient = new ActroidReactorClient<Model>(this);
+  try {
+    pReactor->add(m_pReactorClient);
+  } catch (ThreadException& e) {
+    delete m_pReactorClient;
+    m_pReactorClient = NULL;
+    _setBlocking();
+    throw ActroidException(e.what());
+  }
+  m_pReactor = pReactor;
+}
+
+/**
+ * Make the serial port blocking again for the synchronous API, once the
+ * reactor has let go of it.
+ */
+template<class Model>
+void ActroidBaseT<Model>::_setBlocking()
+{
+  if (m_pSerialPort) {
+    try {
+      m_pSerialPort->setNonBlocking(false);
+    } catch (ComException& e) {
+      // the next synchronous call fails on the port and reconnects it.
+      std::cerr << "[ActroidBase] warning: port can not be made blocking (" << e.what() << ")." << std::endl;
+    }
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::stopIoThread()
+{
+  if (!_isIoActive()) {
+    return;
+  }
+  atomicStore(&m_IoRunning, 0);
+  if (m_pReactor) {
+    // the reactor drops the link once the commands in flight are answered.
+    m_pReactor->remove(m_pReactorClient);
+    delete m_pReactorClient;
+    m_pReactorClient = NULL;
+    m_pReactor = NULL;
+    _setBlocking();
+    return;
+  }
+  m_pIoThread->join();
+  delete m_pIoThread;
+  m_pIoThread = NULL;
+}
+
+template<class Model>
+void ActroidBaseT<Model>::setIoThreadPriority(const int priority) throw(ActroidException)
+{
+  if (priority < 0 || priority > 99) {
+    throw ActroidException("I/O thread priority must be 0 to 99.");
+  }
+  m_IoPriority = priority;
+}
+
+template<class Model>
+void ActroidBaseT<Model>::setIoThreadAffinity(const char* cpus) throw(ActroidException)
+{
+  uint64_t mask;
+  if (!parseCpuList(cpus, mask)) {
+    throw ActroidException("Invalid CPU list.");
+  }
+  m_IoCpuMask = mask;
+}
+
+template<class Model>
+void ActroidBaseT<Model>::setStackPrefault(const int kiloBytes) throw(ActroidException)
+{
+  if (kiloBytes < 0 || kiloBytes > 512) {
+    throw ActroidException("Stack prefault must be 0 to 512 KB.");
+  }
+  m_StackPrefault = kiloBytes;
+}
+
+/**
+ * Real-time options, applied by the I/O thread to itself before its first cycle.
+ * Options which can not be applied only degrade timing, so they are reported and skipped.
+ */
+template<class Model>
+void ActroidBaseT<Model>::_applyRealtime()
+{
+  if (m_IoCpuMask && !Thread::setCurrentAffinity(m_IoCpuMask)) {
+    std::cerr << "[ActroidBase] warning: I/O thread can not be pinned to the CPUs." << std::endl;
+  }
+  if (m_IoPriority > 0 && !Thread::setCurrentPriority(m_IoPriority)) {
+    std::cerr << "[ActroidBase] warning: I/O thread can not run under SCHED_FIFO"
+              << " (CAP_SYS_NICE or RLIMIT_RTPRIO needed). Default scheduling is used." << std::endl;
+  }
+  if (m_StackPrefault > 0) {
+    Thread::prefaultStack((unsigned long)m_StackPrefault * 1024);
+  }
+  // after the stack is touched, so that its pages are locked too.
+  if (m_LockMemory && !lockMemory()) {
+    std::cerr << "[ActroidBase] warning: memory can not be locked (RLIMIT_MEMLOCK?)." << std::endl;
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_ioLoop()
+{
+  _applyRealtime();
+  RawTargetFrame<NUM_JOINT>& target = m_IoTarget;
+  memcpy(target.angle, m_TargetRawAngle, NUM_JOINT);
+  memcpy(m_IoFrame, m_CurrentRawAngle, NUM_JOINT+1);
+  memcpy(m_IoTime, m_CurrentTime, sizeof(m_IoTime));
+  for (;;) {
+    try {
+      if (m_CommandWindow > 0) {
+        _ioLoopWindowed();
+      } else {
+        _ioLoopSync();
+      }
+      return;
+    } catch (ActroidException& e) {
+      if (m_ReconnectMax <= 0) {
+        m_IoErrorMessage = e.what();
+        atomicStore(&m_IoFailed, 1);
+        return;
+      }
+      std::cerr << "[ActroidBase] link error (" << e.what() << "), reconnecting." << std::endl;
+      atomicStore(&m_Stale, 1);
+      if (!_recover()) {
+        return;
+      }
+      atomicStore(&m_Stale, 0);
+    }
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_ioLoopSync()
+{
+  RawTargetFrame<NUM_JOINT>& target = m_IoTarget;
+  while (atomicLoad(&m_IoRunning)) {
+    bool requested = m_TargetBuffer.read(target);
+    if (_stepTrajectory(target.angle)) {
+      requested = true;
+    }
+    _cycle(target.angle, _isWriteRequired(target.angle, requested), m_IoFrame, m_IoTime);
+    _publishCurrent();
+    atomicAdd(&m_IoCycleCount, 1);
+  }
+}
+
+/**
+ * Reconnect until it succeeds, waiting m_ReconnectMin [ms] after the first
+ * failure and twice as long after each further one, up to m_ReconnectMax.
+ * @return false if the thread was stopped meanwhile.
+ */
+template<class Model>
+bool ActroidBaseT<Model>::_recover()
+{
+  int backoff = m_ReconnectMin;
+  while (atomicLoad(&m_IoRunning)) {
+    try {
+      _reconnect(m_IoTarget.angle);
+      m_Telemetry.count(COUNTER_RECONNECT);
+      return true;
+    } catch (ActroidException& e) {
+    }
+    // sleep in slices, so that stopIoThread() is not delayed by the backoff.
+    uint64_t until = monotonicNanos() + (uint64_t)backoff * 1000000;
+    while (atomicLoad(&m_IoRunning) && monotonicNanos() < until) {
+      Thread::sleep(backoff < 10 ? backoff : 10);
+    }
+    backoff = backoff * 2 < m_ReconnectMax ? backoff * 2 : m_ReconnectMax;
+  }
+  return false;
+}
+
+/**
+ * Reopen the link, put the controller online again and send target.
+ */
+template<class Model>
+void ActroidBaseT<Model>::_reconnect(const uint8_t* target) throw(ActroidException)
+{
+  _reopenLink();
+  const uint8_t online_command[] = {Model::START, Model::ONLINE, Model::STOP};
+  _writePacket(online_command, 3);
+  _writeRawAngle(target);
+  atomicStore(&m_Stale, 0);
+}
+
+/**
+ * Reopen the serial port (or drop stale bytes of an injected transport)
+ * and abandon the commands in flight.
+ */
+template<class Model>
+void ActroidBaseT<Model>::_reopenLink() throw(ActroidException)
+{
+  if (m_OwnTransport) {
+    // close first: the device may not be opened twice.
+    delete m_pSerialPort;
+    m_pSerialPort = NULL;
+    m_pTransport = NULL;
+    try {
+      m_pSerialPort = new SerialPort(m_PortName.c_str(), Model::BAUDRATE);
+      // the reactor thread serves other links too, so it must not block on this one.
+      m_pSerialPort->setNonBlocking(m_pReactorClient != NULL);
+    } catch (ComException& e) {
+      delete m_pSerialPort;
+      m_pSerialPort = NULL;
+      throw ActroidException(e.what());
+    }
+    m_pSerialPort->setTraceRecorder(m_pTrace);
+    m_pTransport = m_pSerialPort;
+  } else {
+    try {
+      m_pTransport->flushRxBuffer();
+    } catch (ComException& e) {
+      throw ActroidException(e.what());
+    }
+  }
+  m_pCommandQueue->clear();
+  m_pCommandQueue->setTransport(m_pTransport);
+}
+
+template<class Model>
+void ActroidBaseT<Model>::reconnect() throw(ActroidException)
+{
+  if (_isIoActive()) {
+    throw ActroidException("Reconnect is done by the I/O thread while it is running.");
+  }
+  _reconnect(m_TargetRawAngle);
+  m_Telemetry.count(COUNTER_RECONNECT);
+}
+
+template<class Model>
+void ActroidBaseT<Model>::reopen(const char* portName) throw(ActroidException)
+{
+  if (_isIoActive()) {
+    throw ActroidException("Port can not be changed while I/O thread is running.");
+  }
+  if (!m_OwnTransport) {
+    throw ActroidException("Port can be changed only with the serial port constructor.");
+  }
+  // kept even if the port fails to open, so that reconnect() retries it.
+  m_PortName = portName;
+  _reconnect(m_TargetRawAngle);
+}
+
+/**
+ * Reset the state of the windowed cycle before its first command.
+ */
+template<class Model>
+void ActroidBaseT<Model>::_beginWindow(const int window)
+{
+  m_PendingSet = false;
+  m_SetInFlight = 0;
+  m_SetRejected = false;
+  m_NackRun = 0;
+  m_pCommandQueue->setWindow(window);
+  m_pCommandQueue->setTimeout(m_Timeout);
+  m_pCommandError = NULL;
+  m_CommandTimeout = false;
+  m_LastCycleTime = m_Telemetry.start();
+  m_QueueFrameErrors = m_pCommandQueue->getFrameErrorCount();
+  m_QueueResyncs = m_pCommandQueue->getResyncCount();
+}
+
+/**
+ * Take new targets and fill every free slot of the window with a set or get command.
+ */
+template<class Model>
+void ActroidBaseT<Model>::_fillWindow()
+{
+  RawTargetFrame<NUM_JOINT>& target = m_IoTarget;
   uint8_t command[NUM_JOINT + 5];
-  command[0] = _start;
-  command[1] = _set;
-  command[2] = _set2;
-  
-  uint8_t sum = 24;
-  for (int i = 0;i < NUM_JOINT;i++) {
-    sum += getTargetRawAngle(i);
-    command[3 + i] = getTargetRawAngle(i);
+  uint8_t getCommand[5];
+  int start, count;
+  bool requested = m_TargetBuffer.read(target);
+  // a trajectory changes targets faster than sets are acked; one set in flight leaves the window to gets.
+  if (_stepTrajectory(target.angle) && m_SetInFlight == 0) {
+    requested = true;
+  }
+  if (m_SetRejected) {
+    // the last set was not acked: send the targets again.
+    m_SetRejected = false;
+    requested = true;
+  }
+  if ((requested || (!m_PendingSet && m_SetInFlight == 0)) && _isWriteRequired(target.angle, requested)) {
+    m_PendingSet = true;
+  }
+  // keep the controller busy: every free slot of the window gets a command.
+  while (m_pCommandQueue->hasRoom()) {
+    if (m_PendingSet) {
+      _buildSetPacket<Model>(target.angle, command);
+      m_pCommandQueue->submit(command, NUM_JOINT+5, 0, _onSetDone, this);
+      m_SetInFlight++;
+      m_PendingSet = false;
+    } else {
+      m_ReadScheduler.next(start, count);
+      _buildGetPacket<Model>(start, count, getCommand);
+      m_pCommandQueue->submit(getCommand, sizeof(getCommand), count+1, _onGetDone, this);
+    }
   }
-  command[3 + NUM_JOINT] = ~sum + 1;
-  command[4 + NUM_JOINT] = _stop;
+}
 
-  _writePacket(command, NUM_JOINT+5);
+/**
+ * Add frame errors and resyncs of the queue to the telemetry.
+ */
+template<class Model>
+void ActroidBaseT<Model>::_countQueueErrors()
+{
+  if (m_pCommandQueue->getFrameErrorCount() != m_QueueFrameErrors) {
+    m_Telemetry.count(COUNTER_FRAME_ERROR, m_pCommandQueue->getFrameErrorCount() - m_QueueFrameErrors);
+    m_QueueFrameErrors = m_pCommandQueue->getFrameErrorCount();
+  }
+  if (m_pCommandQueue->getResyncCount() != m_QueueResyncs) {
+    m_Telemetry.count(COUNTER_RESYNC, m_pCommandQueue->getResyncCount() - m_QueueResyncs);
+    m_QueueResyncs = m_pCommandQueue->getResyncCount();
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_ioLoopWindowed()
+{
+  if (!m_pTransport) {
+    throw ActroidException("Not connected.");
+  }
+  _beginWindow(m_CommandWindow);
+  try {
+    while (atomicLoad(&m_IoRunning)) {
+      _fillWindow();
+      m_pCommandQueue->service(m_Timeout);
+      _countQueueErrors();
+      if (m_pCommandError) {
+        break;
+      }
+    }
+
+    // wait for the replies of commands in flight, so that the port can be used synchronously again.
+    while (m_pCommandQueue->getCount() > 0 && !m_pCommandError) {
+      m_pCommandQueue->service(m_Timeout);
+    }
+  } catch (ComException& e) {
+    m_pCommandQueue->clear();
+    throw ActroidException(e.what());
+  }
+  m_pCommandQueue->clear();
+
+  if (m_pCommandError) {
+    if (m_CommandTimeout) {
+      throw ActroidTimeoutException(m_pCommandError);
+    }
+    throw ActroidException(m_pCommandError);
+  }
+}
+
+/**
+ * Windowed cycle of a link driven by ActroidReactor: the same commands as
+ * _ioLoopWindowed(), but each call only handles what has arrived and
+ * returns. Link errors are recovered as by _recover(), with the online
+ * handshake sent through the queue, so that a dead controller only costs
+ * its own port a reopen per backoff.
+ */
+template<class Model>
+bool ActroidBaseT<Model>::_stepReactor(const uint64_t now, const bool error, uint64_t& wakeup, bool& relinked)
+{
+  const bool running = atomicLoad(&m_IoRunning) != 0;
+  const uint64_t slice = 10 * (uint64_t)1000000;
+  if (m_Recovering) {
+    if (!running) {
+      return false;
+    }
+    if (now < m_RetryTime) {
+      // woken in slices while waiting, so that stopIoThread() is not delayed by the backoff.
+      wakeup = m_RetryTime < now + slice ? m_RetryTime : now + slice;
+      return true;
+    }
+    relinked = true;
+    try {
+      _reopenLink();
+    } catch (ActroidException& e) {
+      m_RetryTime = now + (uint64_t)m_Backoff * 1000000;
+      m_Backoff = m_Backoff * 2 < m_ReconnectMax ? m_Backoff * 2 : m_ReconnectMax;
+      wakeup = m_RetryTime < now + slice ? m_RetryTime : now + slice;
+      return true;
+    }
+    _beginWindow(m_pCommandQueue->getWindow());
+    const uint8_t online_command[] = {Model::START, Model::ONLINE, Model::STOP};
+    m_pCommandQueue->submit(online_command, 3, 0, _onOnlineDone, this);
+    // the targets follow the handshake.
+    m_SetRejected = true;
+    m_Recovering = false;
+  }
+
+  std::string message;
+  try {
+    if (error) {
+      throw ComAccessException();
+    }
+    m_pCommandQueue->poll();
+    _countQueueErrors();
+    if (!m_pCommandError) {
+      if (running) {
+        _fillWindow();
+        m_pCommandQueue->flush();
+      } else if (m_pCommandQueue->getCount() == 0) {
+        return false;
+      }
+      wakeup = m_pCommandQueue->getDeadline();
+      if ((m_pTransport->getFd() < 0 || m_pCommandQueue->hasUnsent()) && (wakeup == 0 || wakeup > now + 1000000)) {
+        // nothing to wait on, or the Tx buffer was full: poll each millisecond.
+        wakeup = now + 1000000;
+      }
+      return true;
+    }
+    message = m_pCommandError;
+  } catch (ComException& e) {
+    message = e.what();
+  }
+
+  m_pCommandQueue->clear();
+  if (!running) {
+    return false;
+  }
+  if (m_OwnTransport && m_ReconnectMax > 0) {
+    // closed until the retry, so that a hung-up port does not keep waking the reactor.
+    delete m_pSerialPort;
+    m_pSerialPort = NULL;
+    m_pTransport = NULL;
+    relinked = true;
+  }
+  if (m_ReconnectMax <= 0) {
+    m_IoErrorMessage = message;
+    atomicStore(&m_IoFailed, 1);
+    return false;
+  }
+  m_Recovering = true;
+  if (atomicLoad(&m_Stale)) {
+    // the handshake after a reopen failed: back off as for a failed reopen.
+    m_RetryTime = now + (uint64_t)m_Backoff * 1000000;
+    m_Backoff = m_Backoff * 2 < m_ReconnectMax ? m_Backoff * 2 : m_ReconnectMax;
+  } else {
+    std::cerr << "[ActroidBase] link error (" << message << "), reconnecting." << std::endl;
+    atomicStore(&m_Stale, 1);
+    m_RetryTime = now;
+    m_Backoff = m_ReconnectMin;
+  }
+  wakeup = now;
+  return true;
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_onOnlineDone(const Command* command, void* userData)
+{
+  ActroidBaseT<Model>* pActroid = (ActroidBaseT<Model>*)userData;
+  if (command->getStatus() == COMMAND_DONE) {
+    pActroid->m_Telemetry.count(COUNTER_RECONNECT);
+    atomicStore(&pActroid->m_Stale, 0);
+  } else if (command->getStatus() == COMMAND_NACK) {
+    pActroid->m_Telemetry.count(COUNTER_NACK);
+    pActroid->m_pCommandError = "Nack received.";
+  } else if (command->getStatus() != COMMAND_ABORTED) {
+    pActroid->m_Telemetry.count(COUNTER_TIMEOUT);
+    pActroid->m_pCommandError = "Ack timeout.";
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_onSetDone(const Command* command, void* userData)
+{
+  ActroidBaseT<Model>* pActroid = (ActroidBaseT<Model>*)userData;
+  pActroid->m_SetInFlight--;
+  if (command->getStatus() == COMMAND_DONE) {
+    pActroid->m_NackRun = 0;
+    pActroid->_onWriteAcked(command->getPacket() + 3);
+  } else if (command->getStatus() == COMMAND_NACK) {
+    pActroid->m_Telemetry.count(COUNTER_NACK);
+    pActroid->m_SetRejected = true;
+    if (++pActroid->m_NackRun > pActroid->m_NackRetries) {
+      pActroid->m_pCommandError = "Nack received.";
+    }
+  } else if (command->getStatus() == COMMAND_TIMEOUT) {
+    pActroid->m_Telemetry.count(COUNTER_TIMEOUT);
+    pActroid->m_CommandTimeout = true;
+    pActroid->m_pCommandError = "Ack timeout.";
+  } else if (command->getStatus() == COMMAND_LOST) {
+    // not known to be acked, so the targets are sent again.
+    pActroid->m_Telemetry.count(COUNTER_FRAME_ERROR);
+    pActroid->m_SetRejected = true;
+  }
+}
+
+/**
+ * Hand angles received by the I/O thread to updateCurrentAngles().
+ */
+template<class Model>
+void ActroidBaseT<Model>::_publishCurrent()
+{
+  RawCurrentFrame<NUM_JOINT>& frame = m_CurrentBuffer.back();
+  memcpy(frame.angle, m_IoFrame, NUM_JOINT+1);
+  memcpy(frame.target, m_IoTarget.angle, NUM_JOINT);
+  memcpy(frame.time, m_IoTime, sizeof(frame.time));
+  m_CurrentBuffer.publish();
 }
 
-void ActroidBase::setTargetAngle(const int index, double angle)
+template<class Model>
+void ActroidBaseT<Model>::_onGetDone(const Command* command, void* userData)
 {
-  //m_TargetRawAngle[index] = (angle)/(_MaxAngle[index]-_MinAngle[index]) * 255.0 + _DefaultRawAngle[index];
-	if(angle >= (_MaxAngle[index]-_AngleMargin[index])) {
-		 angle = _MaxAngle[index] - _AngleMargin[index];
-	} else if(angle <= (_MinAngle[index] + _AngleMargin[index])) {
-		 angle = _MinAngle[index] + _AngleMargin[index];
-	}
+  ActroidBaseT<Model>* pActroid = (ActroidBaseT<Model>*)userData;
+  if (command->getStatus() == COMMAND_DONE) {
+    int start = command->getPacket()[2];
+    int count = command->getPacket()[3];
+    if (command->getReply()[0] != count) {
+      pActroid->m_Telemetry.count(COUNTER_FRAME_ERROR);
+      pActroid->m_pCommandError = "Invalid Joint Angle Packet Received.";
+      return;
+    }
+    pActroid->m_NackRun = 0;
+    _mergeReply(command->getReply(), start, count, pActroid->m_IoFrame, pActroid->m_IoTime);
+    pActroid->_publishCurrent();
+    atomicAdd(&pActroid->m_IoCycleCount, 1);
+    // commands overlap in windowed mode, so a cycle is the time between two replies.
+    if (pActroid->m_LastCycleTime) {
+      pActroid->m_LastCycleTime = pActroid->m_Telemetry.recordCycle(pActroid->m_LastCycleTime);
+    } else {
+      pActroid->m_LastCycleTime = pActroid->m_Telemetry.start();
+    }
+  } else if (command->getStatus() == COMMAND_NACK) {
+    // the next get reads the angles again.
+    pActroid->m_Telemetry.count(COUNTER_NACK);
+    if (++pActroid->m_NackRun > pActroid->m_NackRetries) {
+      pActroid->m_pCommandError = "Nack received.";
+    }
+  } else if (command->getStatus() == COMMAND_TIMEOUT) {
+    pActroid->m_Telemetry.count(COUNTER_TIMEOUT);
+    pActroid->m_CommandTimeout = true;
+    pActroid->m_pCommandError = "Joint angle packet timeout.";
+  } else if (command->getStatus() == COMMAND_LOST) {
+    pActroid->m_Telemetry.count(COUNTER_FRAME_ERROR);
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::setTrajectory(const double* time, const double* angles, const int count,
+                                        const Interpolation interpolation) throw(ActroidException)
+{
+  if (count <= 0 || count > TRAJECTORY_MAX_WAYPOINTS) {
+    throw ActroidException("Invalid number of waypoints.");
+  }
+  for (int i = 0;i < count;i++) {
+    if (!(time[i] > (i == 0 ? 0.0 : time[i-1])) || time[i] - time[i] != 0) {
+      throw ActroidException("Waypoint times must increase.");
+    }
+    // x - x is 0 unless x is NaN or infinite.
+    for (int j = 0;j < NUM_JOINT;j++) {
+      if (angles[i*NUM_JOINT+j] - angles[i*NUM_JOINT+j] != 0) {
+        throw ActroidException("Waypoint angles must be finite.");
+      }
+    }
+  }
+  TrajectoryFrame<NUM_JOINT>& frame = m_TrajectoryBuffer.back();
+  frame.id = atomicAdd(&m_TrajectorySubmitted, 1);
+  frame.count = count;
+  frame.interpolation = interpolation;
+  memcpy(frame.time, time, sizeof(double) * count);
+  memcpy(frame.angle, angles, sizeof(double) * NUM_JOINT * count);
+  m_TrajectoryBuffer.publish();
+}
 
-  m_TargetRawAngle[index] = (angle) * 255.0/(_MaxAngle[index]-_MinAngle[index]) - (_MinAngle[index] * 255.0 / (_MaxAngle[index]-_MinAngle[index]));
-//  if (index == 15)
-//   {
-//    std::cout << "TargetRawAngle is  " << static_cast<int>(m_TargetRawAngle[15]) << std::endl;
-//	  std::cout << "_MaxAngle[15] is  " << static_cast<int>(_MaxAngle[15]) << std::endl;
-//	  std::cout << "_MinAngle[15] is  " << static_cast<int>(_MinAngle[15]) << std::endl;
-//	  std::cout << "_DefaultRawAngle[15] is  " << static_cast<int>(_DefaultRawAngle[15]) << std::endl;
-//	  std::cout << "angle is  " << angle << std::endl;
-//   }
+template<class Model>
+void ActroidBaseT<Model>::stopTrajectory()
+{
+  TrajectoryFrame<NUM_JOINT>& frame = m_TrajectoryBuffer.back();
+  frame.id = atomicAdd(&m_TrajectorySubmitted, 1);
+  frame.count = 0;
+  m_TrajectoryBuffer.publish();
 }
 
-double ActroidBase::getCurrentAngle(const int index)
+/**
+ * Take a new trajectory if any, and overwrite target with the trajectory at now.
+ * Called by the thread which sends targets.
+ * @return true if target has been overwritten.
+ */
+template<class Model>
+bool ActroidBaseT<Model>::_stepTrajectory(uint8_t* target)
 {
-  //return (m_CurrentRawAngle[index]-_DefaultRawAngle[index])/255.0 * (_MaxAngle[index]-_MinAngle[index]) + _MinAngle[index];
-//  if (index == 15)
-//   {
-//    std::cout << "m_CurrentRawAngle[15] is  " << static_cast<int>(m_CurrentRawAngle[15]) << std::endl;
-// 	std::cout << "_MaxAngle[15] is  " << static_cast<int>(_MaxAngle[15]) << std::endl;
-//	std::cout << "_MinAngle[15] is  " << static_cast<int>(_MinAngle[15]) << std::endl;
-//   }
-  return (m_CurrentRawAngle[index+1] * (_MaxAngle[index]-_MinAngle[index]))/255.0 + _MinAngle[index];
+  if (m_TrajectoryBuffer.update()) {
+    const TrajectoryFrame<NUM_JOINT>& frame = m_TrajectoryBuffer.front();
+    if (frame.count > 0) {
+      double origin[NUM_JOINT];
+      if (m_Trajectory.isActive()) {
+        memcpy(origin, m_Trajectory.getLastAngles(), sizeof(origin));
+      } else {
+        m_Calibration.toAngle(target, origin, NUM_JOINT);
+      }
+      m_Trajectory.start(&frame, origin, monotonicNanos());
+    } else {
+      m_Trajectory.stop();
+      atomicStore(&m_TrajectoryFinished, frame.id);
+    }
+  }
+  if (!m_Trajectory.isActive()) {
+    return false;
+  }
+  double angles[NUM_JOINT];
+  if (!m_Trajectory.evaluate(monotonicNanos(), angles)) {
+    atomicStore(&m_TrajectoryFinished, m_Trajectory.getId());
+    m_Trajectory.stop();
+  }
+  m_Calibration.toRaw(angles, target, NUM_JOINT);
+  return true;
+}
 
+template<class Model>
+void ActroidBaseT<Model>::setTargetAngle(const int index, double angle)
+{
+  m_TargetRawAngle[index] = m_Calibration.toRaw(index, angle);
 }
+
+template<class Model>
+double ActroidBaseT<Model>::getCurrentAngle(const int index)
+{
+  return m_Calibration.toAngle(index, m_CurrentRawAngle[index+1]);
+}
+
+template<class Model>
+void ActroidBaseT<Model>::setTargetAngles(const double* angles, const int n)
+{
+  m_Calibration.toRaw(angles, m_TargetRawAngle, n < NUM_JOINT ? n : NUM_JOINT);
+}
+
+template<class Model>
+void ActroidBaseT<Model>::_updateEstimator()
+{
+  for (int i = 0;i < NUM_JOINT;i++) {
+    if (m_CurrentTime[i] != m_Estimator.getTime(i)) {
+      m_Estimator.measure(i, m_Calibration.toAngle(i, m_CurrentRawAngle[i+1]), m_CurrentTime[i]);
+    }
+  }
+}
+
+template<class Model>
+void ActroidBaseT<Model>::getEstimatedAngles(double* angles, double* age, double* variance, const int n)
+{
+  double target[NUM_JOINT];
+  m_Calibration.toAngle(_isIoActive() ? m_CommandedRawAngle : m_TargetRawAngle, target, NUM_JOINT);
+  m_Estimator.estimate(target, monotonicNanos(), angles, age, variance, n < NUM_JOINT ? n : NUM_JOINT);
+}
+
+template<class Model>
+void ActroidBaseT<Model>::getCurrentAngles(double* angles, const int n)
+{
+  m_Calibration.toAngle(m_CurrentRawAngle + 1, angles, n < NUM_JOINT ? n : NUM_JOINT);
+}
+
+template class ogata_lab::ActroidBaseT<ActroidModel>;
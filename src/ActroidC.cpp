@@ -0,0 +1,226 @@
+/**
+ * @file ActroidC.cpp
+ * @brief C interface of ActroidBase, for controllers linking ActroidCore directly
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <string.h>
+#include <string>
+#include <new>
+
+#include "ActroidBase.h"
+#include "LoopbackTransport.h"
+#include "ActroidC.h"
+
+using namespace ogata_lab;
+
+struct actroid {
+  ActroidBase* pActroid;
+  ActroidSimulator* pSimulator;    ///< NULL unless opened by actroid_open_simulator()
+  LoopbackTransport* pLoopback;
+  std::string error;
+};
+
+/**
+ * Failure of a call: keep the message and return -1.
+ */
+static int _fail(actroid_t* actroid, const char* message)
+{
+  actroid->error = message;
+  return -1;
+}
+
+/**
+ * Open on port_name, or on an ActroidSimulator in process if port_name is NULL.
+ */
+static actroid_t* _open(const char* port_name, char* error, int error_size)
+{
+  actroid_t* actroid = NULL;
+  try {
+    actroid = new actroid_t;
+    actroid->pActroid = NULL;
+    actroid->pSimulator = NULL;
+    actroid->pLoopback = NULL;
+    if (port_name) {
+      actroid->pActroid = new ActroidBase(port_name);
+    } else {
+      actroid->pSimulator = new ActroidSimulator();
+      actroid->pLoopback = new LoopbackTransport(actroid->pSimulator);
+      actroid->pActroid = new ActroidBase(actroid->pLoopback);
+    }
+    return actroid;
+  } catch (ActroidException& e) {
+    if (error && error_size > 0) {
+      strncpy(error, e.what(), error_size - 1);
+      error[error_size - 1] = 0;
+    }
+  } catch (std::bad_alloc&) {
+    if (error && error_size > 0) {
+      strncpy(error, "Out of memory.", error_size - 1);
+      error[error_size - 1] = 0;
+    }
+  }
+  if (actroid) {
+    delete actroid->pLoopback;
+    delete actroid->pSimulator;
+    delete actroid;
+  }
+  return NULL;
+}
+
+actroid_t* actroid_open(const char* port_name, char* error, int error_size)
+{
+  if (!port_name) {
+    if (error && error_size > 0) {
+      strncpy(error, "Port name is missing.", error_size - 1);
+      error[error_size - 1] = 0;
+    }
+    return NULL;
+  }
+  return _open(port_name, error, error_size);
+}
+
+actroid_t* actroid_open_simulator(char* error, int error_size)
+{
+  return _open(NULL, error, error_size);
+}
+
+void actroid_close(actroid_t* actroid)
+{
+  if (!actroid) {
+    return;
+  }
+  try {
+    actroid->pActroid->stopIoThread();
+    delete actroid->pActroid;
+  } catch (ActroidException&) {
+  }
+  // the transport is used until ActroidBase is deleted.
+  delete actroid->pLoopback;
+  delete actroid->pSimulator;
+  delete actroid;
+}
+
+const char* actroid_error(const actroid_t* actroid)
+{
+  return actroid->error.c_str();
+}
+
+int actroid_num_joint(void)
+{
+  return ActroidBase::NUM_JOINT;
+}
+
+int actroid_set_timeout(actroid_t* actroid, int timeout_ms)
+{
+  actroid->pActroid->setTimeout(timeout_ms);
+  return 0;
+}
+
+int actroid_set_command_window(actroid_t* actroid, int window)
+{
+  actroid->pActroid->setCommandWindow(window);
+  return 0;
+}
+
+int actroid_set_reconnect_backoff(actroid_t* actroid, int min_ms, int max_ms)
+{
+  actroid->pActroid->setReconnectBackoff(min_ms, max_ms);
+  return 0;
+}
+
+int actroid_start_io_thread(actroid_t* actroid)
+{
+  try {
+    actroid->pActroid->startIoThread();
+  } catch (ActroidException& e) {
+    return _fail(actroid, e.what());
+  }
+  return 0;
+}
+
+int actroid_stop_io_thread(actroid_t* actroid)
+{
+  actroid->pActroid->stopIoThread();
+  return 0;
+}
+
+int actroid_set_target_angles(actroid_t* actroid, const double* angles, int n)
+{
+  if (n < 0 || n > ActroidBase::NUM_JOINT) {
+    return _fail(actroid, "Invalid number of joints.");
+  }
+  actroid->pActroid->setTargetAngles(angles, n);
+  return 0;
+}
+
+int actroid_set_target_angle(actroid_t* actroid, int index, double angle)
+{
+  if (index < 0 || index >= ActroidBase::NUM_JOINT) {
+    return _fail(actroid, "Invalid joint index.");
+  }
+  actroid->pActroid->setTargetAngle(index, angle);
+  return 0;
+}
+
+int actroid_update_angles(actroid_t* actroid)
+{
+  try {
+    actroid->pActroid->updateAngles();
+  } catch (ActroidException& e) {
+    return _fail(actroid, e.what());
+  }
+  return 0;
+}
+
+int actroid_update_current_angles(actroid_t* actroid)
+{
+  try {
+    actroid->pActroid->updateCurrentAngles();
+  } catch (ActroidException& e) {
+    return _fail(actroid, e.what());
+  }
+  return 0;
+}
+
+int actroid_get_current_angles(actroid_t* actroid, double* angles, int n)
+{
+  if (n < 0 || n > ActroidBase::NUM_JOINT) {
+    return _fail(actroid, "Invalid number of joints.");
+  }
+  actroid->pActroid->getCurrentAngles(angles, n);
+  return 0;
+}
+
+int actroid_get_estimated_angles(actroid_t* actroid, double* angles,
+                                 double* age, double* variance, int n)
+{
+  if (n < 0 || n > ActroidBase::NUM_JOINT) {
+    return _fail(actroid, "Invalid number of joints.");
+  }
+  actroid->pActroid->getEstimatedAngles(angles, age, variance, n);
+  return 0;
+}
+
+int actroid_set_trajectory(actroid_t* actroid, const double* time,
+                           const double* angles, int count, int cubic)
+{
+  try {
+    actroid->pActroid->setTrajectory(time, angles, count,
+                                     cubic ? INTERPOLATION_CUBIC : INTERPOLATION_LINEAR);
+  } catch (ActroidException& e) {
+    return _fail(actroid, e.what());
+  }
+  return 0;
+}
+
+int actroid_is_stale(actroid_t* actroid)
+{
+  return actroid->pActroid->isStale() ? 1 : 0;
+}
+
+long actroid_io_cycle_count(actroid_t* actroid)
+{
+  return actroid->pActroid->getIoCycleCount();
+}
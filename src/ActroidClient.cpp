@@ -0,0 +1,180 @@
+/**
+ * @file ActroidClient.cpp
+ * @brief Client of actroidd, the daemon which owns the serial port
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include <string.h>
+#include <sstream>
+
+#include "ActroidClient.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+ActroidClient::ActroidClient(const char* name) throw(ActroidException) :
+  m_Name(name), m_Region(name, false), m_Socket(-1), m_Timeout(DEFAULT_TIMEOUT_MS)
+{
+}
+
+ActroidClient::~ActroidClient()
+{
+  _disconnect();
+}
+
+void ActroidClient::_disconnect()
+{
+#ifndef WIN32
+  if (m_Socket >= 0) {
+    close(m_Socket);
+    m_Socket = -1;
+  }
+#endif
+}
+
+bool ActroidClient::_wait(const short events, const uint64_t deadline)
+{
+#ifdef WIN32
+  return false;
+#else
+  for (;;) {
+    uint64_t now = monotonicNanos();
+    if (now >= deadline) {
+      return false;
+    }
+    struct pollfd pfd;
+    pfd.fd = m_Socket;
+    pfd.events = events;
+    pfd.revents = 0;
+    int res = poll(&pfd, 1, (int)((deadline - now + 999999) / 1000000));
+    if (res > 0) {
+      return true;
+    }
+    if (res < 0 && errno != EINTR) {
+      return false;
+    }
+  }
+#endif
+}
+
+bool ActroidClient::getCurrentAngles(double* angles, double* age, double* variance, const int n)
+{
+  uint64_t time;
+  bool stale;
+  long cycleCount;
+  if (m_Region.readCurrent(angles, age, variance, n, time, stale, cycleCount) == 0) {
+    return false;
+  }
+  uint64_t now = monotonicNanos();
+  if (age) {
+    // ages were taken when the daemon published.
+    double elapsed = now > time ? (now - time) / 1.0e9 : 0;
+    for (int i = 0;i < n && i < m_Region.getNumJoint();i++) {
+      if (age[i] >= 0) {
+        age[i] += elapsed;
+      }
+    }
+  }
+  return !stale && m_Region.isAlive() && now < time + (uint64_t)CLIENT_DAEMON_TIMEOUT_MS * 1000000;
+}
+
+void ActroidClient::setTrajectory(const double* time, const double* angles, const int count,
+                                  const Interpolation interpolation) throw(ActroidException)
+{
+  // as many digits as it takes for the daemon to read the same doubles.
+  std::ostringstream os;
+  os.precision(17);
+  os << "trajectory " << (interpolation == INTERPOLATION_LINEAR ? "linear" : "cubic") << " " << count;
+  for (int i = 0;i < count;i++) {
+    os << " " << time[i];
+    for (int j = 0;j < m_Region.getNumJoint();j++) {
+      os << " " << angles[i * m_Region.getNumJoint() + j];
+    }
+  }
+  request(os.str().c_str());
+}
+
+std::string ActroidClient::request(const char* line) throw(ActroidException)
+{
+#ifdef WIN32
+  throw ActroidException("actroidd is not supported on this platform.");
+#else
+  // the socket does not block, so a daemon which does not answer costs
+  // this caller at most the timeout.
+  const uint64_t deadline = monotonicNanos() + (uint64_t)m_Timeout * 1000000;
+  if (m_Socket < 0) {
+    std::string path = SharedRegion::socketPath(m_Name.c_str());
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    m_Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_Socket < 0 || fcntl(m_Socket, F_SETFL, O_NONBLOCK) < 0 ||
+        connect(m_Socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      _disconnect();
+      throw ActroidException("Can not connect to actroidd.");
+    }
+    m_Received.clear();
+  }
+
+  std::string packet = std::string(line) + "\n";
+  size_t sent = 0;
+  while (sent < packet.size()) {
+    ssize_t n = send(m_Socket, packet.c_str() + sent, packet.size() - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      if (!_wait(POLLOUT, deadline)) {
+        _disconnect();
+        throw ActroidTimeoutException("actroidd does not take the request.");
+      }
+    } else {
+      _disconnect();
+      throw ActroidException("Lost connection to actroidd.");
+    }
+  }
+
+  // a reply which comes after the deadline would be taken for the reply
+  // of the next request, so the connection is dropped on timeout.
+  std::string::size_type end;
+  while ((end = m_Received.find('\n')) == std::string::npos) {
+    char buffer[256];
+    ssize_t n = recv(m_Socket, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      m_Received.append(buffer, n);
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      if (!_wait(POLLIN, deadline)) {
+        _disconnect();
+        throw ActroidTimeoutException("actroidd does not answer.");
+      }
+    } else {
+      _disconnect();
+      throw ActroidException("Lost connection to actroidd.");
+    }
+  }
+  std::string reply = m_Received.substr(0, end);
+  m_Received.erase(0, end + 1);
+
+  if (reply.compare(0, 2, "ok") == 0) {
+    return reply.size() > 3 ? reply.substr(3) : std::string();
+  }
+  if (reply.compare(0, 6, "error ") == 0) {
+    throw ActroidException(reply.substr(6).c_str());
+  }
+  throw ActroidException("Invalid reply from actroidd.");
+#endif
+}
@@ -0,0 +1,78 @@
+/**
+ * @file ActroidModel.cpp
+ * @brief Joint limits of each robot model
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include "ActroidModel.h"
+
+#ifdef WIN32
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+
+using namespace ogata_lab;
+
+#define RADIANS(x) ((x)/180.0*M_PI)
+#define DEFAULT_RAW_ANGLE ActroidModel::DEFAULT_RAW_ANGLE
+
+/*
+const double ActroidModel::MaxAngle[NUM_JOINT] = {
+  RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255),
+  RADIANS(120.0), RADIANS(58), RADIANS(45), RADIANS(112.312+14.497), RADIANS(90.0), RADIANS(25.833), RADIANS(28.423),
+  RADIANS(120.0), RADIANS(58), RADIANS(45), RADIANS(112.312+14.497), RADIANS(90.0), RADIANS(25.833), RADIANS(28.423),
+  RADIANS(255), RADIANS(255)
+};
+*/
+
+const double ActroidModel::MaxAngle[NUM_JOINT] = {
+  RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255), RADIANS(255),
+  RADIANS(120.0), RADIANS(58), RADIANS(45), RADIANS(140), RADIANS(90.0), RADIANS(25.833), RADIANS(28.423),
+  RADIANS(120.0), RADIANS(58), RADIANS(45), RADIANS(140), RADIANS(90.0), RADIANS(25.833), RADIANS(28.423),
+  RADIANS(255), RADIANS(255)
+};
+
+/*
+const double ActroidModel::MinAngle[NUM_JOINT] = {
+  RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0),
+  RADIANS(-14.0), RADIANS(-15.0), RADIANS(-45.0), RADIANS(14.497), RADIANS(-65.0), RADIANS(-15.458), RADIANS(-39.876),
+  RADIANS(-14.0), RADIANS(-15.0), RADIANS(-45.0), RADIANS(14.497), RADIANS(-65.0), RADIANS(-15.458), RADIANS(-39.876),
+  RADIANS(0), RADIANS(0)
+};
+*/
+
+
+const double ActroidModel::MinAngle[NUM_JOINT] = {
+  RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(0),
+  RADIANS(-18.0), RADIANS(-15.0), RADIANS(-45.0), RADIANS(20), RADIANS(-65.0), RADIANS(-15.458), RADIANS(-39.876),
+  RADIANS(-18.0), RADIANS(-15.0), RADIANS(-45.0), RADIANS(20), RADIANS(-65.0), RADIANS(-15.458), RADIANS(-39.876),
+  RADIANS(0), RADIANS(0)
+};
+
+const double ActroidModel::DefaultAngle[NUM_JOINT] = {
+  RADIANS(128), RADIANS(128), RADIANS(128), RADIANS(128),
+  RADIANS(0), RADIANS(128), RADIANS(128), RADIANS(128),
+  RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(90),  RADIANS(0), RADIANS(0), RADIANS(0),
+  RADIANS(0), RADIANS(0), RADIANS(0), RADIANS(90),  RADIANS(0), RADIANS(0), RADIANS(0),
+  RADIANS(0), RADIANS(128)
+};
+
+
+const uint8_t ActroidModel::DefaultRawAngle[NUM_JOINT] = {
+  DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE,
+  DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, 143, 86,
+
+  128, 218, 128, 128, 128,
+  113, 210, 0, 0, 0,
+
+  DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE, DEFAULT_RAW_ANGLE
+};
+
+const double ActroidModel::AngleMargin[NUM_JOINT] = {
+	0.001, 0.001, 0.001, 0.001, 0.001, 0.001, 0.001, 0.001,
+	0.040, 0.040, 0.001, 0.1, 0.001, 0.001, 0.001,
+	0.001, 0.001, 0.001, 0.05, 0.001, 0.001, 0.001,
+	0.001, 0.001
+
+};
@@ -0,0 +1,224 @@
+/**
+ * @file ActroidReactor.cpp
+ * @brief One thread driving the serial links of several controllers
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#ifdef __linux__
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#endif
+
+#include <iostream>
+
+#include "ActroidReactor.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+// longest wait, so that new clients and stop are noticed.
+#define REACTOR_SLICE_MS 10
+#define REACTOR_MAX_EVENTS 16
+
+namespace ogata_lab {
+  class ActroidReactorThread : public Thread {
+  private:
+    ActroidReactor* m_pReactor;
+  public:
+    ActroidReactorThread(ActroidReactor* pReactor) : m_pReactor(pReactor) {}
+    virtual ~ActroidReactorThread() {}
+    virtual void run() {
+      m_pReactor->_run();
+    }
+  };
+};
+
+ActroidReactor::ActroidReactor() :
+  m_pThread(NULL), m_Running(0), m_WakeupCount(0), m_EpollFd(-1),
+  m_Priority(0), m_CpuMask(0)
+{
+}
+
+ActroidReactor::~ActroidReactor()
+{
+  if (m_pThread) {
+    atomicStore(&m_Running, 0);
+    m_pThread->join();
+    delete m_pThread;
+  }
+#ifdef __linux__
+  if (m_EpollFd >= 0) {
+    close(m_EpollFd);
+  }
+#endif
+}
+
+void ActroidReactor::add(ReactorClient* pClient)
+{
+  MutexGuard guard(m_Mutex);
+  if (!m_pThread) {
+#ifdef __linux__
+    if ((m_EpollFd = epoll_create(REACTOR_MAX_EVENTS)) < 0) {
+      throw ThreadException("Can not create epoll instance.");
+    }
+#endif
+    atomicStore(&m_Running, 1);
+    m_pThread = new ActroidReactorThread(this);
+    try {
+      m_pThread->start();
+    } catch (ThreadException& e) {
+      delete m_pThread;
+      m_pThread = NULL;
+      throw;
+    }
+  }
+  Entry entry;
+  entry.pClient = pClient;
+  entry.fd = -1;
+  entry.wakeup = 1; // stepped at once.
+  entry.readable = false;
+  entry.error = false;
+  _watch(entry);
+  m_Entries.push_back(entry);
+}
+
+void ActroidReactor::remove(ReactorClient* pClient)
+{
+  for (;;) {
+    {
+      MutexGuard guard(m_Mutex);
+      bool found = false;
+      for (size_t i = 0;i < m_Entries.size();i++) {
+        if (m_Entries[i].pClient == pClient) {
+          // step it now, so that it notices it is finishing.
+          m_Entries[i].wakeup = 1;
+          found = true;
+        }
+      }
+      if (!found) {
+        return;
+      }
+    }
+    Thread::sleep(1);
+  }
+}
+
+int ActroidReactor::getClientCount()
+{
+  MutexGuard guard(m_Mutex);
+  return (int)m_Entries.size();
+}
+
+/**
+ * Watch the descriptor the client has now. A replaced descriptor is not
+ * removed: it was closed, which removed it from the epoll set.
+ */
+void ActroidReactor::_watch(Entry& entry)
+{
+  entry.fd = entry.pClient->getFd();
+#ifdef __linux__
+  if (entry.fd >= 0) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = entry.pClient;
+    if (epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, entry.fd, &ev) < 0) {
+      std::cerr << "[ActroidReactor] can not watch descriptor " << entry.fd << ", polling it." << std::endl;
+      entry.fd = -1;
+    }
+  }
+#endif
+}
+
+void ActroidReactor::_unwatch(Entry& entry)
+{
+#ifdef __linux__
+  if (entry.fd >= 0) {
+    struct epoll_event ev;
+    epoll_ctl(m_EpollFd, EPOLL_CTL_DEL, entry.fd, &ev);
+  }
+#endif
+  entry.fd = -1;
+}
+
+/**
+ * Wait until a descriptor is readable or timeoutMs passes, and mark the
+ * entries to be stepped.
+ */
+void ActroidReactor::_wait(const int timeoutMs)
+{
+#ifdef __linux__
+  struct epoll_event events[REACTOR_MAX_EVENTS];
+  int n = epoll_wait(m_EpollFd, events, REACTOR_MAX_EVENTS, timeoutMs);
+  if (n <= 0) {
+    return;
+  }
+  MutexGuard guard(m_Mutex);
+  for (int i = 0;i < n;i++) {
+    for (size_t j = 0;j < m_Entries.size();j++) {
+      if (m_Entries[j].pClient == events[i].data.ptr) {
+        m_Entries[j].readable = true;
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+          m_Entries[j].error = true;
+        }
+      }
+    }
+  }
+#else
+  // no epoll: every client is polled each millisecond.
+  Thread::sleep(timeoutMs < 1 ? 0 : 1);
+  MutexGuard guard(m_Mutex);
+  for (size_t j = 0;j < m_Entries.size();j++) {
+    m_Entries[j].readable = true;
+  }
+#endif
+}
+
+void ActroidReactor::_run()
+{
+  if (m_Priority > 0 && !Thread::setCurrentPriority(m_Priority)) {
+    std::cerr << "[ActroidReactor] can not set priority " << m_Priority << ", using default scheduling." << std::endl;
+  }
+  if (m_CpuMask && !Thread::setCurrentAffinity(m_CpuMask)) {
+    std::cerr << "[ActroidReactor] can not set CPU affinity, running on any CPU." << std::endl;
+  }
+
+  while (atomicLoad(&m_Running)) {
+    uint64_t now = monotonicNanos();
+    uint64_t until = now + (uint64_t)REACTOR_SLICE_MS * 1000000;
+    {
+      MutexGuard guard(m_Mutex);
+      for (size_t i = 0;i < m_Entries.size();) {
+        Entry& entry = m_Entries[i];
+        if (entry.readable || (entry.wakeup && entry.wakeup <= now)) {
+          uint64_t wakeup = 0;
+          bool relinked = false;
+          bool alive = entry.pClient->step(now, entry.error, wakeup, relinked);
+          entry.readable = false;
+          entry.error = false;
+          entry.wakeup = wakeup;
+          if (!alive) {
+            if (!relinked) {
+              _unwatch(entry);
+            }
+            m_Entries.erase(m_Entries.begin() + i);
+            continue;
+          }
+          if (relinked) {
+            _watch(entry);
+          }
+        }
+        if (entry.wakeup && entry.wakeup < until) {
+          until = entry.wakeup;
+        }
+        i++;
+      }
+    }
+
+    now = monotonicNanos();
+    int wait = until > now ? (int)((until - now + 999999) / 1000000) : 0;
+    _wait(wait);
+    atomicAdd(&m_WakeupCount, 1);
+  }
+}
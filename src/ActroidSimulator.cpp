@@ -0,0 +1,377 @@
+/**
+ * @file ActroidSimulator.cpp
+ * @brief Simulated Actroid controller for benchmarks without the robot
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#ifndef WIN32
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/select.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+#include <iostream>
+
+#include "SerialPort.h"
+#include "ActroidSimulator.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+// start, stop and 8 data bits are carried for each byte.
+#define BITS_PER_BYTE 10
+
+ActroidSimulator::ActroidSimulator()
+{
+  m_Baudrate = ActroidModel::BAUDRATE;
+  m_ServoLag = 0;
+  m_Latency = 0;
+  m_NackRate = 0;
+  m_DropRate = 0;
+  m_CorruptRate = 0;
+  m_Random = 1;
+  reset();
+}
+
+void ActroidSimulator::reset()
+{
+  m_PacketSize = 0;
+  m_OutputHead = 0;
+  m_OutputCount = 0;
+  m_RxFreeTime = 0;
+  m_TxFreeTime = 0;
+  m_Online = false;
+  for (int i = 0;i < NUM_JOINT;i++) {
+    m_Target[i] = m_Current[i] = ActroidModel::DefaultRawAngle[i];
+  }
+  m_ServoTime = 0;
+  m_SetCount = 0;
+  m_GetCount = 0;
+  m_NackCount = 0;
+  m_DropCount = 0;
+  m_CorruptCount = 0;
+  m_FrameErrorCount = 0;
+  m_OverrunCount = 0;
+}
+
+uint64_t ActroidSimulator::_byteTime() const
+{
+  if (m_Baudrate <= 0) {
+    return 0;
+  }
+  return (uint64_t)BITS_PER_BYTE * 1000000000 / m_Baudrate;
+}
+
+bool ActroidSimulator::_chance(const double rate)
+{
+  if (rate <= 0) {
+    return false;
+  }
+  // xorshift32, so that runs with the same seed inject the same faults on every platform.
+  m_Random ^= m_Random << 13;
+  m_Random ^= m_Random >> 17;
+  m_Random ^= m_Random << 5;
+  return m_Random / 4294967296.0 < rate;
+}
+
+void ActroidSimulator::_updateServo(const uint64_t now)
+{
+  double ratio = 1.0;
+  if (m_ServoLag > 0 && m_ServoTime > 0) {
+    if (now <= m_ServoTime) {
+      return;
+    }
+    ratio = 1.0 - exp(-(double)(now - m_ServoTime) / 1000000.0 / m_ServoLag);
+  }
+  for (int i = 0;i < NUM_JOINT;i++) {
+    m_Current[i] += (m_Target[i] - m_Current[i]) * ratio;
+  }
+  m_ServoTime = now;
+}
+
+uint8_t ActroidSimulator::getRawAngle(const int index, const uint64_t now)
+{
+  _updateServo(now);
+  return (uint8_t)(m_Current[index] + 0.5);
+}
+
+void ActroidSimulator::_send(const uint8_t* data, const int size, const uint64_t now)
+{
+  uint64_t time = now + (uint64_t)m_Latency * 1000;
+  for (int i = 0;i < size;i++) {
+    if (m_OutputCount == SIMULATOR_OUTPUT_SIZE) {
+      m_OverrunCount++;
+      continue;
+    }
+    OutputByte& b = m_Output[(m_OutputHead + m_OutputCount++) % SIMULATOR_OUTPUT_SIZE];
+    b.data = data[i];
+    if (_chance(m_CorruptRate)) {
+      b.data ^= 0x5a;
+      m_CorruptCount++;
+    }
+    if (m_TxFreeTime > time) {
+      time = m_TxFreeTime;
+    }
+    time += _byteTime();
+    m_TxFreeTime = time;
+    b.time = time;
+  }
+}
+
+int ActroidSimulator::_expectedSize() const
+{
+  switch (m_Packet[1]) {
+  case ActroidModel::ONLINE:
+  case ActroidModel::OFFLINE:
+    return 3;
+  case ActroidModel::GET:
+    return 5;
+  case ActroidModel::SET:
+    return SET_PACKET_SIZE;
+  default:
+    return 0;
+  }
+}
+
+void ActroidSimulator::input(const uint8_t* data, const int size, const uint64_t now)
+{
+  for (int i = 0;i < size;i++) {
+    if (m_RxFreeTime < now) {
+      m_RxFreeTime = now;
+    }
+    m_RxFreeTime += _byteTime();
+
+    if (m_PacketSize == 0 && data[i] != ActroidModel::START) {
+      m_FrameErrorCount++;
+      continue;
+    }
+    m_Packet[m_PacketSize++] = data[i];
+    if (m_PacketSize < 2) {
+      continue;
+    }
+    int expected = _expectedSize();
+    if (expected == 0) {
+      // unknown command. Resynchronize on the next start byte.
+      m_FrameErrorCount++;
+      m_PacketSize = 0;
+      const uint8_t nack = ActroidModel::NACK;
+      _send(&nack, 1, m_RxFreeTime);
+      continue;
+    }
+    if (m_PacketSize == expected) {
+      _onPacket(m_RxFreeTime);
+      m_PacketSize = 0;
+    }
+  }
+}
+
+void ActroidSimulator::_onPacket(const uint64_t now)
+{
+  const uint8_t ack = ActroidModel::ACK;
+  const uint8_t nack = ActroidModel::NACK;
+  if (m_Packet[m_PacketSize-1] != ActroidModel::STOP) {
+    m_FrameErrorCount++;
+    _send(&nack, 1, now);
+    return;
+  }
+  if (_chance(m_DropRate)) {
+    m_DropCount++;
+    return;
+  }
+  if (_chance(m_NackRate)) {
+    m_NackCount++;
+    _send(&nack, 1, now);
+    return;
+  }
+
+  switch (m_Packet[1]) {
+  case ActroidModel::ONLINE:
+    m_Online = true;
+    _send(&ack, 1, now);
+    break;
+  case ActroidModel::OFFLINE:
+    m_Online = false;
+    _send(&ack, 1, now);
+    break;
+  case ActroidModel::SET: {
+    // SET2, angles and checksum add up to zero.
+    uint8_t sum = 0;
+    for (int i = 2;i < NUM_JOINT + 4;i++) {
+      sum += m_Packet[i];
+    }
+    if (m_Packet[2] != ActroidModel::SET2 || sum != 0) {
+      m_FrameErrorCount++;
+      _send(&nack, 1, now);
+      break;
+    }
+    _updateServo(now);
+    for (int i = 0;i < NUM_JOINT;i++) {
+      m_Target[i] = m_Packet[3 + i];
+    }
+    m_SetCount++;
+    _send(&ack, 1, now);
+    break;
+  }
+  case ActroidModel::GET: {
+    int start = m_Packet[2];
+    int count = m_Packet[3];
+    if (count <= 0 || start + count > NUM_JOINT) {
+      m_FrameErrorCount++;
+      _send(&nack, 1, now);
+      break;
+    }
+    uint8_t reply[NUM_JOINT + 2];
+    reply[0] = ack;
+    reply[1] = count;
+    for (int i = 0;i < count;i++) {
+      reply[2 + i] = getRawAngle(start + i, now);
+    }
+    m_GetCount++;
+    _send(reply, count + 2, now);
+    break;
+  }
+  }
+}
+
+int ActroidSimulator::output(uint8_t* data, const int maxSize, const uint64_t now)
+{
+  int size = 0;
+  while (size < maxSize && m_OutputCount > 0 && m_Output[m_OutputHead].time <= now) {
+    data[size++] = m_Output[m_OutputHead].data;
+    m_OutputHead = (m_OutputHead + 1) % SIMULATOR_OUTPUT_SIZE;
+    m_OutputCount--;
+  }
+  return size;
+}
+
+
+#ifdef WIN32
+
+PtySimulator::PtySimulator(ActroidSimulator* pSimulator)
+  : m_pSimulator(pSimulator), m_Master(-1), m_Slave(-1), m_Running(0)
+{
+  throw ComException("Pseudo terminal is not supported.");
+}
+
+PtySimulator::~PtySimulator()
+{
+}
+
+void PtySimulator::start()
+{
+}
+
+void PtySimulator::stop()
+{
+}
+
+void PtySimulator::run()
+{
+}
+
+#else
+
+PtySimulator::PtySimulator(ActroidSimulator* pSimulator)
+  : m_pSimulator(pSimulator), m_Master(-1), m_Slave(-1), m_Running(0)
+{
+  m_Master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (m_Master < 0 || grantpt(m_Master) < 0 || unlockpt(m_Master) < 0) {
+    if (m_Master >= 0) {
+      ::close(m_Master);
+    }
+    throw ComException("Failed to open pseudo terminal.");
+  }
+  m_SlaveName = ptsname(m_Master);
+
+  // keep one slave descriptor open, otherwise reading the master fails
+  // with EIO while the host has the port closed.
+  m_Slave = ::open(m_SlaveName.c_str(), O_RDWR | O_NOCTTY);
+  if (m_Slave < 0) {
+    ::close(m_Master);
+    throw ComException("Failed to open pseudo terminal.");
+  }
+  struct termios tio;
+  tcgetattr(m_Slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(m_Slave, TCSANOW, &tio);
+}
+
+PtySimulator::~PtySimulator()
+{
+  stop();
+  ::close(m_Slave);
+  ::close(m_Master);
+}
+
+void PtySimulator::start()
+{
+  if (atomicExchange(&m_Running, 1)) {
+    return;
+  }
+  Thread::start();
+}
+
+void PtySimulator::stop()
+{
+  if (!atomicExchange(&m_Running, 0)) {
+    return;
+  }
+  join();
+}
+
+void PtySimulator::run()
+{
+  uint8_t buffer[256];
+  while (atomicLoad(&m_Running)) {
+    uint64_t now = monotonicNanos();
+    // wake up at least every 10 ms to see stop().
+    uint64_t wait = 10000000;
+    uint64_t next = m_pSimulator->getNextOutputTime();
+    if (next && next < now + wait) {
+      wait = next > now ? next - now : 0;
+    }
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(m_Master, &fds);
+    struct timeval timeout;
+    timeout.tv_sec = (long)(wait / 1000000000);
+    timeout.tv_usec = (long)(wait % 1000000000 / 1000);
+    int res = select(m_Master + 1, &fds, NULL, NULL, &timeout);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "[PtySimulator] select failed (" << strerror(errno) << "), simulator stopped." << std::endl;
+      break;
+    }
+
+    now = monotonicNanos();
+    if (res > 0) {
+      int size = ::read(m_Master, buffer, sizeof(buffer));
+      if (size > 0) {
+        m_pSimulator->input(buffer, size, now);
+      }
+    }
+    int size = m_pSimulator->output(buffer, sizeof(buffer), now);
+    for (int written = 0;written < size;) {
+      int res = ::write(m_Master, buffer + written, size - written);
+      if (res < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+          continue;
+        }
+        std::cerr << "[PtySimulator] write failed (" << strerror(errno) << "), reply lost." << std::endl;
+        break;
+      }
+      written += res;
+    }
+  }
+}
+
+#endif
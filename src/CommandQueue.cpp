@@ -0,0 +1,245 @@
+/**
+ * @file CommandQueue.cpp
+ * @brief Windowed command queue for Actroid serial protocol
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <string.h>
+
+#include "CommandQueue.h"
+#include "Thread.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+CommandQueue::CommandQueue(Transport* pTransport, const int window) :
+  m_pTransport(pTransport), m_Head(0), m_Count(0), m_InFlight(0), m_TxOffset(0), m_TxBlockedTime(0),
+  m_Window(1), m_Timeout(200), m_LastRxTime(0),
+  m_NackCount(0), m_TimeoutCount(0), m_FrameErrorCount(0), m_Unexpected(false)
+{
+  setWindow(window);
+}
+
+void CommandQueue::setWindow(const int window)
+{
+  m_Window = window < 1 ? 1 : (window > COMMAND_QUEUE_SIZE ? COMMAND_QUEUE_SIZE : window);
+}
+
+Command* CommandQueue::submit(const uint8_t* packet, const int size, const int replySize,
+			      CommandCallback callback, void* userData)
+{
+  if (m_Count == COMMAND_QUEUE_SIZE || size > COMMAND_MAX_PACKET || replySize > COMMAND_MAX_REPLY) {
+    return NULL;
+  }
+  int index = 0;
+  while (m_Pool[index].m_Status != COMMAND_FREE) {
+    if (++index == COMMAND_QUEUE_SIZE) {
+      return NULL; // all slots held by the caller (not released).
+    }
+  }
+
+  Command* command = &m_Pool[index];
+  memcpy(command->m_Packet, packet, size);
+  command->m_PacketSize = size;
+  command->m_ReplySize = replySize;
+  command->m_Status = COMMAND_QUEUED;
+  command->m_Callback = callback;
+  command->m_UserData = userData;
+  m_Fifo[(m_Head + m_Count) % COMMAND_QUEUE_SIZE] = index;
+  m_Count++;
+  return command;
+}
+
+void CommandQueue::flush()
+{
+  IoBuffer buffers[COMMAND_QUEUE_SIZE];
+  int num = 0;
+  int bytes = 0;
+  for (int i = m_InFlight;i < m_Count && i < m_Window;i++) {
+    Command* command = _at(i);
+    // the first one may have been written in part by the last flush.
+    const int offset = num == 0 ? m_TxOffset : 0;
+    buffers[num].data = command->m_Packet + offset;
+    buffers[num].size = command->m_PacketSize - offset;
+    bytes += buffers[num].size;
+    num++;
+  }
+  if (num == 0) {
+    return;
+  }
+
+  // a non-blocking transport may take only a part; the rest is written by the next flush.
+  int written = m_pTransport->writev(buffers, num);
+  if (written < 0 || written > bytes) {
+    throw ComAccessException();
+  }
+  uint64_t now = monotonicNanos();
+  uint64_t deadline = now + (uint64_t)m_Timeout * 1000000;
+  if (written == bytes) {
+    m_TxBlockedTime = 0;
+  } else if (m_TxBlockedTime == 0) {
+    m_TxBlockedTime = now;
+  } else if (now >= m_TxBlockedTime + (uint64_t)m_Timeout * 1000000) {
+    // the port has not taken the commands for as long as a reply may take.
+    throw ComTimeoutException();
+  }
+  int sent = 0;
+  for (int i = 0;i < num;i++) {
+    if (written < (int)buffers[i].size) {
+      m_TxOffset += written;
+      break;
+    }
+    written -= buffers[i].size;
+    m_TxOffset = 0;
+    Command* command = _at(m_InFlight + i);
+    command->m_Status = COMMAND_SENT;
+    command->m_SentTime = now;
+    command->m_Deadline = deadline;
+    sent++;
+  }
+  if (sent == 0) {
+    return;
+  }
+  if (m_InFlight == 0) {
+    m_InFlight = sent;
+    m_Unexpected = false;
+    _expectNext();
+  } else {
+    m_InFlight += sent;
+  }
+}
+
+void CommandQueue::service(const int timeoutMs)
+{
+  flush();
+  if (m_InFlight == 0) {
+    return;
+  }
+
+  uint64_t now = monotonicNanos();
+  int wait = timeoutMs;
+  uint64_t deadline = _at(0)->m_Deadline;
+  int untilDeadline = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+  if (wait < 0 || untilDeadline < wait) {
+    wait = untilDeadline;
+  }
+
+  if (m_pTransport->waitForRxData(wait)) {
+    _receive();
+  }
+  _checkTimeout(monotonicNanos());
+  flush();
+}
+
+void CommandQueue::poll()
+{
+  // bytes which nobody expects are read too, so that the transport does not stay readable.
+  _receive();
+  _checkTimeout(monotonicNanos());
+  flush();
+}
+
+void CommandQueue::_receive()
+{
+  uint8_t buf[64];
+  int size = m_pTransport->readAvailable(buf, sizeof(buf));
+  if (size > 0) {
+    m_LastRxTime = monotonicNanos();
+  }
+  _parse(buf, size);
+}
+
+bool CommandQueue::wait(const Command* command, const int timeoutMs)
+{
+  uint64_t deadline = monotonicNanos() + (uint64_t)timeoutMs * 1000000;
+  while (!command->isDone()) {
+    uint64_t now = monotonicNanos();
+    if (timeoutMs >= 0 && now >= deadline) {
+      return false;
+    }
+    service(timeoutMs < 0 ? -1 : (int)((deadline - now) / 1000000));
+  }
+  return true;
+}
+
+void CommandQueue::release(const Command* command)
+{
+  if (command->isDone()) {
+    const_cast<Command*>(command)->m_Status = COMMAND_FREE;
+  }
+}
+
+void CommandQueue::clear()
+{
+  // a packet written in part is abandoned with the rest.
+  m_TxOffset = 0;
+  m_TxBlockedTime = 0;
+  while (m_Count > 0) {
+    m_InFlight = m_Count;
+    _complete(COMMAND_ABORTED);
+  }
+}
+
+void CommandQueue::_complete(const CommandStatus status)
+{
+  Command* command = _at(0);
+  command->m_Status = status;
+  m_Head = (m_Head + 1) % COMMAND_QUEUE_SIZE;
+  m_Count--;
+  m_InFlight--;
+  _expectNext();
+  if (command->m_Callback) {
+    command->m_Callback(command, command->m_UserData);
+    command->m_Status = COMMAND_FREE;
+  }
+}
+
+/**
+ * Point the parser to the reply of the oldest command in flight.
+ */
+void CommandQueue::_expectNext()
+{
+  if (m_InFlight > 0) {
+    Command* command = _at(0);
+    m_Parser.expect(command->m_ReplySize, command->m_Reply);
+  }
+}
+
+void CommandQueue::_parse(const uint8_t* data, const int size)
+{
+  int i = 0;
+  while (i < size) {
+    if (m_InFlight == 0) {
+      // nothing is expected: one error until the next command is sent,
+      // however many reads the burst takes.
+      if (!m_Unexpected) {
+        m_Unexpected = true;
+        m_FrameErrorCount++;
+      }
+      return;
+    }
+    Command* command = _at(0);
+    i += m_Parser.parse(data + i, size - i);
+    if (m_Parser.getStatus() == REPLY_DONE) {
+      _complete(COMMAND_DONE);
+    } else if (m_Parser.getStatus() == REPLY_NACK) {
+      m_NackCount++;
+      _complete(COMMAND_NACK);
+    } else if (m_Parser.isAcked()) {
+      command->m_Status = COMMAND_ACKED;
+    }
+  }
+}
+
+void CommandQueue::_checkTimeout(const uint64_t now)
+{
+  while (m_InFlight > 0 && _at(0)->m_Deadline <= now) {
+    if (m_Parser.isStarted() || m_LastRxTime >= _at(0)->m_SentTime) {
+      _complete(COMMAND_LOST);
+    } else {
+      m_TimeoutCount++;
+      _complete(COMMAND_TIMEOUT);
+    }
+  }
+}
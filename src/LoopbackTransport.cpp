@@ -0,0 +1,100 @@
+/**
+ * @file LoopbackTransport.cpp
+ * @brief In-process transport to an ActroidSimulator
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+#include "LoopbackTransport.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+static void _sleepUntil(const uint64_t time)
+{
+  uint64_t now = monotonicNanos();
+  if (time <= now) {
+    return;
+  }
+#ifdef WIN32
+  Sleep((DWORD)((time - now + 999999) / 1000000));
+#else
+  struct timespec ts;
+  ts.tv_sec = (time - now) / 1000000000;
+  ts.tv_nsec = (time - now) % 1000000000;
+  while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+  }
+#endif
+}
+
+bool LoopbackTransport::_waitUntil(const uint64_t deadline)
+{
+  uint64_t next = m_pSimulator->getNextOutputTime();
+  if (next == 0) {
+    return false;
+  }
+  if (next > deadline) {
+    _sleepUntil(deadline);
+    return false;
+  }
+  _sleepUntil(next);
+  return true;
+}
+
+void LoopbackTransport::flushRxBuffer()
+{
+  uint8_t buf[64];
+  uint64_t now = monotonicNanos();
+  while (m_pSimulator->output(buf, sizeof(buf), now) > 0) {
+  }
+}
+
+int LoopbackTransport::write(const void* src, const unsigned int size)
+{
+  m_pSimulator->input((const uint8_t*)src, size, monotonicNanos());
+  return size;
+}
+
+int LoopbackTransport::writev(const IoBuffer* buffers, const int count)
+{
+  uint64_t now = monotonicNanos();
+  int total = 0;
+  for (int i = 0;i < count;i++) {
+    m_pSimulator->input((const uint8_t*)buffers[i].data, buffers[i].size, now);
+    total += buffers[i].size;
+  }
+  return total;
+}
+
+bool LoopbackTransport::waitForRxData(const int timeoutMs)
+{
+  uint64_t deadline = timeoutMs < 0 ? (uint64_t)-1 : monotonicNanos() + (uint64_t)timeoutMs * 1000000;
+  return _waitUntil(deadline);
+}
+
+int LoopbackTransport::readExact(void *dst, const unsigned int size, const int timeoutMs)
+{
+  uint64_t deadline = timeoutMs < 0 ? (uint64_t)-1 : monotonicNanos() + (uint64_t)timeoutMs * 1000000;
+  unsigned int received = 0;
+  for (;;) {
+    received += m_pSimulator->output((uint8_t*)dst + received, size - received, monotonicNanos());
+    if (received == size) {
+      return size;
+    }
+    if (!_waitUntil(deadline)) {
+      throw ComTimeoutException();
+    }
+  }
+}
+
+int LoopbackTransport::readAvailable(void *dst, const unsigned int maxSize)
+{
+  return m_pSimulator->output((uint8_t*)dst, maxSize, monotonicNanos());
+}
@@ -0,0 +1,135 @@
+/**
+ * @file ReadScheduler.cpp
+ * @brief Joint group scheduler for partial joint angle reads
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ReadScheduler.h"
+
+using namespace ogata_lab;
+
+bool ogata_lab::parseJointSpec(const std::string& spec, std::vector<JointSpec>& entries)
+{
+  entries.clear();
+  std::string::size_type pos = 0;
+  while (pos < spec.length()) {
+    std::string::size_type end = spec.find(',', pos);
+    if (end == std::string::npos) {
+      end = spec.length();
+    }
+    std::string item = spec.substr(pos, end - pos);
+    pos = end + 1;
+    if (item.find_first_not_of(" \t") == std::string::npos) {
+      continue;
+    }
+
+    std::vector<std::string> fields;
+    std::string::size_type p = 0;
+    for (;;) {
+      std::string::size_type q = item.find(':', p);
+      fields.push_back(item.substr(p, q == std::string::npos ? std::string::npos : q - p));
+      if (q == std::string::npos) {
+        break;
+      }
+      p = q + 1;
+    }
+    if (fields.size() != 4) {
+      return false;
+    }
+    std::string::size_type b = fields[0].find_first_not_of(" \t");
+    std::string::size_type e = fields[0].find_last_not_of(" \t");
+    if (b == std::string::npos) {
+      return false;
+    }
+    int values[3];
+    for (int i = 0;i < 3;i++) {
+      char* endp;
+      values[i] = strtol(fields[i+1].c_str(), &endp, 10);
+      if (endp == fields[i+1].c_str() || *endp != '\0') {
+        return false;
+      }
+    }
+    JointSpec entry;
+    entry.name = fields[0].substr(b, e - b + 1);
+    entry.start = values[0];
+    entry.count = values[1];
+    entry.value = values[2];
+    entries.push_back(entry);
+  }
+  return true;
+}
+
+bool ReadScheduler::addGroup(const char* name, const int start, const int count, const int period)
+{
+  if (start < 0 || count <= 0 || start + count > m_NumJoint || period <= 0) {
+    return false;
+  }
+  JointGroup group;
+  group.name = name;
+  group.start = start;
+  group.count = count;
+  group.period = period;
+  m_Groups.push_back(group);
+  return true;
+}
+
+bool ReadScheduler::parse(const std::string& spec)
+{
+  std::vector<JointSpec> entries;
+  if (!parseJointSpec(spec, entries)) {
+    return false;
+  }
+  ReadScheduler scheduler(m_NumJoint);
+  for (std::vector<JointSpec>::const_iterator it = entries.begin();it != entries.end();++it) {
+    if (!scheduler.addGroup(it->name.c_str(), it->start, it->count, it->value)) {
+      return false;
+    }
+  }
+  m_Groups = scheduler.m_Groups;
+  m_Cycle = 0;
+  return true;
+}
+
+const JointGroup* ReadScheduler::find(const char* name) const
+{
+  for (std::vector<JointGroup>::const_iterator it = m_Groups.begin();it != m_Groups.end();++it) {
+    if (it->name == name) {
+      return &(*it);
+    }
+  }
+  return NULL;
+}
+
+void ReadScheduler::next(int& start, int& count)
+{
+  if (m_Groups.empty()) {
+    start = 0;
+    count = m_NumJoint;
+    return;
+  }
+
+  int first = m_NumJoint;
+  int last = 0;
+  for (std::vector<JointGroup>::const_iterator it = m_Groups.begin();it != m_Groups.end();++it) {
+    if (m_Cycle % it->period == 0) {
+      if (it->start < first) {
+        first = it->start;
+      }
+      if (it->start + it->count > last) {
+        last = it->start + it->count;
+      }
+    }
+  }
+  m_Cycle++;
+  if (first >= last) {
+    // no group is due in this cycle; read the first group to keep the link busy.
+    first = m_Groups[0].start;
+    last = first + m_Groups[0].count;
+  }
+  start = first;
+  count = last - first;
+}
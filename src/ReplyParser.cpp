@@ -0,0 +1,107 @@
+/**
+ * @file ReplyParser.cpp
+ * @brief Incremental, self-resynchronizing parser of controller replies
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <string.h>
+
+#include "ReplyParser.h"
+
+using namespace ogata_lab;
+
+static const uint8_t _ack = 0x06;
+static const uint8_t _nack = 0x15;
+
+ReplyParser::ReplyParser() :
+  m_State(FINISHED), m_Status(REPLY_DONE), m_pReply(NULL), m_ReplySize(0),
+  m_Received(0), m_Started(false), m_Skipping(false), m_ResyncCount(0)
+{
+}
+
+void ReplyParser::expect(const int replySize, uint8_t* reply)
+{
+  m_State = WAIT_ACK;
+  m_Status = REPLY_PENDING;
+  m_pReply = reply;
+  m_ReplySize = replySize;
+  m_Received = 0;
+  m_Started = false;
+  m_Skipping = false;
+}
+
+void ReplyParser::_skip()
+{
+  if (!m_Skipping) {
+    m_Skipping = true;
+    m_ResyncCount++;
+  }
+}
+
+int ReplyParser::getNeeded() const
+{
+  switch (m_State) {
+  case WAIT_ACK:
+    return m_ReplySize + 1;
+  case WAIT_COUNT:
+    return m_ReplySize;
+  case WAIT_DATA:
+    return m_ReplySize - m_Received;
+  default:
+    return 0;
+  }
+}
+
+int ReplyParser::parse(const uint8_t* data, const int size)
+{
+  int i = 0;
+  while (i < size && m_State != FINISHED) {
+    m_Started = true;
+    if (m_State == WAIT_ACK) {
+      if (data[i] == _ack) {
+        m_Skipping = false;
+        if (m_ReplySize == 0) {
+          m_State = FINISHED;
+          m_Status = REPLY_DONE;
+        } else {
+          m_State = WAIT_COUNT;
+        }
+      } else if (data[i] == _nack) {
+        m_Skipping = false;
+        m_State = FINISHED;
+        m_Status = REPLY_NACK;
+      } else {
+        _skip();
+      }
+      i++;
+    } else if (m_State == WAIT_COUNT) {
+      if (data[i] == m_ReplySize - 1) {
+        m_Skipping = false;
+        m_pReply[0] = data[i];
+        m_Received = 1;
+        m_State = m_ReplySize == 1 ? FINISHED : WAIT_DATA;
+        if (m_State == FINISHED) {
+          m_Status = REPLY_DONE;
+        }
+      } else {
+        // e.g. a duplicated ack.
+        _skip();
+      }
+      i++;
+    } else {
+      int len = m_ReplySize - m_Received;
+      if (len > size - i) {
+        len = size - i;
+      }
+      memcpy(m_pReply + m_Received, data + i, len);
+      m_Received += len;
+      i += len;
+      if (m_Received == m_ReplySize) {
+        m_State = FINISHED;
+        m_Status = REPLY_DONE;
+      }
+    }
+  }
+  return i;
+}
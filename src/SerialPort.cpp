@@ -11,7 +11,7 @@
  * Header Including Division
  */
 #ifdef WIN32
-
+#include <string.h>
 #else
 
 #include <unistd.h>
@@ -19,15 +19,19 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <errno.h>
 #include <signal.h>
+#include <poll.h>
 #define _POSIX_SOURCE 1
 
 #endif
 
 #include "SerialPort.h"
+#include "Thread.h"
+#include "TraceRecorder.h"
 
 /* Header includeing division
  ************************************************/
@@ -35,14 +39,29 @@
 
 using namespace net::ysuga;
 
+#ifndef WIN32
+#define IOV_MAX_CHUNKS 16
+#endif
+
+/**
+ * monotonic clock in milliseconds. Used for read deadlines.
+ */
+static long _monotonicMillis()
+{
+	return (long)(monotonicNanos() / 1000000);
+}
+
 /******************************
  */
 SerialPort::SerialPort(const char* filename, const int baudrate)
 {
+	m_pTrace = NULL;
+	m_NonBlocking = false;
 
 #ifdef WIN32
 	DCB dcb;
 	m_hComm = 0;
+	m_ReadTimeout = -1;
 	m_hComm = CreateFileA(filename,	GENERIC_READ | GENERIC_WRITE,
 		0, NULL, OPEN_EXISTING,	0, NULL );
 	if(m_hComm == INVALID_HANDLE_VALUE) {
@@ -77,7 +96,8 @@ SerialPort::SerialPort(const char* filename, const int baudrate)
     }
 
 #else
-  if((m_Fd = open(filename, O_RDWR /*| O_NOCTTY |O_NONBLOCK*/)) < 0) {
+  // O_NONBLOCK, so that open does not wait for carrier before CLOCAL is set.
+  if((m_Fd = open(filename, O_RDWR /*| O_NOCTTY*/ | O_NONBLOCK)) < 0) {
       throw ComOpenException();
     }
     struct termios tio;
@@ -85,6 +105,11 @@ SerialPort::SerialPort(const char* filename, const int baudrate)
     cfsetspeed(&tio, baudrate);
     tio.c_cflag |= CS8 | CLOCAL | CREAD;
     tcsetattr(m_Fd, TCSANOW, &tio);
+    int flags = fcntl(m_Fd, F_GETFL);
+    if(flags < 0 || fcntl(m_Fd, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+      close(m_Fd);
+      throw ComOpenException();
+    }
 #endif
 }
 
@@ -97,10 +122,27 @@ SerialPort::~SerialPort()
 		CloseHandle(m_hComm);
 	}
 #else
+	if(m_NonBlocking) {
+		// nobody waits for unsent bytes, and close() would wait for them to drain.
+		tcflush(m_Fd, TCOFLUSH);
+	}
 	close(m_Fd);
 #endif
 }
 
+/*******************************
+ */
+void SerialPort::setNonBlocking(const bool on)
+{
+#ifndef WIN32
+	int flags = fcntl(m_Fd, F_GETFL);
+	if(flags < 0 || fcntl(m_Fd, F_SETFL, on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) < 0) {
+		throw ComAccessException();
+	}
+#endif
+	m_NonBlocking = on;
+}
+
 
 /*******************************
  */
@@ -148,11 +190,12 @@ int SerialPort::getSizeInRxBuffer()
 	struct timeval timeout;
 	int nread;
 	timeout.tv_sec = 0, timeout.tv_usec = 0;
-	fd_set fds, dmy;
+	fd_set fds, wfds, efds;
 	FD_ZERO(&fds);
-	FD_ZERO(&dmy);
+	FD_ZERO(&wfds);
+	FD_ZERO(&efds);
 	FD_SET(m_Fd, &fds);
-	int res = select(FD_SETSIZE, &fds, &dmy, &dmy, &timeout);
+	int res = select(FD_SETSIZE, &fds, &wfds, &efds, &timeout);
 	switch(res) {
 	case 0: //timeout
 		return 0;
@@ -181,6 +224,9 @@ int SerialPort::write(const void* src, const unsigned int size)
 	if(!WriteFile(m_hComm, src, size, &WrittenBytes, NULL)) {
 		throw ComAccessException();
 	}
+	if(m_pTrace) {
+		m_pTrace->record(TRACE_TX, src, WrittenBytes);
+	}
 	/*
 	for(unsigned int i = 0;i < size;i++) {
 		if(!WriteFile(m_hComm, dat+i, 1, &Buf, NULL)) {
@@ -196,12 +242,81 @@ int SerialPort::write(const void* src, const unsigned int size)
 #else
 	int ret;
 	if((ret = ::write(m_Fd, src, size)) < 0) {
-		throw ComAccessException();
+		if(!m_NonBlocking || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+			throw ComAccessException();
+		}
+		ret = 0;
+	}
+	if(m_pTrace) {
+		m_pTrace->record(TRACE_TX, src, ret);
 	}
 	return ret;
 #endif
 }
 
+/*******************************
+ */
+int SerialPort::writev(const IoBuffer* buffers, const int count)
+{
+#ifdef WIN32
+	unsigned char buf[256];
+	unsigned int len = 0;
+	int written = 0;
+	for(int i = 0;i < count;i++) {
+		if(len + buffers[i].size > sizeof(buf)) {
+			written += write(buf, len);
+			len = 0;
+		}
+		if(buffers[i].size > sizeof(buf)) {
+			written += write(buffers[i].data, buffers[i].size);
+			continue;
+		}
+		memcpy(buf + len, buffers[i].data, buffers[i].size);
+		len += buffers[i].size;
+	}
+	if(len > 0) {
+		written += write(buf, len);
+	}
+	return written;
+#else
+	struct iovec iov[IOV_MAX_CHUNKS];
+	int written = 0;
+	for(int i = 0;i < count;i += IOV_MAX_CHUNKS) {
+		int n = count - i < IOV_MAX_CHUNKS ? count - i : IOV_MAX_CHUNKS;
+		for(int j = 0;j < n;j++) {
+			iov[j].iov_base = (void*)buffers[i+j].data;
+			iov[j].iov_len = buffers[i+j].size;
+		}
+		int ret;
+		if((ret = ::writev(m_Fd, iov, n)) < 0) {
+			if(!m_NonBlocking || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+				throw ComAccessException();
+			}
+			ret = 0;
+		}
+		if(m_pTrace) {
+			// one record per chunk, so that packets stay separate in the trace.
+			unsigned int left = ret;
+			for(int j = 0;j < n && left > 0;j++) {
+				unsigned int len = iov[j].iov_len < left ? iov[j].iov_len : left;
+				m_pTrace->record(TRACE_TX, iov[j].iov_base, len);
+				left -= len;
+			}
+		}
+		written += ret;
+		int chunk = 0;
+		for(int j = 0;j < n;j++) {
+			chunk += iov[j].iov_len;
+		}
+		if(ret < chunk) {
+			// Tx buffer is full (non-blocking).
+			break;
+		}
+	}
+	return written;
+#endif
+}
+
 /*******************************
  */
 int SerialPort::read(void *dst, const unsigned int size)
@@ -211,13 +326,118 @@ int SerialPort::read(void *dst, const unsigned int size)
 	if(!ReadFile(m_hComm, dst, size, &ReadBytes, NULL)) {
 		throw ComAccessException();
 	}
+	if(m_pTrace && ReadBytes > 0) {
+		m_pTrace->record(TRACE_RX, dst, ReadBytes);
+	}
 
 	return ReadBytes;
 #else
 	int ret;
 	if((ret = ::read(m_Fd, dst, size))< 0) {
-		throw ComAccessException();
+		if(!m_NonBlocking || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+			throw ComAccessException();
+		}
+		ret = 0;
+	}
+	if(m_pTrace && ret > 0) {
+		m_pTrace->record(TRACE_RX, dst, ret);
 	}
 	return ret;
 #endif
 }
+
+/*******************************
+ */
+bool SerialPort::waitForRxData(const int timeoutMs)
+{
+#ifdef WIN32
+	long deadline = _monotonicMillis() + timeoutMs;
+	while(getSizeInRxBuffer() == 0) {
+		if(timeoutMs >= 0 && _monotonicMillis() >= deadline) {
+			return false;
+		}
+		Sleep(1);
+	}
+	return true;
+#else
+	struct pollfd pfd;
+	pfd.fd = m_Fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	int res;
+	while((res = poll(&pfd, 1, timeoutMs)) < 0) {
+		if(errno != EINTR) {
+			throw ComAccessException();
+		}
+	}
+	if(res == 0) {
+		return false;
+	}
+	if(pfd.revents & (POLLERR | POLLNVAL)) {
+		throw ComAccessException();
+	}
+	return true;
+#endif
+}
+
+/*******************************
+ */
+int SerialPort::readExact(void *dst, const unsigned int size, const int timeoutMs)
+{
+	unsigned char* buf = (unsigned char*)dst;
+	unsigned int received = 0;
+	long deadline = _monotonicMillis() + timeoutMs;
+	while(received < size) {
+		int remain = -1;
+		if(timeoutMs >= 0) {
+			remain = (int)(deadline - _monotonicMillis());
+			if(remain < 0) {
+				remain = 0;
+			}
+		}
+#ifdef WIN32
+		if(remain != m_ReadTimeout) {
+			COMMTIMEOUTS timeouts;
+			memset(&timeouts, 0, sizeof(timeouts));
+			timeouts.ReadTotalTimeoutConstant = remain < 0 ? 0 : remain;
+			if(remain == 0) {
+				timeouts.ReadIntervalTimeout = MAXDWORD;
+			}
+			if(!SetCommTimeouts(m_hComm, &timeouts)) {
+				throw ComAccessException();
+			}
+			m_ReadTimeout = remain;
+		}
+		int ret = read(buf + received, size - received);
+#else
+		if(!waitForRxData(remain)) {
+			throw ComTimeoutException();
+		}
+		int ret = read(buf + received, size - received);
+		if(ret == 0) { // readable but empty means hang up.
+			throw ComAccessException();
+		}
+#endif
+		received += ret;
+		if(received < size && remain == 0) {
+			throw ComTimeoutException();
+		}
+	}
+	return received;
+}
+
+/*******************************
+ */
+int SerialPort::readAvailable(void *dst, const unsigned int maxSize)
+{
+#ifdef WIN32
+	unsigned int size = getSizeInRxBuffer();
+	if(size == 0) {
+		return 0;
+	}
+	return read(dst, size < maxSize ? size : maxSize);
+#else
+	// VMIN = VTIME = 0, so read() returns immediately.
+	return read(dst, maxSize);
+#endif
+}
@@ -0,0 +1,232 @@
+/**
+ * @file SharedRegion.cpp
+ * @brief Targets and angles of one Actroid in shared memory
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <string.h>
+#include <limits>
+
+#include "SharedRegion.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+// waits for a sequence left odd (or a lock held) before the writer is taken as dead.
+#define SHARED_RETRIES 1000
+// longest wait [ms] of a reader for a publication to end.
+#define SHARED_READ_TIMEOUT_MS 10
+
+SharedRegion::SharedRegion(const char* name, const bool create, const int numJoint) throw(ActroidException) :
+  m_Name(memoryName(name)), m_pLayout(NULL), m_Owner(create), m_TargetSequence(0)
+{
+#ifdef WIN32
+  throw ActroidException("Shared memory is not supported on this platform.");
+#else
+  if (create && (numJoint <= 0 || numJoint > SHARED_MAX_JOINT)) {
+    throw ActroidException("Invalid number of joints.");
+  }
+  int fd = shm_open(m_Name.c_str(), create ? (O_RDWR | O_CREAT) : O_RDWR, 0660);
+  if (fd < 0) {
+    throw ActroidException(create ? "Can not create shared memory." : "actroidd is not running.");
+  }
+  if (create && ftruncate(fd, sizeof(SharedLayout)) < 0) {
+    close(fd);
+    shm_unlink(m_Name.c_str());
+    throw ActroidException("Can not create shared memory.");
+  }
+  struct stat st;
+  void* p = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(SharedLayout)) {
+    p = mmap(NULL, sizeof(SharedLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (p == MAP_FAILED) {
+    if (create) {
+      shm_unlink(m_Name.c_str());
+    }
+    throw ActroidException("Can not map shared memory.");
+  }
+  m_pLayout = (SharedLayout*)p;
+
+  if (create) {
+    // a region left by a daemon which crashed is reused.
+    m_pLayout->magic = 0;
+    atomicFence();
+    m_pLayout->version = SHARED_VERSION;
+    m_pLayout->numJoint = numJoint;
+    m_pLayout->pid = (int32_t)getpid();
+    m_pLayout->targetLock = 0;
+    m_pLayout->targetSequence = 0;
+    m_pLayout->currentSequence = 0;
+    m_pLayout->stale = 1;
+    m_pLayout->cycleCount = 0;
+    m_pLayout->time = 0;
+    for (int i = 0;i < SHARED_MAX_JOINT;i++) {
+      m_pLayout->target[i] = std::numeric_limits<double>::quiet_NaN();
+      m_pLayout->current[i] = 0;
+      m_pLayout->age[i] = -1;
+      m_pLayout->variance[i] = 0;
+    }
+    atomicFence();
+    m_pLayout->magic = SHARED_MAGIC;
+  } else if (m_pLayout->magic != SHARED_MAGIC || m_pLayout->version != SHARED_VERSION) {
+    munmap(p, sizeof(SharedLayout));
+    m_pLayout = NULL;
+    throw ActroidException("actroidd is not running or of another version.");
+  }
+#endif
+}
+
+SharedRegion::~SharedRegion()
+{
+#ifndef WIN32
+  if (m_pLayout) {
+    if (m_Owner) {
+      m_pLayout->magic = 0;
+      atomicFence();
+      shm_unlink(m_Name.c_str());
+    }
+    munmap(m_pLayout, sizeof(SharedLayout));
+  }
+#endif
+}
+
+std::string SharedRegion::memoryName(const char* name)
+{
+  return std::string("/") + name;
+}
+
+std::string SharedRegion::socketPath(const char* name)
+{
+  return std::string("/tmp/") + name + ".sock";
+}
+
+bool SharedRegion::isAlive() const
+{
+  atomicFence();
+  return m_pLayout->magic == SHARED_MAGIC;
+}
+
+void SharedRegion::writeTargets(const int offset, const double* angles, const int n)
+{
+  SharedLayout* l = m_pLayout;
+  const long self = (long)getpid();
+  // the lock holds the pid of the writer, so that one killed while
+  // copying does not block the others for ever.
+  for (int tries = 1;;tries++) {
+    long holder = atomicCompareExchange(&l->targetLock, 0, self);
+    if (holder == 0) {
+      break;
+    }
+    if (tries % SHARED_RETRIES == 0 && kill((pid_t)holder, 0) < 0 && errno == ESRCH) {
+      atomicCompareExchange(&l->targetLock, holder, 0);
+    }
+    Thread::sleep(0);
+  }
+  // odd if the last writer was killed: its block is simply written over.
+  long sequence = l->targetSequence | 1;
+  atomicStore(&l->targetSequence, sequence);
+  atomicFence();
+  for (int i = 0;i < n && offset + i < l->numJoint;i++) {
+    if (angles[i] == angles[i]) {
+      l->target[offset + i] = angles[i];
+    }
+  }
+  atomicStore(&l->targetSequence, sequence + 1);
+  atomicStore(&l->targetLock, 0);
+}
+
+bool SharedRegion::readTargets(double* angles)
+{
+  SharedLayout* l = m_pLayout;
+  for (;;) {
+    long sequence = atomicLoad(&l->targetSequence);
+    if (sequence == m_TargetSequence) {
+      return false;
+    }
+    if (sequence & 1) {
+      // taken on the next call rather than waiting for the writer.
+      return false;
+    }
+    memcpy(angles, l->target, sizeof(double) * l->numJoint);
+    atomicFence();
+    if (atomicLoad(&l->targetSequence) == sequence) {
+      m_TargetSequence = sequence;
+      return true;
+    }
+  }
+}
+
+void SharedRegion::publishCurrent(const double* angles, const double* age, const double* variance,
+                                  const bool stale, const long cycleCount)
+{
+  SharedLayout* l = m_pLayout;
+  long sequence = l->currentSequence;
+  atomicStore(&l->currentSequence, sequence + 1);
+  atomicFence();
+  memcpy(l->current, angles, sizeof(double) * l->numJoint);
+  if (age) {
+    memcpy(l->age, age, sizeof(double) * l->numJoint);
+  }
+  if (variance) {
+    memcpy(l->variance, variance, sizeof(double) * l->numJoint);
+  }
+  l->stale = stale ? 1 : 0;
+  l->cycleCount = cycleCount;
+  l->time = monotonicNanos();
+  atomicStore(&l->currentSequence, sequence + 2);
+}
+
+long SharedRegion::readCurrent(double* angles, double* age, double* variance, const int n,
+                               uint64_t& time, bool& stale, long& cycleCount)
+{
+  SharedLayout* l = m_pLayout;
+  const int count = n < l->numJoint ? n : l->numJoint;
+  // copied aside, so that a block which can not be read whole is not handed out.
+  double current[SHARED_MAX_JOINT];
+  double currentAge[SHARED_MAX_JOINT];
+  double currentVariance[SHARED_MAX_JOINT];
+  const uint64_t deadline = monotonicNanos() + SHARED_READ_TIMEOUT_MS * 1000000ULL;
+  for (int tries = 1;;tries++) {
+    long sequence = atomicLoad(&l->currentSequence);
+    if (!(sequence & 1)) {
+      memcpy(current, l->current, sizeof(double) * count);
+      memcpy(currentAge, l->age, sizeof(double) * count);
+      memcpy(currentVariance, l->variance, sizeof(double) * count);
+      bool currentStale = l->stale != 0;
+      long currentCycleCount = l->cycleCount;
+      uint64_t currentTime = l->time;
+      atomicFence();
+      if (atomicLoad(&l->currentSequence) == sequence) {
+        memcpy(angles, current, sizeof(double) * count);
+        if (age) {
+          memcpy(age, currentAge, sizeof(double) * count);
+        }
+        if (variance) {
+          memcpy(variance, currentVariance, sizeof(double) * count);
+        }
+        stale = currentStale;
+        cycleCount = currentCycleCount;
+        time = currentTime;
+        return sequence / 2;
+      }
+    }
+    // the daemon died, or stopped, while publishing.
+    if (tries % SHARED_RETRIES == 0 &&
+        ((kill((pid_t)l->pid, 0) < 0 && errno == ESRCH) || monotonicNanos() >= deadline)) {
+      return 0;
+    }
+    Thread::sleep(0);
+  }
+}
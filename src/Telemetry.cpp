@@ -0,0 +1,98 @@
+/**
+ * @file Telemetry.cpp
+ * @brief Latency histograms and error counters of the control cycle
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include "Telemetry.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+HistogramSnapshot::HistogramSnapshot() : total(0)
+{
+  for (int i = 0;i < HISTOGRAM_BUCKETS;i++) {
+    count[i] = 0;
+  }
+}
+
+uint64_t HistogramSnapshot::getValueAtPercentile(const double percentile) const
+{
+  if (total == 0) {
+    return 0;
+  }
+  long rank = (long)(percentile / 100.0 * total + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+  long sum = 0;
+  for (int i = 0;i < HISTOGRAM_BUCKETS;i++) {
+    sum += count[i];
+    if (sum >= rank) {
+      return LatencyHistogram::bucketValue(i);
+    }
+  }
+  return getMax();
+}
+
+uint64_t HistogramSnapshot::getMax() const
+{
+  for (int i = HISTOGRAM_BUCKETS - 1;i >= 0;i--) {
+    if (count[i] > 0) {
+      return LatencyHistogram::bucketValue(i);
+    }
+  }
+  return 0;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+  for (int i = 0;i < HISTOGRAM_BUCKETS;i++) {
+    m_Count[i] = 0;
+  }
+}
+
+int LatencyHistogram::bucketIndex(const uint64_t value)
+{
+  if (value < HISTOGRAM_LINEAR) {
+    return (int)value;
+  }
+  int msb = 5;
+  while (msb < 63 && (value >> (msb + 1)) != 0) {
+    msb++;
+  }
+  int shift = msb - 4;
+  int index = (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int)((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+  return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::bucketValue(const int index)
+{
+  if (index < HISTOGRAM_LINEAR) {
+    return index;
+  }
+  int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+  uint64_t lower = (uint64_t)(HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) << shift;
+  return lower + ((uint64_t)1 << shift) / 2;
+}
+
+void LatencyHistogram::readInterval(HistogramSnapshot& previous, HistogramSnapshot& interval)
+{
+  interval.total = 0;
+  previous.total = 0;
+  for (int i = 0;i < HISTOGRAM_BUCKETS;i++) {
+    long count = atomicLoad(&m_Count[i]);
+    interval.count[i] = count - previous.count[i];
+    interval.total += interval.count[i];
+    previous.count[i] = count;
+    previous.total += count;
+  }
+}
+
+Telemetry::Telemetry() : m_Enabled(0), m_LastCycle(0)
+{
+  for (int i = 0;i < NUM_COUNTER;i++) {
+    m_Counter[i] = 0;
+  }
+}
@@ -0,0 +1,276 @@
+/********************************************************
+ * Thread.cpp
+ *
+ * Portable Thread Class Library for Windows and Unix.
+ * @date 2026/10/17
+ ********************************************************/
+
+/*************************************************
+ * Header Including Division
+ */
+#ifdef WIN32
+#include <malloc.h>
+#define alloca _alloca
+#else
+
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <alloca.h>
+#include <sys/mman.h>
+
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "Thread.h"
+
+/* Header includeing division
+ ************************************************/
+
+
+using namespace net::ysuga;
+
+#ifdef WIN32
+static DWORD WINAPI _threadEntry(LPVOID arg)
+{
+	((Thread*)arg)->run();
+	return 0;
+}
+#else
+static void* _threadEntry(void* arg)
+{
+	((Thread*)arg)->run();
+	return NULL;
+}
+#endif
+
+/******************************
+ */
+Thread::Thread() : m_Started(false)
+{
+#ifdef WIN32
+	m_hThread = 0;
+#endif
+}
+
+/******************************
+ */
+Thread::~Thread()
+{
+#ifdef WIN32
+	if(m_hThread) {
+		CloseHandle(m_hThread);
+	}
+#endif
+}
+
+/******************************
+ */
+void Thread::start()
+{
+	if(m_Started) {
+		throw ThreadException("Thread already started.");
+	}
+#ifdef WIN32
+	m_hThread = CreateThread(NULL, 0, _threadEntry, this, 0, NULL);
+	if(m_hThread == NULL) {
+		throw ThreadException("CreateThread failed.");
+	}
+#else
+	if(pthread_create(&m_Thread, NULL, _threadEntry, this) != 0) {
+		throw ThreadException("pthread_create failed.");
+	}
+#endif
+	m_Started = true;
+}
+
+/******************************
+ */
+void Thread::join()
+{
+	if(!m_Started) {
+		return;
+	}
+#ifdef WIN32
+	WaitForSingleObject(m_hThread, INFINITE);
+	CloseHandle(m_hThread);
+	m_hThread = 0;
+#else
+	pthread_join(m_Thread, NULL);
+#endif
+	m_Started = false;
+}
+
+/******************************
+ */
+void Thread::sleep(const unsigned long milliSeconds)
+{
+#ifdef WIN32
+	Sleep(milliSeconds);
+#else
+	struct timespec req, rem;
+	req.tv_sec = milliSeconds / 1000;
+	req.tv_nsec = (milliSeconds % 1000) * 1000000;
+	while(nanosleep(&req, &rem) < 0 && errno == EINTR) {
+		req = rem;
+	}
+#endif
+}
+
+/******************************
+ */
+bool Thread::setCurrentPriority(const int priority)
+{
+#ifdef WIN32
+	return SetThreadPriority(GetCurrentThread(),
+		priority > 0 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL) != 0;
+#else
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+	return pthread_setschedparam(pthread_self(), priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) == 0;
+#endif
+}
+
+/******************************
+ */
+bool Thread::setCurrentAffinity(const uint64_t cpuMask)
+{
+#ifdef WIN32
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cpuMask) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(int i = 0;i < 64;i++) {
+		if(cpuMask & ((uint64_t)1 << i)) {
+			CPU_SET(i, &set);
+		}
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+/******************************
+ */
+void Thread::prefaultStack(const unsigned long bytes)
+{
+	volatile char* p = (volatile char*)alloca(bytes);
+	for(unsigned long i = 0;i < bytes;i += 4096) {
+		p[i] = 0;
+	}
+}
+
+/******************************
+ */
+Mutex::Mutex()
+{
+#ifdef WIN32
+	InitializeCriticalSection(&m_Section);
+#else
+	pthread_mutex_init(&m_Mutex, NULL);
+#endif
+}
+
+/******************************
+ */
+Mutex::~Mutex()
+{
+#ifdef WIN32
+	DeleteCriticalSection(&m_Section);
+#else
+	pthread_mutex_destroy(&m_Mutex);
+#endif
+}
+
+/******************************
+ */
+void Mutex::lock()
+{
+#ifdef WIN32
+	EnterCriticalSection(&m_Section);
+#else
+	pthread_mutex_lock(&m_Mutex);
+#endif
+}
+
+/******************************
+ */
+void Mutex::unlock()
+{
+#ifdef WIN32
+	LeaveCriticalSection(&m_Section);
+#else
+	pthread_mutex_unlock(&m_Mutex);
+#endif
+}
+
+/******************************
+ */
+bool net::ysuga::parseCpuList(const char* list, uint64_t& cpuMask)
+{
+	cpuMask = 0;
+	const char* p = list;
+	while(*p) {
+		char* end;
+		long first = strtol(p, &end, 10);
+		if(end == p) {
+			return false;
+		}
+		long last = first;
+		p = end;
+		if(*p == '-') {
+			last = strtol(++p, &end, 10);
+			if(end == p) {
+				return false;
+			}
+			p = end;
+		}
+		if(first < 0 || last < first || last > 63) {
+			return false;
+		}
+		for(long i = first;i <= last;i++) {
+			cpuMask |= (uint64_t)1 << i;
+		}
+		if(*p == ',') {
+			p++;
+		} else if(*p) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/******************************
+ */
+bool net::ysuga::lockMemory()
+{
+#ifdef WIN32
+	return false;
+#else
+	return mlockall(MCL_CURRENT) == 0;
+#endif
+}
+
+/******************************
+ */
+uint64_t net::ysuga::monotonicNanos()
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+	if(freq.QuadPart == 0) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&count);
+	return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000 +
+		(uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
@@ -0,0 +1,129 @@
+/********************************************************
+ * TraceRecorder.cpp
+ *
+ * Binary trace of serial traffic in a memory mapped ring file.
+ * @date 2026/10/17
+ ********************************************************/
+
+/*************************************************
+ * Header Including Division
+ */
+#ifdef WIN32
+#include <string.h>
+#else
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#endif
+
+#include "TraceRecorder.h"
+#include "Thread.h"
+
+/* Header includeing division
+ ************************************************/
+
+
+using namespace net::ysuga;
+
+/******************************
+ */
+TraceRecorder::TraceRecorder(const char* filename, const unsigned int capacity)
+{
+	if(capacity == 0) {
+		throw ComException("Trace capacity must be positive.");
+	}
+	m_MapSize = sizeof(TraceHeader) + (size_t)capacity * sizeof(TraceRecord);
+
+#ifdef WIN32
+	m_hFile = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(m_hFile == INVALID_HANDLE_VALUE) {
+		throw ComException("Can not create trace file.");
+	}
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READWRITE,
+		(DWORD)((uint64_t)m_MapSize >> 32), (DWORD)m_MapSize, NULL);
+	if(m_hMapping == NULL) {
+		CloseHandle(m_hFile);
+		throw ComException("Can not map trace file.");
+	}
+	void* p = MapViewOfFile(m_hMapping, FILE_MAP_WRITE, 0, 0, m_MapSize);
+	if(p == NULL) {
+		CloseHandle(m_hMapping);
+		CloseHandle(m_hFile);
+		throw ComException("Can not map trace file.");
+	}
+#else
+	if((m_Fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+		throw ComException("Can not create trace file.");
+	}
+	// allocate blocks now, so that a full disk is reported here and not by SIGBUS later.
+	int res = posix_fallocate(m_Fd, 0, m_MapSize);
+	if(res == EOPNOTSUPP || res == EINVAL) {
+		// the file system can not allocate in advance: a sparse file has to do.
+		res = ftruncate(m_Fd, m_MapSize) < 0 ? errno : 0;
+	}
+	if(res != 0) {
+		close(m_Fd);
+		throw ComException("Can not allocate trace file.");
+	}
+	void* p = mmap(NULL, m_MapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_Fd, 0);
+	if(p == MAP_FAILED) {
+		close(m_Fd);
+		throw ComException("Can not map trace file.");
+	}
+#endif
+
+	// touch every page now, not on the I/O path.
+	memset(p, 0, m_MapSize);
+	m_pHeader = (TraceHeader*)p;
+	m_pRecord = (TraceRecord*)(m_pHeader + 1);
+	memcpy(m_pHeader->magic, TRACE_MAGIC, sizeof(m_pHeader->magic));
+	m_pHeader->recordSize = sizeof(TraceRecord);
+	m_pHeader->capacity = capacity;
+	m_pHeader->count = 0;
+	m_pHeader->startTime = monotonicNanos();
+}
+
+/******************************
+ */
+TraceRecorder::~TraceRecorder()
+{
+#ifdef WIN32
+	FlushViewOfFile(m_pHeader, 0);
+	UnmapViewOfFile(m_pHeader);
+	CloseHandle(m_hMapping);
+	CloseHandle(m_hFile);
+#else
+	msync(m_pHeader, m_MapSize, MS_ASYNC);
+	munmap(m_pHeader, m_MapSize);
+	close(m_Fd);
+#endif
+}
+
+/*******************************
+ */
+void TraceRecorder::record(const TraceDirection direction, const void* data, const unsigned int size)
+{
+	const uint8_t* src = (const uint8_t*)data;
+	uint64_t time = monotonicNanos();
+	volatile uint64_t* pCount = &m_pHeader->count;
+	uint64_t count = *pCount;
+	for(unsigned int offset = 0;offset < size;offset += TRACE_RECORD_DATA) {
+		unsigned int n = size - offset < TRACE_RECORD_DATA ? size - offset : TRACE_RECORD_DATA;
+		TraceRecord* pRecord = m_pRecord + count % m_pHeader->capacity;
+		pRecord->time = time;
+		pRecord->direction = direction;
+		pRecord->size = n;
+		memcpy(pRecord->data, src + offset, n);
+#ifndef WIN32
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+		*pCount = ++count;
+	}
+}
@@ -0,0 +1,89 @@
+/**
+ * @file WriteScheduler.cpp
+ * @brief Priority lanes for target angle writes
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <string.h>
+
+#include "WriteScheduler.h"
+#include "ReadScheduler.h"
+
+using namespace ogata_lab;
+
+bool WriteScheduler::addLane(const char* name, const int start, const int count, const int deadlineMs)
+{
+  if (start < 0 || count <= 0 || start + count > m_NumJoint || deadlineMs < 0) {
+    return false;
+  }
+  JointLane lane;
+  lane.name = name;
+  lane.start = start;
+  lane.count = count;
+  lane.deadline = deadlineMs;
+  lane.dirty = false;
+  lane.dirtySince = 0;
+  m_Lanes.push_back(lane);
+  return true;
+}
+
+bool WriteScheduler::parse(const std::string& spec)
+{
+  std::vector<JointSpec> entries;
+  if (!parseJointSpec(spec, entries)) {
+    return false;
+  }
+  WriteScheduler scheduler(m_NumJoint);
+  for (std::vector<JointSpec>::const_iterator it = entries.begin();it != entries.end();++it) {
+    if (!scheduler.addLane(it->name.c_str(), it->start, it->count, it->value)) {
+      return false;
+    }
+  }
+  m_Lanes = scheduler.m_Lanes;
+  return true;
+}
+
+bool WriteScheduler::isDue(const uint8_t* target, const uint8_t* written, const uint64_t now)
+{
+  bool due = false;
+  for (std::vector<JointLane>::iterator it = m_Lanes.begin();it != m_Lanes.end();++it) {
+    if (memcmp(target + it->start, written + it->start, it->count) == 0) {
+      it->dirty = false;
+      continue;
+    }
+    if (!it->dirty) {
+      it->dirty = true;
+      it->dirtySince = now;
+    }
+    if (now - it->dirtySince >= (uint64_t)it->deadline * 1000000) {
+      due = true;
+    }
+  }
+  if (!due) {
+    // joints outside lanes are not delayed.
+    for (int i = 0;i < m_NumJoint;i++) {
+      if (target[i] == written[i]) {
+        continue;
+      }
+      bool inLane = false;
+      for (std::vector<JointLane>::const_iterator it = m_Lanes.begin();it != m_Lanes.end();++it) {
+        if (i >= it->start && i < it->start + it->count) {
+          inLane = true;
+          break;
+        }
+      }
+      if (!inLane) {
+        return true;
+      }
+    }
+  }
+  return due;
+}
+
+void WriteScheduler::onWritten()
+{
+  for (std::vector<JointLane>::iterator it = m_Lanes.begin();it != m_Lanes.end();++it) {
+    it->dirty = false;
+  }
+}
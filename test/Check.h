@@ -0,0 +1,25 @@
+/**
+ * @file Check.h
+ * @brief Minimal checks for the test programs
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ *
+ * A failed CHECK prints its location and the test goes on; CHECK_RESULT
+ * is the exit status of main(), non-zero if any check failed.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+static int _checkFailures = 0;
+
+#define CHECK(condition)						\
+  do {									\
+    if (!(condition)) {							\
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      _checkFailures++;							\
+    }									\
+  } while (0)
+
+#define CHECK_RESULT (_checkFailures ? 1 : 0)
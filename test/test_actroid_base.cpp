@@ -0,0 +1,543 @@
+/**
+ * @file test_actroid_base.cpp
+ * @brief Tests of the ActroidBaseT control cycle against ActroidSimulator
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "ActroidBase.h"
+#include "ActroidSimulator.h"
+#include "LoopbackTransport.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+#define N ActroidBase::NUM_JOINT
+#define MS 1000000ULL
+
+/**
+ * Targets [rad] of cycle, different for every joint in every cycle.
+ */
+static void _targets(const int cycle, double* angles)
+{
+  for (int j = 0;j < N;j++) {
+    const double step = (ActroidModel::MaxAngle[j] - ActroidModel::MinAngle[j]) / 10;
+    angles[j] = ActroidModel::MinAngle[j] + step * ((cycle * 7 + j * 3) % 10 + 0.5);
+  }
+}
+
+/**
+ * true if the controller reported the raw targets of actroid for every joint.
+ */
+static bool _reached(ActroidBase& actroid)
+{
+  for (int j = 0;j < N;j++) {
+    if (actroid.getCurrentRawAngle(j) != actroid.getTargetRawAngle(j)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * true if simulator holds the raw targets of actroid for every joint.
+ */
+static bool _accepted(ActroidBase& actroid, const ActroidSimulator& simulator)
+{
+  for (int j = 0;j < N;j++) {
+    if (simulator.getTargetRawAngle(j) != actroid.getTargetRawAngle(j)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * true if joints [start, start+count) report raw, and the others old.
+ */
+static bool _readOnly(ActroidBase& actroid, const int start, const int count,
+                      const uint8_t* raw, const uint8_t* old)
+{
+  for (int j = 0;j < N;j++) {
+    const uint8_t expected = j >= start && j < start + count ? raw[j] : old[j];
+    if (actroid.getCurrentRawAngle(j) != expected) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void testTimeout()
+{
+  // through a pseudo terminal, so that the deadline of SerialPort is the one tested.
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  PtySimulator pty(&simulator);
+  pty.start();
+  ActroidBase actroid(pty.getSlaveName().c_str());
+  actroid.setTimeout(50);
+  actroid.updateAngles();
+
+  // the controller falls silent.
+  pty.stop();
+  const uint64_t start = monotonicNanos();
+  bool timeout = false;
+  try {
+    actroid.updateCurrentAngles();
+  } catch (ActroidTimeoutException&) {
+    timeout = true;
+  }
+  const uint64_t elapsed = monotonicNanos() - start;
+  CHECK(timeout);
+  CHECK(elapsed >= 50 * MS && elapsed < 250 * MS);
+  CHECK(actroid.getTelemetry().getCount(COUNTER_TIMEOUT) == 1);
+
+  // answers the offline packet of the destructor.
+  pty.start();
+}
+
+static void testPipelined()
+{
+  ActroidSimulator serialSimulator;
+  ActroidSimulator pipelinedSimulator;
+  serialSimulator.setBaudrate(0);
+  pipelinedSimulator.setBaudrate(0);
+  LoopbackTransport serialLink(&serialSimulator);
+  LoopbackTransport pipelinedLink(&pipelinedSimulator);
+  ActroidBase serial(&serialLink);
+  ActroidBase pipelined(&pipelinedLink);
+  pipelined.setPipelined(true);
+
+  // the get packet written with the set reads the angles it set.
+  for (int cycle = 0;cycle < 10;cycle++) {
+    double angles[N];
+    _targets(cycle, angles);
+    serial.setTargetAngles(angles, N);
+    pipelined.setTargetAngles(angles, N);
+    serial.updateAngles();
+    pipelined.updateAngles();
+    CHECK(_reached(serial));
+    CHECK(_reached(pipelined));
+    double serialAngles[N];
+    double pipelinedAngles[N];
+    serial.getCurrentAngles(serialAngles, N);
+    pipelined.getCurrentAngles(pipelinedAngles, N);
+    CHECK(memcmp(serialAngles, pipelinedAngles, sizeof(serialAngles)) == 0);
+  }
+  CHECK(pipelinedSimulator.getSetCount() == serialSimulator.getSetCount());
+  CHECK(pipelinedSimulator.getGetCount() == serialSimulator.getGetCount());
+  CHECK(pipelinedSimulator.getSetCount() == 10 && pipelinedSimulator.getGetCount() == 10);
+}
+
+static void testSuppressUnchanged()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  LoopbackTransport link(&simulator);
+  ActroidBase actroid(&link);
+  actroid.setKeepAliveInterval(0);
+  double angles[N];
+  _targets(0, angles);
+  actroid.setTargetAngles(angles, N);
+
+  // targets equal to the acked ones are not sent again.
+  actroid.updateAngles();
+  actroid.updateAngles();
+  actroid.updateAngles();
+  CHECK(simulator.getSetCount() == 1);
+  CHECK(simulator.getGetCount() == 3);
+  CHECK(actroid.getSuppressedFrameCount() == 2);
+
+  _targets(1, angles);
+  actroid.setTargetAngles(angles, N);
+  actroid.updateAngles();
+  CHECK(simulator.getSetCount() == 2);
+  CHECK(_reached(actroid));
+
+  // a controller which forgot them gets them again after the keep-alive interval.
+  actroid.setKeepAliveInterval(30);
+  actroid.updateCurrentAngles();
+  CHECK(simulator.getSetCount() == 2);
+  Thread::sleep(40);
+  actroid.updateCurrentAngles();
+  CHECK(simulator.getSetCount() == 3);
+  actroid.updateCurrentAngles();
+  CHECK(simulator.getSetCount() == 3);
+
+  actroid.setSuppressUnchanged(false);
+  actroid.updateAngles();
+  CHECK(simulator.getSetCount() == 4);
+}
+
+static void testReadSchedule()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  LoopbackTransport link(&simulator);
+  ActroidBase actroid(&link);
+  actroid.setKeepAliveInterval(0);
+  actroid.setReadSchedule("face:0:8:1,arms:8:14:2,torso:22:2:4");
+  double angles[N];
+  uint8_t old[N];
+  uint8_t raw[N];
+
+  // all groups are due in the first cycle.
+  _targets(0, angles);
+  actroid.setTargetAngles(angles, N);
+  actroid.updateAngles();
+  CHECK(_reached(actroid));
+  for (int j = 0;j < N;j++) {
+    old[j] = actroid.getTargetRawAngle(j);
+  }
+
+  // then each cycle reads the range of the groups due, with one get packet.
+  _targets(1, angles);
+  actroid.setTargetAngles(angles, N);
+  actroid.updateTargetAngles();
+  for (int j = 0;j < N;j++) {
+    raw[j] = actroid.getTargetRawAngle(j);
+  }
+  const long gets = simulator.getGetCount();
+  actroid.updateCurrentAngles();
+  CHECK(_readOnly(actroid, 0, 8, raw, old));
+  actroid.updateCurrentAngles();
+  CHECK(_readOnly(actroid, 0, 22, raw, old));
+  actroid.updateCurrentAngles();
+  CHECK(_readOnly(actroid, 0, 22, raw, old));
+  actroid.updateCurrentAngles();
+  CHECK(_reached(actroid));
+  CHECK(simulator.getGetCount() == gets + 4);
+
+  // a group is read on demand, out of the schedule.
+  _targets(2, angles);
+  actroid.setTargetAngles(angles, N);
+  actroid.updateTargetAngles();
+  memcpy(old, raw, N);
+  for (int j = 0;j < N;j++) {
+    raw[j] = actroid.getTargetRawAngle(j);
+  }
+  actroid.updateCurrentAngles("torso");
+  CHECK(_readOnly(actroid, 22, 2, raw, old));
+
+  // an invalid schedule is refused and the groups are kept.
+  bool thrown = false;
+  try {
+    actroid.setReadSchedule("arms:8:20:1");
+  } catch (ActroidException&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  CHECK(actroid.getReadScheduler().getGroups().size() == 3);
+}
+
+static void testWriteLanes()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  LoopbackTransport link(&simulator);
+  ActroidBase actroid(&link);
+  actroid.setKeepAliveInterval(0);
+  actroid.setWriteLanes("face:0:5:0,body:5:19:50");
+  double angles[N];
+  double next[N];
+  _targets(0, angles);
+  _targets(1, next);
+  actroid.setTargetAngles(angles, N);
+  actroid.updateTargetAngles();
+  CHECK(simulator.getSetCount() == 1);
+
+  // a body change waits for the deadline of its lane.
+  actroid.setTargetAngle(10, next[10]);
+  actroid.updateTargetAngles();
+  Thread::sleep(20);
+  actroid.updateTargetAngles();
+  CHECK(simulator.getSetCount() == 1);
+  Thread::sleep(40);
+  actroid.updateTargetAngles();
+  CHECK(simulator.getSetCount() == 2);
+  CHECK(simulator.getTargetRawAngle(10) == actroid.getTargetRawAngle(10));
+
+  // a face change goes out at once, with the body changes waiting.
+  actroid.setTargetAngle(12, next[12]);
+  actroid.updateTargetAngles();
+  CHECK(simulator.getSetCount() == 2);
+  actroid.setTargetAngle(2, next[2]);
+  actroid.updateTargetAngles();
+  CHECK(simulator.getSetCount() == 3);
+  CHECK(simulator.getTargetRawAngle(2) == actroid.getTargetRawAngle(2));
+  CHECK(simulator.getTargetRawAngle(12) == actroid.getTargetRawAngle(12));
+
+  // so the body lane is clean again.
+  Thread::sleep(60);
+  actroid.updateTargetAngles();
+  CHECK(simulator.getSetCount() == 3);
+}
+
+static void testNewestTargets()
+{
+  // at the baud rate of the controller, targets come faster than the link takes them.
+  ActroidSimulator simulator;
+  simulator.setBaudrate(ActroidModel::BAUDRATE);
+  LoopbackTransport link(&simulator);
+  ActroidBase actroid(&link);
+  actroid.setKeepAliveInterval(0);
+  actroid.startIoThread();
+  double angles[N];
+  for (int i = 0;i < 100;i++) {
+    _targets(i, angles);
+    actroid.setTargetAngles(angles, N);
+    actroid.updateTargetAngles();
+  }
+
+  // samples are not queued: the newest reaches the controller first.
+  const uint64_t deadline = monotonicNanos() + 1000 * MS;
+  do {
+    Thread::sleep(1);
+    actroid.updateCurrentAngles();
+  } while (!_reached(actroid) && monotonicNanos() < deadline);
+  CHECK(_reached(actroid));
+  actroid.stopIoThread();
+  CHECK(simulator.getSetCount() < 10);
+}
+
+static void testEstimatedAge()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  LoopbackTransport link(&simulator);
+  ActroidBase actroid(&link);
+  actroid.setReadSchedule("face:0:8:1,body:8:16:1000");
+  double angles[N];
+  double age[N];
+  actroid.getEstimatedAngles(angles, age, NULL, N);
+  CHECK(age[0] == -1 && age[N-1] == -1);
+
+  // each joint is as old as its own last read.
+  actroid.updateCurrentAngles();
+  Thread::sleep(30);
+  actroid.updateCurrentAngles();
+  actroid.getEstimatedAngles(angles, age, NULL, N);
+  CHECK(age[0] >= 0 && age[0] < 0.02);
+  CHECK(age[N-1] >= 0.03 && age[N-1] < 1.0);
+  actroid.getCurrentAngles(angles, N);
+  double estimated[N];
+  actroid.getEstimatedAngles(estimated, NULL, NULL, N);
+  // joints at rest are estimated where they were read.
+  CHECK(fabs(estimated[0] - angles[0]) < 1e-9 && fabs(estimated[N-1] - angles[N-1]) < 1e-9);
+}
+
+static void testNackRetry()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  simulator.setSeed(7);
+  LoopbackTransport link(&simulator);
+  ActroidBase actroid(&link);
+  simulator.setNackRate(0.3);
+
+  // rejected packets are sent again, pipelined or not.
+  actroid.setNackRetries(20);
+  for (int cycle = 0;cycle < 50;cycle++) {
+    double angles[N];
+    _targets(cycle, angles);
+    actroid.setTargetAngles(angles, N);
+    actroid.setPipelined(cycle % 2 == 0);
+    actroid.updateAngles();
+    CHECK(_accepted(actroid, simulator));
+  }
+  CHECK(simulator.getNackCount() > 0);
+  CHECK(actroid.getTelemetry().getCount(COUNTER_NACK) == simulator.getNackCount());
+
+  // without retries the first NACK is an error.
+  actroid.setNackRetries(0);
+  simulator.setNackRate(1.0);
+  bool nack = false;
+  try {
+    actroid.updateCurrentAngles();
+  } catch (ActroidNackException&) {
+    nack = true;
+  }
+  CHECK(nack);
+  simulator.setNackRate(0);
+}
+
+static void testReconnect()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  simulator.setSeed(3);
+  LoopbackTransport link(&simulator);
+  ActroidBase actroid(&link);
+  actroid.setTimeout(20);
+  actroid.setReconnectBackoff(10, 40);
+
+  // the thread goes on through NACKs beyond the retries.
+  simulator.setNackRate(0.2);
+  actroid.startIoThread();
+  Thread::sleep(200);
+  for (int i = 0;i < 10;i++) {
+    actroid.updateCurrentAngles();
+  }
+  actroid.stopIoThread();
+  CHECK(actroid.getTelemetry().getCount(COUNTER_RECONNECT) > 0);
+  CHECK(actroid.getIoCycleCount() > actroid.getTelemetry().getCount(COUNTER_RECONNECT));
+
+  // a silent controller is retried after 10, 20, 40, 40... ms, each attempt
+  // waiting 20 ms for the ack of its online packet.
+  simulator.setNackRate(0);
+  simulator.setDropRate(1.0);
+  const long drops = simulator.getDropCount();
+  actroid.startIoThread();
+  Thread::sleep(300);
+  CHECK(actroid.isStale());
+  bool thrown = false;
+  try {
+    actroid.updateCurrentAngles();
+  } catch (ActroidException&) {
+    thrown = true;
+  }
+  CHECK(!thrown);
+  actroid.stopIoThread();
+  // the get which timed out, then one online packet per attempt: about 6 attempts
+  // where a fixed backoff of 10 ms would take 10.
+  const long attempts = simulator.getDropCount() - drops - 1;
+  CHECK(attempts >= 4 && attempts <= 8);
+
+  // answers the offline packet of the destructor.
+  simulator.setDropRate(0);
+}
+
+static void testSession()
+{
+  ActroidSimulator first;
+  ActroidSimulator second;
+  first.setBaudrate(0);
+  second.setBaudrate(0);
+  PtySimulator firstPty(&first);
+  PtySimulator secondPty(&second);
+  firstPty.start();
+  secondPty.start();
+  ActroidBase actroid(firstPty.getSlaveName().c_str());
+  double angles[N];
+  _targets(0, angles);
+  actroid.setTargetAngles(angles, N);
+  actroid.updateAngles();
+  CHECK(_reached(actroid));
+
+  // the layout is changed while the I/O thread is stopped, on the same port.
+  actroid.startIoThread();
+  bool thrown = false;
+  try {
+    actroid.setReadSchedule("face:0:8:1");
+  } catch (ActroidException&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  CHECK(actroid.getReadScheduler().getGroups().empty());
+  actroid.stopIoThread();
+  actroid.setCommandWindow(2);
+  actroid.setTimeout(100);
+  _targets(1, angles);
+  actroid.setTargetAngles(angles, N);
+  actroid.startIoThread();
+  actroid.updateTargetAngles();
+  const uint64_t deadline = monotonicNanos() + 1000 * MS;
+  do {
+    Thread::sleep(1);
+    actroid.updateCurrentAngles();
+  } while (!_reached(actroid) && monotonicNanos() < deadline);
+  CHECK(_reached(actroid));
+  actroid.stopIoThread();
+  CHECK(actroid.getPortName() == firstPty.getSlaveName());
+
+  // another port gets the targets when it is opened.
+  actroid.reopen(secondPty.getSlaveName().c_str());
+  secondPty.stop();
+  CHECK(second.isOnline());
+  CHECK(_accepted(actroid, second));
+  secondPty.start();
+  actroid.updateAngles();
+  CHECK(_reached(actroid));
+
+  // a port which can not be opened leaves the link down until another is.
+  thrown = false;
+  try {
+    actroid.reopen("/dev/actroid_test_none");
+  } catch (ActroidException&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  CHECK(!actroid.isConnected());
+  thrown = false;
+  try {
+    actroid.updateAngles();
+  } catch (ActroidException&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  actroid.reopen(secondPty.getSlaveName().c_str());
+  CHECK(actroid.isConnected());
+  actroid.updateAngles();
+  CHECK(_reached(actroid));
+}
+
+static void testCalibration()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  LoopbackTransport link(&simulator);
+  ActroidBase actroid(&link);
+  actroid.updateAngles();
+  const uint8_t target = actroid.getTargetRawAngle(8);
+  const uint8_t current = actroid.getCurrentRawAngle(8);
+
+  // raw targets are kept, so the joint does not move; its angles are converted anew.
+  actroid.setCalibration("8:-1.0:1.0");
+  CHECK(actroid.getTargetRawAngle(8) == target);
+  CHECK(fabs(actroid.getCurrentAngle(8) - (current * 2.0 / 255.0 - 1.0)) < 1e-9);
+  actroid.setTargetAngle(8, 1.0);
+  CHECK(actroid.getTargetRawAngle(8) < 255);
+  actroid.setTargetAngle(8, 0.0);
+  actroid.updateAngles();
+  CHECK(_reached(actroid));
+  CHECK(fabs(actroid.getCurrentAngle(8)) < 2.0 / 255.0);
+
+  bool thrown = false;
+  try {
+    actroid.setCalibration("8:1.0:-1.0");
+  } catch (ActroidException&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  CHECK(fabs(actroid.getCurrentAngle(8)) < 2.0 / 255.0);
+
+  // an empty spec restores the limits of the model.
+  actroid.setCalibration("");
+  const double step = (ActroidModel::MaxAngle[8] - ActroidModel::MinAngle[8]) / 255.0;
+  CHECK(fabs(actroid.getCurrentAngle(8) - (actroid.getCurrentRawAngle(8) * step + ActroidModel::MinAngle[8])) < 1e-9);
+}
+
+int main()
+{
+  try {
+    testTimeout();
+    testPipelined();
+    testSuppressUnchanged();
+    testReadSchedule();
+    testWriteLanes();
+    testNewestTargets();
+    testEstimatedAge();
+    testNackRetry();
+    testReconnect();
+    testSession();
+    testCalibration();
+  } catch (ActroidException& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return CHECK_RESULT;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file test_c_api.c
+ * @brief Test of the C interface (ActroidC.h) on the simulator in process
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ *
+ * Written in C, so that the header is checked by a C compiler too.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "ActroidC.h"
+#include "Check.h"
+
+#define MAX_JOINT 64
+
+/* one step of the raw angle of joints 8 and 9 is below 1 degree. */
+#define TOLERANCE 0.02
+
+static void testErrors(void)
+{
+  char error[128];
+  actroid_t* actroid;
+  double angles[MAX_JOINT];
+
+  error[0] = 0;
+  CHECK(actroid_open(NULL, error, sizeof(error)) == NULL);
+  CHECK(strlen(error) > 0);
+  error[0] = 0;
+  CHECK(actroid_open("/nonexistent/tty", error, sizeof(error)) == NULL);
+  CHECK(strlen(error) > 0);
+
+  actroid = actroid_open_simulator(error, sizeof(error));
+  CHECK(actroid != NULL);
+  if (!actroid) {
+    return;
+  }
+  CHECK(actroid_get_current_angles(actroid, angles, actroid_num_joint() + 1) == -1);
+  CHECK(strlen(actroid_error(actroid)) > 0);
+  CHECK(actroid_set_target_angle(actroid, -1, 0.0) == -1);
+  CHECK(actroid_set_trajectory(actroid, NULL, NULL, 0, 0) == -1);
+  actroid_close(actroid);
+}
+
+static void testCycle(const int ioThread)
+{
+  char error[128];
+  actroid_t* actroid;
+  double angles[MAX_JOINT];
+  int n = actroid_num_joint();
+  int i;
+  time_t deadline;
+
+  CHECK(n > 9 && n <= MAX_JOINT);
+  actroid = actroid_open_simulator(error, sizeof(error));
+  CHECK(actroid != NULL);
+  if (!actroid) {
+    return;
+  }
+  CHECK(actroid_set_timeout(actroid, 200) == 0);
+  if (ioThread) {
+    CHECK(actroid_start_io_thread(actroid) == 0);
+  }
+  CHECK(actroid_set_target_angle(actroid, 8, 0.4) == 0);
+  CHECK(actroid_set_target_angle(actroid, 9, -0.1) == 0);
+  /* with the I/O thread, angles of a later cycle are handed over. */
+  deadline = time(NULL) + 5;
+  for (i = 0;i < 3 || (fabs(angles[8] - 0.4) > TOLERANCE && time(NULL) < deadline);i++) {
+    CHECK(actroid_update_angles(actroid) == 0);
+    CHECK(actroid_get_current_angles(actroid, angles, n) == 0);
+  }
+  CHECK(fabs(angles[8] - 0.4) < TOLERANCE);
+  CHECK(fabs(angles[9] + 0.1) < TOLERANCE);
+  CHECK(actroid_is_stale(actroid) == 0);
+  if (ioThread) {
+    CHECK(actroid_stop_io_thread(actroid) == 0);
+    /* counted after the angles of a cycle are handed over. */
+    CHECK(actroid_io_cycle_count(actroid) > 0);
+  }
+  actroid_close(actroid);
+}
+
+int main(void)
+{
+  testErrors();
+  testCycle(0);
+  testCycle(1);
+  return CHECK_RESULT;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file test_calibration.cpp
+ * @brief Tests of JointCalibration against the original conversions
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include "JointCalibration.h"
+#include "ActroidModel.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+
+#define N ActroidModel::NUM_JOINT
+
+/**
+ * setTargetAngle() of the original ActroidBase.
+ */
+static uint8_t _toRaw(const int index, double angle)
+{
+  const double* max = ActroidModel::MaxAngle;
+  const double* min = ActroidModel::MinAngle;
+  const double* margin = ActroidModel::AngleMargin;
+  if (angle >= (max[index] - margin[index])) {
+    angle = max[index] - margin[index];
+  } else if (angle <= (min[index] + margin[index])) {
+    angle = min[index] + margin[index];
+  }
+  uint8_t raw = (angle) * 255.0/(max[index]-min[index]) - (min[index] * 255.0 / (max[index]-min[index]));
+  return raw;
+}
+
+/**
+ * getCurrentAngle() of the original ActroidBase.
+ */
+static double _toAngle(const int index, const uint8_t raw)
+{
+  const double* max = ActroidModel::MaxAngle;
+  const double* min = ActroidModel::MinAngle;
+  return (raw * (max[index]-min[index]))/255.0 + min[index];
+}
+
+static JointCalibration<N> _calibration(ActroidModel::MinAngle, ActroidModel::MaxAngle, ActroidModel::AngleMargin);
+
+static void testToAngle()
+{
+  for (int j = 0;j < N;j++) {
+    int mismatch = 0;
+    for (int raw = 0;raw < RAW_ANGLE_RANGE;raw++) {
+      if (_calibration.toAngle(j, (uint8_t)raw) != _toAngle(j, (uint8_t)raw)) {
+        mismatch++;
+      }
+    }
+    CHECK(mismatch == 0);
+  }
+}
+
+static void testToRaw()
+{
+  double angle[N];
+  uint8_t raw[N];
+  for (int j = 0;j < N;j++) {
+    // the default pose is commanded as it was.
+    CHECK(_calibration.toRaw(j, ActroidModel::DefaultAngle[j]) == _toRaw(j, ActroidModel::DefaultAngle[j]));
+
+    // exact raw angles (as echoed back from currentJoint), points between
+    // them, and angles beyond the limits.
+    const double step = (ActroidModel::MaxAngle[j] - ActroidModel::MinAngle[j]) / 255.0;
+    int mismatch = 0;
+    for (int r = -4;r < RAW_ANGLE_RANGE + 4;r++) {
+      for (int k = 0;k < 4;k++) {
+        const double a = _toAngle(j, 0) + r * step + k * step / 4;
+        if (_calibration.toRaw(j, a) != _toRaw(j, a)) {
+          mismatch++;
+        }
+      }
+      if (r >= 0 && r < RAW_ANGLE_RANGE) {
+        const double a = _toAngle(j, (uint8_t)r);
+        if (_calibration.toRaw(j, a) != _toRaw(j, a)) {
+          mismatch++;
+        }
+      }
+    }
+    CHECK(mismatch == 0);
+    angle[j] = ActroidModel::DefaultAngle[j];
+  }
+
+  // the batch conversion gives the same values.
+  _calibration.toRaw(angle, raw, N);
+  for (int j = 0;j < N;j++) {
+    CHECK(raw[j] == _toRaw(j, angle[j]));
+  }
+}
+
+int main()
+{
+  testToAngle();
+  testToRaw();
+  return CHECK_RESULT;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file test_client.cpp
+ * @brief Tests of ActroidClient and SharedRegion against a fake actroidd
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ActroidClient.h"
+#include "Thread.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+#define MS 1000000ULL
+
+static std::string _readLine(const int fd)
+{
+  std::string line;
+  char c;
+  while (read(fd, &c, 1) == 1 && c != '\n') {
+    line += c;
+  }
+  return line;
+}
+
+static bool _writeLine(const int fd, const std::string& line)
+{
+  std::string packet = line + "\n";
+  return send(fd, packet.c_str(), packet.size(), MSG_NOSIGNAL) == (ssize_t)packet.size();
+}
+
+/**
+ * Daemon which answers the first request too late, on the same
+ * connection, and echoes the request of the next connection.
+ */
+class SlowDaemon : public Thread {
+private:
+  int m_Listen;
+  unsigned long m_Delay;
+
+public:
+  SlowDaemon(const int listenFd, const unsigned long delayMs) : m_Listen(listenFd), m_Delay(delayMs) {}
+
+  virtual void run() {
+    int first = accept(m_Listen, NULL, NULL);
+    _readLine(first);
+    Thread::sleep(m_Delay);
+    // the client may have closed it already.
+    _writeLine(first, "ok late");
+    int second = accept(m_Listen, NULL, NULL);
+    CHECK(_writeLine(second, "ok " + _readLine(second)));
+    close(second);
+    close(first);
+  }
+};
+
+static void testNotRunning(const char* name)
+{
+  ActroidClient client(name);
+  bool thrown = false;
+  try {
+    client.request("status");
+  } catch (ActroidTimeoutException&) {
+  } catch (ActroidException&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+static void testTimeout(const char* name)
+{
+  std::string path = SharedRegion::socketPath(name);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str());
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK(bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) == 0 && listen(listenFd, 4) == 0);
+
+  SlowDaemon daemon(listenFd, 300);
+  daemon.start();
+
+  ActroidClient client(name);
+  client.setTimeout(50);
+  uint64_t start = monotonicNanos();
+  bool timeout = false;
+  try {
+    client.request("status");
+  } catch (ActroidTimeoutException&) {
+    timeout = true;
+  }
+  uint64_t elapsed = monotonicNanos() - start;
+  CHECK(timeout);
+  CHECK(elapsed >= 50 * MS && elapsed < 250 * MS);
+
+  // the late reply of the dropped connection is not the reply of this one.
+  client.setTimeout(2000);
+  std::string reply;
+  try {
+    reply = client.request("echo");
+  } catch (ActroidException&) {
+  }
+  CHECK(reply == "echo");
+
+  daemon.join();
+  close(listenFd);
+  unlink(path.c_str());
+}
+
+static void testStoppedWhilePublishing(const char* name, SharedRegion& daemon)
+{
+  double angles[4] = {0.1, 0.2, 0.3, 0.4};
+  daemon.publishCurrent(angles, NULL, NULL, false, 1);
+
+  int fd = shm_open(SharedRegion::memoryName(name).c_str(), O_RDWR, 0);
+  CHECK(fd >= 0);
+  SharedLayout* layout = (SharedLayout*)mmap(NULL, sizeof(SharedLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  CHECK(layout != MAP_FAILED);
+
+  SharedRegion client(name, false);
+  double read[4] = {0};
+  uint64_t time;
+  bool stale;
+  long cycleCount;
+  CHECK(client.readCurrent(read, NULL, NULL, 4, time, stale, cycleCount) > 0);
+  CHECK(read[3] == 0.4);
+
+  // a publication which never ends, with the joints half written.
+  layout->currentSequence++;
+  layout->current[0] = 1.0;
+  double left[4] = {-1, -1, -1, -1};
+  uint64_t start = monotonicNanos();
+  CHECK(client.readCurrent(left, NULL, NULL, 4, time, stale, cycleCount) == 0);
+  CHECK(monotonicNanos() - start < 200 * MS);
+  CHECK(left[0] == -1 && left[3] == -1);
+
+  layout->currentSequence++;
+  munmap(layout, sizeof(SharedLayout));
+}
+
+int main()
+{
+  char name[64];
+  snprintf(name, sizeof(name), "test_client_%d", (int)getpid());
+  SharedRegion region(name, true, 4);
+  testNotRunning(name);
+  testTimeout(name);
+  testStoppedWhilePublishing(name, region);
+  return CHECK_RESULT;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file test_command_queue.cpp
+ * @brief Tests of CommandQueue: window, reply matching and deadlines
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <string.h>
+#include <vector>
+
+#include "CommandQueue.h"
+#include "ActroidModel.h"
+#include "Thread.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+static const uint8_t ACK = ActroidModel::ACK;
+static const uint8_t NACK = ActroidModel::NACK;
+
+/**
+ * Transport whose replies are pushed by the test.
+ */
+class ScriptedTransport : public Transport {
+private:
+  std::vector<uint8_t> m_Rx;
+
+public:
+  int packets;
+  int bytes;
+  int room;   ///< bytes the next writes take, as a non-blocking port (-1: all)
+
+  ScriptedTransport() : packets(0), bytes(0), room(-1) {}
+
+  void push(const uint8_t* data, const int size) {
+    m_Rx.insert(m_Rx.end(), data, data + size);
+  }
+
+  virtual void flushRxBuffer() {
+    m_Rx.clear();
+  }
+
+  virtual int write(const void* /*src*/, const unsigned int size) {
+    int taken = room >= 0 && room < (int)size ? room : (int)size;
+    if (room >= 0) {
+      room -= taken;
+    }
+    packets++;
+    bytes += taken;
+    return taken;
+  }
+
+  virtual int writev(const IoBuffer* buffers, const int count) {
+    int total = 0;
+    for (int i = 0;i < count;i++) {
+      int taken = write(buffers[i].data, buffers[i].size);
+      total += taken;
+      if (taken < (int)buffers[i].size) {
+        break;
+      }
+    }
+    return total;
+  }
+
+  virtual bool waitForRxData(const int timeoutMs) {
+    if (m_Rx.empty() && timeoutMs > 0) {
+      Thread::sleep(timeoutMs);
+    }
+    return !m_Rx.empty();
+  }
+
+  virtual int readExact(void* dst, const unsigned int size, const int /*timeoutMs*/) {
+    if (readAvailable(dst, size) != (int)size) {
+      throw ComTimeoutException();
+    }
+    return size;
+  }
+
+  virtual int readAvailable(void* dst, const unsigned int maxSize) {
+    int size = m_Rx.size() < maxSize ? (int)m_Rx.size() : (int)maxSize;
+    if (size > 0) {
+      memcpy(dst, &m_Rx[0], size);
+      m_Rx.erase(m_Rx.begin(), m_Rx.begin() + size);
+    }
+    return size;
+  }
+};
+
+static const uint8_t _get[] = {ActroidModel::START, ActroidModel::GET, 0, 2, ActroidModel::STOP};
+
+static void _onComplete(const Command* command, void* userData)
+{
+  *(CommandStatus*)userData = command->getStatus();
+}
+
+static void testWindow()
+{
+  ScriptedTransport transport;
+  CommandQueue queue(&transport, 2);
+  Command* c1 = queue.submit(_get, sizeof(_get), 3);
+  Command* c2 = queue.submit(_get, sizeof(_get), 3);
+  Command* c3 = queue.submit(_get, sizeof(_get), 3);
+  CHECK(c1 && c2 && c3);
+  queue.flush();
+  // only the window is written; the rest waits for a slot.
+  CHECK(transport.packets == 2);
+  CHECK(queue.getInFlightCount() == 2);
+  CHECK(c1->getStatus() == COMMAND_SENT);
+  CHECK(c3->getStatus() == COMMAND_QUEUED);
+
+  // replies complete commands in the order they were sent.
+  const uint8_t replies[] = {ACK, 2, 10, 20, NACK};
+  transport.push(replies, sizeof(replies));
+  queue.poll();
+  CHECK(c1->getStatus() == COMMAND_DONE);
+  CHECK(c1->getReply()[1] == 10 && c1->getReply()[2] == 20);
+  CHECK(c2->getStatus() == COMMAND_NACK);
+  CHECK(queue.getNackCount() == 1);
+  CHECK(transport.packets == 3);
+  CHECK(c3->getStatus() == COMMAND_SENT);
+
+  // a reply cut in two completes once the rest arrives.
+  const uint8_t head[] = {0x33, ACK, 2};
+  const uint8_t tail[] = {30, 40};
+  transport.push(head, sizeof(head));
+  queue.poll();
+  CHECK(c3->getStatus() == COMMAND_ACKED);
+  transport.push(tail, sizeof(tail));
+  queue.poll();
+  CHECK(c3->getStatus() == COMMAND_DONE);
+  CHECK(queue.getResyncCount() == 1);
+  CHECK(queue.getCount() == 0);
+
+  queue.release(c1);
+  queue.release(c2);
+  queue.release(c3);
+  CHECK(c1->getStatus() == COMMAND_FREE);
+}
+
+static void testTimeout()
+{
+  ScriptedTransport transport;
+  CommandQueue queue(&transport, 2);
+  queue.setTimeout(20);
+  Command* c1 = queue.submit(_get, sizeof(_get), 3);
+  Command* c2 = queue.submit(_get, sizeof(_get), 3);
+  CHECK(queue.wait(c2, 1000));
+  CHECK(c1->getStatus() == COMMAND_TIMEOUT);
+  CHECK(c2->getStatus() == COMMAND_TIMEOUT);
+  CHECK(queue.getTimeoutCount() == 2);
+  CHECK(queue.getInFlightCount() == 0);
+
+  // a late reply is not taken for the reply of a later command.
+  const uint8_t late[] = {ACK, 2, 10, 20};
+  transport.push(late, sizeof(late));
+  queue.poll();
+  CHECK(queue.getFrameErrorCount() == 1);
+  // the rest of it, read later, is the same error.
+  transport.push(late, sizeof(late));
+  queue.poll();
+  CHECK(queue.getFrameErrorCount() == 1);
+  queue.release(c1);
+  queue.release(c2);
+
+  // a reply broken on the line is lost, not timed out.
+  Command* c3 = queue.submit(_get, sizeof(_get), 3);
+  const uint8_t broken[] = {ACK, 2};
+  queue.flush();
+  transport.push(broken, sizeof(broken));
+  CHECK(queue.wait(c3, 1000));
+  CHECK(c3->getStatus() == COMMAND_LOST);
+  CHECK(queue.getTimeoutCount() == 2);
+  queue.release(c3);
+
+  // wait() gives up at its own timeout and leaves the command in flight.
+  queue.setTimeout(1000);
+  Command* c4 = queue.submit(_get, sizeof(_get), 3);
+  CHECK(!queue.wait(c4, 10));
+  CHECK(c4->getStatus() == COMMAND_SENT);
+  queue.clear();
+  CHECK(c4->getStatus() == COMMAND_ABORTED);
+  queue.release(c4);
+}
+
+static void testCallback()
+{
+  ScriptedTransport transport;
+  CommandQueue queue(&transport, 1);
+  CommandStatus status = COMMAND_FREE;
+  Command* c1 = queue.submit(_get, sizeof(_get), 0, _onComplete, &status);
+  queue.flush();
+  const uint8_t ack[] = {ACK};
+  transport.push(ack, sizeof(ack));
+  queue.poll();
+  CHECK(status == COMMAND_DONE);
+  // commands with a callback are freed after it.
+  CHECK(c1->getStatus() == COMMAND_FREE);
+}
+
+static void testPartialWrite()
+{
+  ScriptedTransport transport;
+  CommandQueue queue(&transport, 2);
+  queue.setTimeout(20);
+  Command* c1 = queue.submit(_get, sizeof(_get), 3);
+  Command* c2 = queue.submit(_get, sizeof(_get), 3);
+
+  // a command is in flight once all of its bytes are written.
+  transport.room = 3;
+  queue.flush();
+  CHECK(queue.getInFlightCount() == 0);
+  CHECK(queue.hasUnsent());
+  transport.room = 4;
+  queue.flush();
+  CHECK(transport.bytes == 7);
+  CHECK(c1->getStatus() == COMMAND_SENT);
+  CHECK(c2->getStatus() == COMMAND_QUEUED);
+  transport.room = -1;
+  queue.flush();
+  CHECK(transport.bytes == 2 * (int)sizeof(_get));
+  CHECK(c2->getStatus() == COMMAND_SENT);
+  CHECK(!queue.hasUnsent());
+  queue.clear();
+  queue.release(c1);
+  queue.release(c2);
+
+  // a port which takes nothing for the timeout fails.
+  queue.submit(_get, sizeof(_get), 3);
+  transport.room = 0;
+  queue.flush();
+  Thread::sleep(30);
+  bool thrown = false;
+  try {
+    queue.flush();
+  } catch (ComTimeoutException&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  queue.clear();
+}
+
+int main()
+{
+  testWindow();
+  testTimeout();
+  testCallback();
+  testPartialWrite();
+  return CHECK_RESULT;
+}
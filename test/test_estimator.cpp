@@ -0,0 +1,91 @@
+/**
+ * @file test_estimator.cpp
+ * @brief Tests of JointEstimator: extrapolation, horizon, target and age
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <math.h>
+
+#include "JointEstimator.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+
+#define MS 1000000ULL
+
+static bool _near(const double a, const double b, const double tolerance)
+{
+  return fabs(a - b) < tolerance;
+}
+
+static void testRamp()
+{
+  JointEstimator<2> estimator;
+  const double target[2] = {10.0, 10.0};
+  double angles[2];
+  double age[2];
+  double variance[2];
+
+  estimator.estimate(target, 1000 * MS, angles, age, variance, 2);
+  CHECK(age[0] == -1 && age[1] == -1);
+
+  // joint 0 moves at 1 rad/s, measured every 10 ms; joint 1 stands still.
+  const uint64_t start = 1000 * MS;
+  uint64_t t = start;
+  for (int i = 0;i < 100;i++) {
+    t = start + i * 10 * MS;
+    estimator.measure(0, (t - start) * 1e-9, t);
+    estimator.measure(1, 0.5, t);
+  }
+  CHECK(estimator.getTime(0) == t);
+
+  // between measurements the angle goes on with the velocity.
+  estimator.estimate(target, t + 20 * MS, angles, age, variance, 2);
+  CHECK(_near(angles[0], (t + 20 * MS - start) * 1e-9, 1e-3));
+  CHECK(_near(angles[1], 0.5, 1e-9));
+  CHECK(_near(age[0], 0.02, 1e-9));
+  CHECK(variance[0] < 1e-6 && variance[1] == 0);
+
+  // for the horizon only.
+  estimator.setHorizon(0.05);
+  estimator.estimate(target, t + 500 * MS, angles, age, variance, 2);
+  CHECK(_near(angles[0], (t + 50 * MS - start) * 1e-9, 1e-3));
+  CHECK(_near(age[0], 0.5, 1e-9));
+
+  // and not past the target the joint is moving to.
+  const double near[2] = {(t - start) * 1e-9 + 0.01, 0.5};
+  estimator.estimate(near, t + 40 * MS, angles, NULL, NULL, 2);
+  CHECK(angles[0] == near[0]);
+
+  // measurements out of order are ignored.
+  estimator.measure(0, 100.0, t - 5 * MS);
+  CHECK(estimator.getTime(0) == t);
+}
+
+static void testVariance()
+{
+  JointEstimator<1> estimator;
+  const double target[1] = {0.0};
+  double angle;
+  double variance;
+  const uint64_t start = 1000 * MS;
+  for (int i = 0;i < 10;i++) {
+    estimator.measure(0, 0.0, start + i * 10 * MS);
+  }
+  estimator.estimate(target, start + 90 * MS, &angle, NULL, &variance, 1);
+  CHECK(variance == 0);
+
+  // a measurement off the prediction raises the variance.
+  estimator.measure(0, 0.4, start + 100 * MS);
+  estimator.estimate(target, start + 100 * MS, &angle, NULL, &variance, 1);
+  CHECK(_near(variance, 0.4 * 0.4 / 16, 1e-12));
+  CHECK(_near(angle, 0.2, 1e-12));
+}
+
+int main()
+{
+  testRamp();
+  testVariance();
+  return CHECK_RESULT;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file test_reactor.cpp
+ * @brief Tests of ActroidReactor driving several controllers
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include "ActroidBase.h"
+#include "ActroidReactor.h"
+#include "ActroidSimulator.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+#define MS 1000000ULL
+
+static void testFaultedClient()
+{
+  // pseudo terminals, so that the reactor waits on descriptors as with the robots.
+  ActroidSimulator healthySimulator;
+  ActroidSimulator faultedSimulator;
+  healthySimulator.setBaudrate(0);
+  faultedSimulator.setBaudrate(0);
+  PtySimulator healthyPty(&healthySimulator);
+  PtySimulator faultedPty(&faultedSimulator);
+  healthyPty.start();
+  faultedPty.start();
+  ActroidBase healthy(healthyPty.getSlaveName().c_str());
+  ActroidBase faulted(faultedPty.getSlaveName().c_str());
+  healthy.setTimeout(200);
+  faulted.setTimeout(200);
+  faulted.setReconnectBackoff(10, 40);
+
+  ActroidReactor reactor;
+  healthy.startIoThread(&reactor);
+  faulted.startIoThread(&reactor);
+  CHECK(reactor.getClientCount() == 2);
+
+  // the faulted controller falls silent: its timeouts and reconnects
+  // must not hold up the cycles of the healthy one.
+  faultedPty.stop();
+  uint64_t last = monotonicNanos();
+  long cycles = healthy.getIoCycleCount();
+  uint64_t longest = 0;
+  const uint64_t end = last + 600 * MS;
+  while (monotonicNanos() < end) {
+    Thread::sleep(1);
+    const long count = healthy.getIoCycleCount();
+    const uint64_t now = monotonicNanos();
+    if (count != cycles) {
+      if (now - last > longest) {
+        longest = now - last;
+      }
+      cycles = count;
+      last = now;
+    }
+  }
+  if (monotonicNanos() - last > longest) {
+    longest = monotonicNanos() - last;
+  }
+  CHECK(longest < 50 * MS);
+  CHECK(faulted.isStale());
+  CHECK(!healthy.isStale());
+  healthy.updateCurrentAngles();
+  faulted.updateCurrentAngles();
+
+  healthy.stopIoThread();
+  faulted.stopIoThread();
+  CHECK(reactor.getClientCount() == 0);
+  CHECK(faulted.getTelemetry().getCount(COUNTER_TIMEOUT) > 0);
+  CHECK(healthy.getTelemetry().getCount(COUNTER_TIMEOUT) == 0);
+
+  // answers the offline packet of the destructor.
+  faultedPty.start();
+}
+
+int main()
+{
+  try {
+    testFaultedClient();
+  } catch (ActroidException& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return CHECK_RESULT;
+}
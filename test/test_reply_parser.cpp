@@ -0,0 +1,103 @@
+/**
+ * @file test_reply_parser.cpp
+ * @brief Tests of ReplyParser: resynchronization, split and NACK replies
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include "ReplyParser.h"
+#include "ActroidModel.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+
+static const uint8_t ACK = ActroidModel::ACK;
+static const uint8_t NACK = ActroidModel::NACK;
+
+static void testGarbageBeforeAck()
+{
+  ReplyParser parser;
+  uint8_t reply[3];
+  const uint8_t data[] = {0x42, 0x99, 0x00, ACK, 2, 10, 20};
+  parser.expect(3, reply);
+  CHECK(parser.parse(data, sizeof(data)) == (int)sizeof(data));
+  CHECK(parser.getStatus() == REPLY_DONE);
+  CHECK(reply[0] == 2 && reply[1] == 10 && reply[2] == 20);
+  // one run of stray bytes is one resync.
+  CHECK(parser.getResyncCount() == 1);
+}
+
+static void testDuplicatedAck()
+{
+  ReplyParser parser;
+  uint8_t reply[3];
+  const uint8_t data[] = {ACK, ACK, 2, 10, 20};
+  parser.expect(3, reply);
+  parser.parse(data, sizeof(data));
+  CHECK(parser.getStatus() == REPLY_DONE);
+  CHECK(reply[0] == 2 && reply[1] == 10 && reply[2] == 20);
+  CHECK(parser.getResyncCount() == 1);
+}
+
+static void testSplitReply()
+{
+  ReplyParser parser;
+  uint8_t reply[4];
+  const uint8_t data[] = {0x77, ACK, 3, 10, 20, 30};
+  parser.expect(4, reply);
+  CHECK(!parser.isStarted());
+  CHECK(parser.getNeeded() == 5);
+  for (int i = 0;i < (int)sizeof(data);i++) {
+    CHECK(parser.getStatus() == REPLY_PENDING);
+    CHECK(parser.parse(data + i, 1) == 1);
+  }
+  CHECK(parser.isStarted());
+  CHECK(parser.getStatus() == REPLY_DONE);
+  CHECK(reply[0] == 3 && reply[1] == 10 && reply[2] == 20 && reply[3] == 30);
+  CHECK(parser.getResyncCount() == 1);
+
+  // a reply cut in the data is pending and asks only for the rest.
+  const uint8_t head[] = {ACK, 3, 10};
+  parser.expect(4, reply);
+  parser.parse(head, sizeof(head));
+  CHECK(parser.getStatus() == REPLY_PENDING);
+  CHECK(parser.isAcked());
+  CHECK(parser.getNeeded() == 2);
+}
+
+static void testNack()
+{
+  ReplyParser parser;
+  uint8_t reply[3];
+  const uint8_t data[] = {0x00, NACK, ACK, 2, 10, 20};
+  parser.expect(3, reply);
+  // the bytes after the NACK belong to the next reply and are left.
+  CHECK(parser.parse(data, sizeof(data)) == 2);
+  CHECK(parser.getStatus() == REPLY_NACK);
+  CHECK(!parser.isAcked());
+
+  parser.expect(3, reply);
+  CHECK(parser.parse(data + 2, sizeof(data) - 2) == 4);
+  CHECK(parser.getStatus() == REPLY_DONE);
+}
+
+static void testAckOnly()
+{
+  ReplyParser parser;
+  const uint8_t data[] = {ACK, ACK, 2};
+  parser.expect(0, NULL);
+  CHECK(parser.getNeeded() == 1);
+  CHECK(parser.parse(data, sizeof(data)) == 1);
+  CHECK(parser.getStatus() == REPLY_DONE);
+  CHECK(parser.getNeeded() == 0);
+}
+
+int main()
+{
+  testGarbageBeforeAck();
+  testDuplicatedAck();
+  testSplitReply();
+  testNack();
+  testAckOnly();
+  return CHECK_RESULT;
+}
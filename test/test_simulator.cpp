@@ -0,0 +1,184 @@
+/**
+ * @file test_simulator.cpp
+ * @brief Tests of ActroidSimulator: protocol, link timing and faults
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+
+#include "ActroidSimulator.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+
+#define N ActroidSimulator::NUM_JOINT
+#define MS 1000000ULL
+
+static const uint8_t _online[] = {ActroidModel::START, ActroidModel::ONLINE, ActroidModel::STOP};
+
+static int _setPacket(const uint8_t* angles, uint8_t* packet)
+{
+  uint8_t sum = ActroidModel::SET2;
+  packet[0] = ActroidModel::START;
+  packet[1] = ActroidModel::SET;
+  packet[2] = ActroidModel::SET2;
+  for (int i = 0;i < N;i++) {
+    packet[3 + i] = angles[i];
+    sum += angles[i];
+  }
+  packet[N + 3] = (uint8_t)-sum;
+  packet[N + 4] = ActroidModel::STOP;
+  return N + 5;
+}
+
+static void testProtocol()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  uint8_t reply[N + 2];
+  simulator.input(_online, sizeof(_online), 0);
+  CHECK(simulator.output(reply, sizeof(reply), 0) == 1 && reply[0] == ActroidModel::ACK);
+  CHECK(simulator.isOnline());
+
+  uint8_t angles[N];
+  uint8_t packet[N + 5];
+  for (int i = 0;i < N;i++) {
+    angles[i] = (uint8_t)(10 + i);
+  }
+  simulator.input(packet, _setPacket(angles, packet), 0);
+  CHECK(simulator.output(reply, sizeof(reply), 0) == 1 && reply[0] == ActroidModel::ACK);
+  CHECK(simulator.getSetCount() == 1);
+
+  const uint8_t get[] = {ActroidModel::START, ActroidModel::GET, 2, 3, ActroidModel::STOP};
+  simulator.input(get, sizeof(get), 0);
+  CHECK(simulator.output(reply, sizeof(reply), 0) == 5);
+  CHECK(reply[0] == ActroidModel::ACK && reply[1] == 3);
+  CHECK(reply[2] == 12 && reply[3] == 13 && reply[4] == 14);
+
+  // a bad checksum is refused and the targets are kept.
+  _setPacket(angles, packet);
+  packet[3] ^= 1;
+  simulator.input(packet, N + 5, 0);
+  CHECK(simulator.output(reply, sizeof(reply), 0) == 1 && reply[0] == ActroidModel::NACK);
+  CHECK(simulator.getTargetRawAngle(0) == 10);
+
+  // stray bytes are skipped until a start byte.
+  const long errors = simulator.getFrameErrorCount();
+  const uint8_t stray[] = {0x00, 0x42};
+  simulator.input(stray, sizeof(stray), 0);
+  simulator.input(get, sizeof(get), 0);
+  CHECK(simulator.getFrameErrorCount() == errors + 2);
+  CHECK(simulator.output(reply, sizeof(reply), 0) == 5);
+}
+
+static void testLink()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(10000);   // 1 ms per byte
+  uint8_t reply[4];
+  const uint64_t start = 1000 * MS;
+  simulator.input(_online, sizeof(_online), start);
+  // the request takes 3 ms to arrive and the ack 1 ms more.
+  CHECK(simulator.getNextOutputTime() == start + 4 * MS);
+  CHECK(simulator.output(reply, sizeof(reply), start + 4 * MS - 1) == 0);
+  CHECK(simulator.output(reply, sizeof(reply), start + 4 * MS) == 1);
+  CHECK(simulator.getNextOutputTime() == 0);
+}
+
+static void testFaults()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  uint8_t reply[4];
+  simulator.setNackRate(1.0);
+  simulator.input(_online, sizeof(_online), 0);
+  CHECK(simulator.output(reply, sizeof(reply), 0) == 1 && reply[0] == ActroidModel::NACK);
+  CHECK(simulator.getNackCount() == 1);
+  CHECK(!simulator.isOnline());
+
+  simulator.setNackRate(0.0);
+  simulator.setDropRate(1.0);
+  simulator.input(_online, sizeof(_online), 0);
+  CHECK(simulator.output(reply, sizeof(reply), 0) == 0);
+  CHECK(simulator.getDropCount() == 1);
+
+  simulator.setDropRate(0.0);
+  simulator.setCorruptRate(1.0);
+  simulator.input(_online, sizeof(_online), 0);
+  CHECK(simulator.output(reply, sizeof(reply), 0) == 1 && reply[0] != ActroidModel::ACK);
+  CHECK(simulator.getCorruptCount() == 1);
+}
+
+static void testServo()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  simulator.setServoLag(10.0);
+  uint8_t angles[N];
+  uint8_t packet[N + 5];
+  uint8_t reply[2];
+  const uint64_t start = 1000 * MS;
+  const uint8_t initial = simulator.getRawAngle(0, start);
+  for (int i = 0;i < N;i++) {
+    angles[i] = initial > 128 ? 0 : 255;
+  }
+  simulator.input(packet, _setPacket(angles, packet), start);
+  simulator.output(reply, sizeof(reply), start);
+  // one time constant later, the joint has moved about 63% of the way.
+  const double moved = ((double)simulator.getRawAngle(0, start + 10 * MS) - initial) / ((double)angles[0] - initial);
+  CHECK(moved > 0.55 && moved < 0.70);
+  CHECK(simulator.getRawAngle(0, start + 1000 * MS) == angles[0]);
+}
+
+static void testPty()
+{
+  ActroidSimulator simulator;
+  simulator.setBaudrate(0);
+  // a reply due more than one second later still comes.
+  simulator.setLatency(1100000);
+  PtySimulator pty(&simulator);
+  pty.start();
+  int fd = open(pty.getSlaveName().c_str(), O_RDWR | O_NOCTTY);
+  CHECK(fd >= 0);
+  const uint64_t start = net::ysuga::monotonicNanos();
+  CHECK(write(fd, _online, sizeof(_online)) == (ssize_t)sizeof(_online));
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(fd, &fds);
+  struct timeval timeout;
+  timeout.tv_sec = 3;
+  timeout.tv_usec = 0;
+  uint8_t reply = 0;
+  CHECK(select(fd + 1, &fds, NULL, NULL, &timeout) == 1 && read(fd, &reply, 1) == 1);
+  CHECK(reply == ActroidModel::ACK);
+  CHECK(net::ysuga::monotonicNanos() - start >= 1100 * MS);
+  close(fd);
+  pty.stop();
+
+  // stop() does not wait for a reply due much later.
+  ActroidSimulator slow;
+  slow.setBaudrate(0);
+  slow.setLatency(5000000);
+  PtySimulator slowPty(&slow);
+  slowPty.start();
+  fd = open(slowPty.getSlaveName().c_str(), O_RDWR | O_NOCTTY);
+  CHECK(write(fd, _online, sizeof(_online)) == (ssize_t)sizeof(_online));
+  net::ysuga::Thread::sleep(50);
+  const uint64_t stop = net::ysuga::monotonicNanos();
+  slowPty.stop();
+  CHECK(net::ysuga::monotonicNanos() - stop < 500 * MS);
+  close(fd);
+}
+
+int main()
+{
+  testProtocol();
+  testLink();
+  testFaults();
+  testServo();
+  testPty();
+  return CHECK_RESULT;
+}
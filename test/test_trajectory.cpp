@@ -0,0 +1,158 @@
+/**
+ * @file test_trajectory.cpp
+ * @brief Tests of TrajectoryPlayer and ActroidBaseT::setTrajectory()
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ */
+
+#include <math.h>
+#include <limits>
+
+#include "Trajectory.h"
+#include "ActroidBase.h"
+#include "LoopbackTransport.h"
+#include "Check.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+#define NUM 2
+#define SECOND 1000000000ULL
+
+static bool _near(const double a, const double b)
+{
+  return fabs(a - b) < 1e-9;
+}
+
+static void _frame(TrajectoryFrame<NUM>& frame, const Interpolation interpolation)
+{
+  frame.id = 1;
+  frame.count = 2;
+  frame.interpolation = interpolation;
+  frame.time[0] = 1.0;
+  frame.time[1] = 2.0;
+  frame.angle[0][0] = 1.0;
+  frame.angle[0][1] = -1.0;
+  frame.angle[1][0] = 3.0;
+  frame.angle[1][1] = -1.0;
+}
+
+static void testLinear()
+{
+  TrajectoryFrame<NUM> frame;
+  _frame(frame, INTERPOLATION_LINEAR);
+  const double origin[NUM] = {0.0, 0.0};
+  const uint64_t start = 100 * SECOND;
+  double angles[NUM];
+  TrajectoryPlayer<NUM> player;
+  player.start(&frame, origin, start);
+  CHECK(player.isActive() && player.getId() == 1);
+
+  // starts from the angles commanded at start().
+  CHECK(player.evaluate(start, angles));
+  CHECK(_near(angles[0], 0.0) && _near(angles[1], 0.0));
+  CHECK(player.evaluate(start + SECOND / 2, angles));
+  CHECK(_near(angles[0], 0.5) && _near(angles[1], -0.5));
+  CHECK(player.evaluate(start + SECOND, angles));
+  CHECK(_near(angles[0], 1.0) && _near(angles[1], -1.0));
+  CHECK(player.evaluate(start + SECOND * 3 / 2, angles));
+  CHECK(_near(angles[0], 2.0));
+
+  // the last waypoint is reached and held.
+  CHECK(!player.evaluate(start + 2 * SECOND, angles));
+  CHECK(_near(angles[0], 3.0) && _near(angles[1], -1.0));
+  CHECK(!player.evaluate(start + 10 * SECOND, angles));
+  CHECK(_near(angles[0], 3.0) && _near(angles[1], -1.0));
+  CHECK(_near(player.getLastAngles()[0], 3.0));
+}
+
+static void testCubic()
+{
+  TrajectoryFrame<NUM> frame;
+  _frame(frame, INTERPOLATION_CUBIC);
+  const double origin[NUM] = {0.0, 0.0};
+  const uint64_t start = 100 * SECOND;
+  double angles[NUM];
+  TrajectoryPlayer<NUM> player;
+  player.start(&frame, origin, start);
+
+  CHECK(player.evaluate(start, angles));
+  CHECK(_near(angles[0], 0.0));
+  // at rest on the first waypoint: the first millisecond moves by O(t^2).
+  CHECK(player.evaluate(start + SECOND / 1000, angles));
+  CHECK(fabs(angles[0]) < 1e-4);
+  // waypoints are passed exactly.
+  CHECK(player.evaluate(start + SECOND, angles));
+  CHECK(_near(angles[0], 1.0) && _near(angles[1], -1.0));
+  // at rest on the last one.
+  CHECK(player.evaluate(start + 2 * SECOND - SECOND / 1000, angles));
+  CHECK(fabs(angles[0] - 3.0) < 1e-4);
+  CHECK(!player.evaluate(start + 2 * SECOND, angles));
+  CHECK(_near(angles[0], 3.0) && _near(angles[1], -1.0));
+
+  player.stop();
+  CHECK(!player.isActive() && player.getId() == 0);
+}
+
+static void testSetTrajectory()
+{
+  const int N = ActroidBase::NUM_JOINT;
+  ActroidSimulator simulator;
+  LoopbackTransport loopback(&simulator);
+  ActroidBase actroid(&loopback);
+
+  double time[2] = {0.01, 0.02};
+  double angles[2 * N];
+  for (int j = 0;j < N;j++) {
+    angles[j] = angles[N + j] = (ActroidModel::MinAngle[j] + ActroidModel::MaxAngle[j]) / 2;
+  }
+
+  // invalid trajectories are refused.
+  double late[2] = {0.02, 0.01};
+  bool thrown = false;
+  try { actroid.setTrajectory(late, angles, 2, INTERPOLATION_LINEAR); } catch (ActroidException&) { thrown = true; }
+  CHECK(thrown);
+  thrown = false;
+  try { actroid.setTrajectory(time, angles, 0, INTERPOLATION_LINEAR); } catch (ActroidException&) { thrown = true; }
+  CHECK(thrown);
+  angles[N] = std::numeric_limits<double>::quiet_NaN();
+  thrown = false;
+  try { actroid.setTrajectory(time, angles, 2, INTERPOLATION_LINEAR); } catch (ActroidException&) { thrown = true; }
+  CHECK(thrown);
+  angles[N] = std::numeric_limits<double>::infinity();
+  thrown = false;
+  try { actroid.setTrajectory(time, angles, 2, INTERPOLATION_LINEAR); } catch (ActroidException&) { thrown = true; }
+  CHECK(thrown);
+  angles[N] = angles[0];
+  double infinite[2] = {0.01, std::numeric_limits<double>::infinity()};
+  thrown = false;
+  try { actroid.setTrajectory(infinite, angles, 2, INTERPOLATION_LINEAR); } catch (ActroidException&) { thrown = true; }
+  CHECK(thrown);
+
+  // after the last waypoint its angles stay the target.
+  actroid.setTrajectory(time, angles, 2, INTERPOLATION_CUBIC);
+  actroid.updateAngles();
+  Thread::sleep(30);
+  actroid.updateAngles();
+  actroid.updateAngles();
+  double current[N];
+  actroid.getCurrentAngles(current, N);
+  for (int j = 0;j < N;j++) {
+    // one step of the raw angle.
+    const double step = (ActroidModel::MaxAngle[j] - ActroidModel::MinAngle[j]) / 255 + 1e-9;
+    CHECK(fabs(current[j] - angles[N + j]) <= fabs(step));
+  }
+}
+
+int main()
+{
+  testLinear();
+  testCubic();
+  try {
+    testSetTrajectory();
+  } catch (ActroidException& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return CHECK_RESULT;
+}
@@ -0,0 +1,380 @@
+/**
+ * @file actroid_bench.cpp
+ * @brief Benchmarks of the Actroid control cycle
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ *
+ * Each benchmark repeats one step of the control cycle and prints one JSON
+ * object per line to stdout: throughput, p50/p99/p999 latency per
+ * operation and heap allocations per operation. Lines can be diffed
+ * between releases.
+ *
+ *   set_packet      build, write and ack one set packet (_writeRawAngle)
+ *   get_parse       write one get packet and parse its reply (_readRawAngle)
+ *   set_angle       setTargetAngle() for all joints
+ *   get_angle       getCurrentAngle() for all joints
+ *   set_angles      setTargetAngles() batch conversion
+ *   get_angles      getCurrentAngles() batch conversion
+ *   estimate        getEstimatedAngles() for all joints
+ *   loopback_cycle  pipelined set/get round-trip to ActroidSimulator in process
+ *   io_cycle        updateAngles() until the I/O thread completes a cycle (loopback)
+ *   window_cycle    io_cycle with a command window of 4
+ *   trajectory_cycle io_cycle while a trajectory is interpolated
+ *   pty_cycle       pipelined set/get round-trip to ActroidSimulator on a pty (-p)
+ *
+ * set_packet and get_parse use a transport which answers from memory, so
+ * they measure the host side of the protocol only.
+ *
+ * Allocations are counted in every thread, so the I/O thread is covered
+ * by the io_ benchmarks. The control cycle must not allocate in steady
+ * state: the exit status is 2 if any benchmark does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+#include "ActroidBase.h"
+#include "LoopbackTransport.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+static volatile long _allocCount = 0;
+
+// operator new below is malloc, so releasing with free is correct.
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+  atomicAdd(&_allocCount, 1);
+  void* p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+  free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+  free(p);
+}
+
+/**
+ * Transport which acks every packet and answers get packets from memory.
+ */
+class CannedTransport : public Transport {
+private:
+  uint8_t m_Buffer[256];
+  int m_Head;
+  int m_Tail;
+
+  void _push(const uint8_t data) {
+    if (m_Tail < (int)sizeof(m_Buffer)) {
+      m_Buffer[m_Tail++] = data;
+    }
+  }
+
+  void _answer(const uint8_t* packet, const int size) {
+    if (size < 2 || packet[0] != ActroidModel::START) {
+      return;
+    }
+    _push(ActroidModel::ACK);
+    if (packet[1] == ActroidModel::GET && size >= 4) {
+      _push(packet[3]);
+      for (int i = 0;i < packet[3];i++) {
+	_push(ActroidModel::DefaultRawAngle[(packet[2] + i) % ActroidModel::NUM_JOINT]);
+      }
+    }
+  }
+
+public:
+  CannedTransport() : m_Head(0), m_Tail(0) {}
+
+  virtual void flushRxBuffer() {
+    m_Head = m_Tail = 0;
+  }
+
+  virtual int write(const void* src, const unsigned int size) {
+    _answer((const uint8_t*)src, size);
+    return size;
+  }
+
+  virtual int writev(const IoBuffer* buffers, const int count) {
+    int total = 0;
+    for (int i = 0;i < count;i++) {
+      _answer((const uint8_t*)buffers[i].data, buffers[i].size);
+      total += buffers[i].size;
+    }
+    return total;
+  }
+
+  virtual bool waitForRxData(const int /*timeoutMs*/) {
+    return m_Head < m_Tail;
+  }
+
+  virtual int readExact(void *dst, const unsigned int size, const int /*timeoutMs*/) {
+    if (readAvailable(dst, size) != (int)size) {
+      throw ComTimeoutException();
+    }
+    return size;
+  }
+
+  virtual int readAvailable(void *dst, const unsigned int maxSize) {
+    int size = m_Tail - m_Head;
+    if (size > (int)maxSize) {
+      size = maxSize;
+    }
+    memcpy(dst, m_Buffer + m_Head, size);
+    m_Head += size;
+    if (m_Head == m_Tail) {
+      m_Head = m_Tail = 0;
+    }
+    return size;
+  }
+};
+
+enum Step {
+  SET_PACKET,
+  GET_PARSE,
+  SET_ANGLE,
+  GET_ANGLE,
+  SET_ANGLES,
+  GET_ANGLES,
+  ESTIMATE,
+  CYCLE,
+  IO_CYCLE
+};
+
+static bool _allocated = false;
+
+static double _angles[ActroidBase::NUM_JOINT];
+
+static void _step(ActroidBase* pActroid, const Step step, const int i)
+{
+  switch (step) {
+  case SET_PACKET:
+    pActroid->updateTargetAngles();
+    break;
+  case GET_PARSE:
+    pActroid->updateCurrentAngles(0, ActroidBase::NUM_JOINT);
+    break;
+  case SET_ANGLE:
+    for (int j = 0;j < ActroidBase::NUM_JOINT;j++) {
+      pActroid->setTargetAngle(j, _angles[j]);
+    }
+    break;
+  case GET_ANGLE:
+    for (int j = 0;j < ActroidBase::NUM_JOINT;j++) {
+      _angles[j] = pActroid->getCurrentAngle(j);
+    }
+    break;
+  case SET_ANGLES:
+    pActroid->setTargetAngles(_angles, ActroidBase::NUM_JOINT);
+    break;
+  case GET_ANGLES:
+    pActroid->getCurrentAngles(_angles, ActroidBase::NUM_JOINT);
+    break;
+  case ESTIMATE:
+    pActroid->getEstimatedAngles(_angles, NULL, NULL, ActroidBase::NUM_JOINT);
+    break;
+  case CYCLE:
+    // change one joint every cycle so that set packets are not suppressed.
+    pActroid->setTargetAngle(ActroidBase::NUM_JOINT - 1, (i & 1) * 0.1);
+    pActroid->updateAngles();
+    break;
+  case IO_CYCLE: {
+    long cycle = pActroid->getIoCycleCount();
+    pActroid->setTargetAngle(ActroidBase::NUM_JOINT - 1, (i & 1) * 0.1);
+    pActroid->updateAngles();
+    while (pActroid->getIoCycleCount() == cycle) {
+      // give the I/O thread the CPU on single core machines.
+      Thread::sleep(0);
+    }
+    break;
+  }
+  }
+}
+
+/**
+ * Run step iterations times after a warm-up, and print one result line.
+ * Fast steps are timed in batches of 'batch' operations.
+ */
+static void _run(const char* name, ActroidBase* pActroid, const Step step,
+		 const int iterations, const int batch)
+{
+  const int samples = iterations / batch;
+  std::vector<uint64_t> latency(samples);
+  for (int i = 0;i < samples / 10;i++) {
+    _step(pActroid, step, i);
+  }
+
+  long allocs = atomicLoad(&_allocCount);
+  uint64_t start = monotonicNanos();
+  for (int i = 0;i < samples;i++) {
+    uint64_t t = monotonicNanos();
+    for (int j = 0;j < batch;j++) {
+      _step(pActroid, step, i * batch + j);
+    }
+    latency[i] = monotonicNanos() - t;
+  }
+  uint64_t elapsed = monotonicNanos() - start;
+  allocs = atomicLoad(&_allocCount) - allocs;
+
+  std::sort(latency.begin(), latency.end());
+  const int ops = samples * batch;
+  printf("{\"name\": \"%s\", \"iterations\": %d, \"ops_per_sec\": %.1f, "
+	 "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f, \"allocs_per_op\": %.4f}\n",
+	 name, ops, ops * 1e9 / elapsed,
+	 (double)latency[samples * 50 / 100] / batch,
+	 (double)latency[samples * 99 / 100] / batch,
+	 (double)latency[samples * 999 / 1000] / batch,
+	 (double)allocs / ops);
+  fflush(stdout);
+  if (allocs > 0) {
+    fprintf(stderr, "%s: %ld allocations in steady state\n", name, allocs);
+    _allocated = true;
+  }
+}
+
+static bool _selected(const char* filter, const char* name)
+{
+  return filter == NULL || strstr(name, filter) != NULL;
+}
+
+static void _usage(const char* name)
+{
+  fprintf(stderr,
+	  "usage: %s [-n iterations] [-f filter] [-p] [-b baud] [-r priority] [-c cpus] [-l]\n"
+	  "  -n  iterations of each benchmark (100000)\n"
+	  "  -f  run only benchmarks whose name contains filter\n"
+	  "  -p  also run pty_cycle (needs a pseudo terminal)\n"
+	  "  -b  baud rate of the simulated link for cycle benchmarks (0: no delay)\n"
+	  "  -r  SCHED_FIFO priority of the I/O thread in io_ benchmarks\n"
+	  "  -c  CPUs of the I/O thread in io_ benchmarks, e.g. 1 or 0-1\n"
+	  "  -l  lock memory (mlockall) when the I/O thread starts\n",
+	  name);
+}
+
+int main(int argc, char** argv)
+{
+  int iterations = 100000;
+  const char* filter = NULL;
+  bool pty = false;
+  int baudrate = 0;
+  int priority = 0;
+  const char* cpus = "";
+  bool lock = false;
+  for (int i = 1;i < argc;i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baudrate = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      priority = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      cpus = argv[++i];
+    } else if (strcmp(argv[i], "-l") == 0) {
+      lock = true;
+    } else if (strcmp(argv[i], "-p") == 0) {
+      pty = true;
+    } else {
+      _usage(argv[0]);
+      return 1;
+    }
+  }
+  if (iterations < 1000) {
+    iterations = 1000;
+  }
+  for (int j = 0;j < ActroidBase::NUM_JOINT;j++) {
+    _angles[j] = 0.1 * j;
+  }
+
+  try {
+    CannedTransport canned;
+    ActroidBase actroid(&canned);
+    actroid.setSuppressUnchanged(false);
+    actroid.setKeepAliveInterval(0);
+    if (_selected(filter, "set_packet")) _run("set_packet", &actroid, SET_PACKET, iterations, 1);
+    if (_selected(filter, "get_parse")) _run("get_parse", &actroid, GET_PARSE, iterations, 1);
+    if (_selected(filter, "set_angle")) _run("set_angle", &actroid, SET_ANGLE, iterations, 64);
+    if (_selected(filter, "get_angle")) _run("get_angle", &actroid, GET_ANGLE, iterations, 64);
+    if (_selected(filter, "set_angles")) _run("set_angles", &actroid, SET_ANGLES, iterations, 64);
+    if (_selected(filter, "get_angles")) _run("get_angles", &actroid, GET_ANGLES, iterations, 64);
+    if (_selected(filter, "estimate")) _run("estimate", &actroid, ESTIMATE, iterations, 64);
+
+    if (_selected(filter, "loopback_cycle")) {
+      ActroidSimulator simulator;
+      simulator.setBaudrate(baudrate);
+      LoopbackTransport loopback(&simulator);
+      ActroidBase sim(&loopback);
+      sim.setPipelined(true);
+      _run("loopback_cycle", &sim, CYCLE, baudrate ? iterations / 1000 + 1000 : iterations, 1);
+    }
+
+    const char* ioNames[] = {"io_cycle", "window_cycle", "trajectory_cycle"};
+    for (int k = 0;k < 3;k++) {
+      if (!_selected(filter, ioNames[k])) {
+	continue;
+      }
+      ActroidSimulator simulator;
+      simulator.setBaudrate(baudrate);
+      LoopbackTransport loopback(&simulator);
+      ActroidBase sim(&loopback);
+      sim.setPipelined(true);
+      sim.setCommandWindow(k == 1 ? 4 : 0);
+      sim.setIoThreadPriority(priority);
+      sim.setIoThreadAffinity(cpus);
+      sim.setLockMemory(lock);
+      if (k == 2) {
+	// long enough to outlast the benchmark.
+	double time[2] = {1000.0, 2000.0};
+	double angles[2 * ActroidBase::NUM_JOINT];
+	sim.getCurrentAngles(angles, ActroidBase::NUM_JOINT);
+	sim.getCurrentAngles(angles + ActroidBase::NUM_JOINT, ActroidBase::NUM_JOINT);
+	angles[0] += 0.5;
+	sim.setTrajectory(time, angles, 2, INTERPOLATION_CUBIC);
+      }
+      sim.startIoThread();
+      _run(ioNames[k], &sim, IO_CYCLE, baudrate ? iterations / 1000 + 1000 : iterations / 10, 1);
+      sim.stopIoThread();
+    }
+
+    if (pty && _selected(filter, "pty_cycle")) {
+      ActroidSimulator simulator;
+      simulator.setBaudrate(baudrate);
+      PtySimulator server(&simulator);
+      server.start();
+      {
+	ActroidBase sim(server.getSlaveName().c_str());
+	sim.setPipelined(true);
+	_run("pty_cycle", &sim, CYCLE, baudrate ? iterations / 1000 + 1000 : iterations / 10, 1);
+      }
+      server.stop();
+    }
+  } catch (ActroidException& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  } catch (ComException& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return _allocated ? 2 : 0;
+}
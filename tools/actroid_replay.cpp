@@ -0,0 +1,412 @@
+/**
+ * @file actroid_replay.cpp
+ * @brief Replay a serial trace through ActroidBase
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ *
+ * Reads a trace recorded by ActroidBase::startTrace() (trace_file of the
+ * RTC), and issues the recorded set and get packets again with an
+ * ActroidBase whose transport answers with the recorded controller bytes.
+ * Packets are issued one at a time in recorded order, at the recorded time
+ * or, with -f, as fast as possible. Packets which ActroidBase builds
+ * differently from the recording are counted as tx_mismatch.
+ *
+ * The result is printed as one JSON object, in the format of actroid_bench.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+#include "ActroidBase.h"
+#include "TraceRecorder.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+struct RxByte {
+  uint64_t time;
+  uint8_t data;
+};
+
+struct Packet {
+  uint64_t time;
+  std::vector<uint8_t> data;
+};
+
+static void _sleepUntil(const uint64_t time)
+{
+  uint64_t now = monotonicNanos();
+  if (time <= now) {
+    return;
+  }
+#ifdef WIN32
+  Sleep((DWORD)((time - now + 999999) / 1000000));
+#else
+  struct timespec ts;
+  ts.tv_sec = (time - now) / 1000000000;
+  ts.tv_nsec = (time - now) % 1000000000;
+  while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+  }
+#endif
+}
+
+/**
+ * Transport which plays back recorded controller bytes.
+ *
+ * While not started (online and offline packets of ActroidBase's
+ * constructor and destructor), every write is acked. While started,
+ * recorded bytes become readable at their recorded time plus the replay
+ * offset, or at once in fast mode.
+ */
+class ReplayTransport : public Transport {
+private:
+  const std::vector<RxByte>& m_Rx;
+  size_t m_Next;
+  bool m_Started;
+  bool m_Fast;
+  uint64_t m_Offset;
+  int m_Ack;
+  const Packet* m_pExpected;
+  long m_Mismatch;
+
+  bool _isReadable(const uint64_t now) {
+    if (m_Ack > 0) {
+      return true;
+    }
+    if (!m_Started || m_Next >= m_Rx.size()) {
+      return false;
+    }
+    return m_Fast || m_Rx[m_Next].time + m_Offset <= now;
+  }
+
+  /**
+   * Wait until a byte is readable or deadline passes.
+   */
+  bool _waitUntil(const uint64_t deadline) {
+    uint64_t now = monotonicNanos();
+    if (_isReadable(now)) {
+      return true;
+    }
+    if (m_Fast || !m_Started || m_Next >= m_Rx.size()) {
+      return false;
+    }
+    uint64_t next = m_Rx[m_Next].time + m_Offset;
+    if (next > deadline) {
+      _sleepUntil(deadline);
+      return false;
+    }
+    _sleepUntil(next);
+    return true;
+  }
+
+public:
+  ReplayTransport(const std::vector<RxByte>& rx)
+    : m_Rx(rx), m_Next(0), m_Started(false), m_Fast(false), m_Offset(0),
+      m_Ack(0), m_pExpected(NULL), m_Mismatch(0) {}
+
+  virtual ~ReplayTransport() {}
+
+  /**
+   * Start playback. Recorded time 'origin' is mapped to now.
+   */
+  void start(const bool fast, const uint64_t origin) {
+    m_Next = 0;
+    m_Started = true;
+    m_Fast = fast;
+    m_Offset = monotonicNanos() - origin;
+    m_Ack = 0;
+  }
+
+  void stop() {
+    m_Started = false;
+  }
+
+  uint64_t getOffset() const {
+    return m_Offset;
+  }
+
+  /**
+   * Recorded packet which the next write should match.
+   */
+  void expect(const Packet* pPacket) {
+    m_pExpected = pPacket;
+  }
+
+  /**
+   * Drop n recorded bytes, e.g. the ack of a packet which is not replayed.
+   */
+  void skip(const int n) {
+    m_Next += n;
+    if (m_Next > m_Rx.size()) {
+      m_Next = m_Rx.size();
+    }
+  }
+
+  long getMismatchCount() const {
+    return m_Mismatch;
+  }
+
+  size_t getRemaining() const {
+    return m_Rx.size() - m_Next;
+  }
+
+  virtual void flushRxBuffer() {
+  }
+
+  virtual int write(const void* src, const unsigned int size) {
+    if (!m_Started) {
+      m_Ack++;
+      return size;
+    }
+    if (m_pExpected) {
+      if (m_pExpected->data.size() != size || memcmp(&m_pExpected->data[0], src, size) != 0) {
+	m_Mismatch++;
+      }
+      m_pExpected = NULL;
+    }
+    return size;
+  }
+
+  virtual int writev(const IoBuffer* buffers, const int count) {
+    int total = 0;
+    for (int i = 0;i < count;i++) {
+      total += write(buffers[i].data, buffers[i].size);
+    }
+    return total;
+  }
+
+  virtual bool waitForRxData(const int timeoutMs) {
+    uint64_t deadline = timeoutMs < 0 ? (uint64_t)-1 : monotonicNanos() + (uint64_t)timeoutMs * 1000000;
+    return _waitUntil(deadline);
+  }
+
+  virtual int readExact(void *dst, const unsigned int size, const int timeoutMs) {
+    uint64_t deadline = timeoutMs < 0 ? (uint64_t)-1 : monotonicNanos() + (uint64_t)timeoutMs * 1000000;
+    unsigned int received = 0;
+    for (;;) {
+      received += readAvailable((uint8_t*)dst + received, size - received);
+      if (received == size) {
+	return size;
+      }
+      if (!_waitUntil(deadline)) {
+	throw ComTimeoutException();
+      }
+    }
+  }
+
+  virtual int readAvailable(void *dst, const unsigned int maxSize) {
+    uint8_t* buf = (uint8_t*)dst;
+    uint64_t now = monotonicNanos();
+    unsigned int n = 0;
+    while (n < maxSize && _isReadable(now)) {
+      if (m_Ack > 0) {
+	m_Ack--;
+	buf[n++] = ActroidModel::ACK;
+      } else {
+	buf[n++] = m_Rx[m_Next++].data;
+      }
+    }
+    return n;
+  }
+};
+
+/**
+ * Read records of the trace, oldest first.
+ */
+static bool _load(const char* fileName, std::vector<TraceRecord>& records)
+{
+  FILE* fp = fopen(fileName, "rb");
+  if (!fp) {
+    fprintf(stderr, "Can not open %s\n", fileName);
+    return false;
+  }
+  TraceHeader header;
+  if (fread(&header, sizeof(header), 1, fp) != 1 ||
+      memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.recordSize != sizeof(TraceRecord) || header.capacity == 0) {
+    fprintf(stderr, "%s is not a trace file.\n", fileName);
+    fclose(fp);
+    return false;
+  }
+  std::vector<TraceRecord> ring(header.count < header.capacity ? header.count : header.capacity);
+  if (!ring.empty() && fread(&ring[0], sizeof(TraceRecord), ring.size(), fp) != ring.size()) {
+    fprintf(stderr, "%s is truncated.\n", fileName);
+    fclose(fp);
+    return false;
+  }
+  fclose(fp);
+  uint64_t first = header.count > header.capacity ? header.count - header.capacity : 0;
+  for (uint64_t i = first;i < header.count;i++) {
+    records.push_back(ring[i % header.capacity]);
+  }
+  return true;
+}
+
+/**
+ * Split TX bytes into packets and collect RX bytes which follow the first packet.
+ * @return number of TX bytes which are not part of a known packet.
+ */
+static long _parse(const std::vector<TraceRecord>& records, std::vector<Packet>& packets, std::vector<RxByte>& rx)
+{
+  std::vector<RxByte> tx;
+  for (size_t i = 0;i < records.size();i++) {
+    const TraceRecord& r = records[i];
+    for (int j = 0;j < r.size;j++) {
+      RxByte b = {r.time, r.data[j]};
+      if (r.direction == TRACE_TX) {
+	tx.push_back(b);
+      } else if (!tx.empty()) {
+	// bytes before the first request answer packets which were overwritten.
+	rx.push_back(b);
+      }
+    }
+  }
+
+  long skipped = 0;
+  size_t i = 0;
+  while (i < tx.size()) {
+    size_t size = 0;
+    if (tx[i].data == ActroidModel::START && i + 1 < tx.size()) {
+      switch (tx[i+1].data) {
+      case ActroidModel::SET: size = ActroidBase::NUM_JOINT + 5; break;
+      case ActroidModel::GET: size = 5; break;
+      case ActroidModel::ONLINE:
+      case ActroidModel::OFFLINE: size = 3; break;
+      }
+    }
+    if (size == 0 || i + size > tx.size()) {
+      skipped++;
+      i++;
+      continue;
+    }
+    Packet p;
+    p.time = tx[i].time;
+    for (size_t j = 0;j < size;j++) {
+      p.data.push_back(tx[i+j].data);
+    }
+    packets.push_back(p);
+    i += size;
+  }
+  return skipped;
+}
+
+static void _usage(const char* name)
+{
+  fprintf(stderr,
+	  "usage: %s [-f] [-r repeat] [-v] trace_file\n"
+	  "  -f  replay as fast as possible instead of at recorded time\n"
+	  "  -r  replay the trace repeat times (1)\n"
+	  "  -v  print each error\n",
+	  name);
+}
+
+int main(int argc, char** argv)
+{
+  bool fast = false;
+  bool verbose = false;
+  int repeat = 1;
+  const char* fileName = NULL;
+  for (int i = 1;i < argc;i++) {
+    if (strcmp(argv[i], "-f") == 0) {
+      fast = true;
+    } else if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else if (argv[i][0] != '-' && fileName == NULL) {
+      fileName = argv[i];
+    } else {
+      _usage(argv[0]);
+      return 1;
+    }
+  }
+  if (fileName == NULL || repeat < 1) {
+    _usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<TraceRecord> records;
+  if (!_load(fileName, records)) {
+    return 1;
+  }
+  std::vector<Packet> packets;
+  std::vector<RxByte> rx;
+  long skipped = _parse(records, packets, rx);
+  if (packets.empty()) {
+    fprintf(stderr, "%s has no packet.\n", fileName);
+    return 1;
+  }
+
+  long sets = 0, gets = 0, errors = 0;
+  uint64_t elapsed = 0;
+  size_t remaining = 0;
+  long mismatch = 0;
+  try {
+    ReplayTransport transport(rx);
+    ActroidBase actroid(&transport);
+    actroid.setSuppressUnchanged(false);
+    actroid.setKeepAliveInterval(0);
+
+    for (int n = 0;n < repeat;n++) {
+      transport.start(fast, packets[0].time);
+      uint64_t start = monotonicNanos();
+      for (size_t i = 0;i < packets.size();i++) {
+	const Packet& p = packets[i];
+	if (!fast) {
+	  _sleepUntil(p.time + transport.getOffset());
+	}
+	transport.expect(&p);
+	try {
+	  switch (p.data[1]) {
+	  case ActroidModel::SET:
+	    for (int j = 0;j < ActroidBase::NUM_JOINT;j++) {
+	      actroid.setTargetRawAngle(j, p.data[3 + j]);
+	    }
+	    actroid.updateTargetAngles();
+	    sets++;
+	    break;
+	  case ActroidModel::GET:
+	    actroid.updateCurrentAngles(p.data[2], p.data[3]);
+	    gets++;
+	    break;
+	  default:
+	    // online and offline are sent by ActroidBase itself. drop their ack.
+	    transport.expect(NULL);
+	    transport.skip(1);
+	    break;
+	  }
+	} catch (ActroidException& e) {
+	  errors++;
+	  if (verbose) {
+	    fprintf(stderr, "packet %d: %s\n", (int)i, e.what());
+	  }
+	}
+      }
+      elapsed += monotonicNanos() - start;
+      remaining += transport.getRemaining();
+      transport.stop();
+    }
+    mismatch = transport.getMismatchCount();
+  } catch (ActroidException& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  const long ops = (long)packets.size() * repeat;
+  printf("{\"name\": \"replay\", \"mode\": \"%s\", \"records\": %d, \"packets\": %ld, "
+	 "\"sets\": %ld, \"gets\": %ld, \"errors\": %ld, \"tx_mismatch\": %ld, "
+	 "\"tx_skipped\": %ld, \"rx_left\": %ld, \"elapsed_sec\": %.6f, \"packets_per_sec\": %.1f}\n",
+	 fast ? "fast" : "recorded", (int)records.size(), ops,
+	 sets, gets, errors, mismatch, skipped * repeat, (long)remaining,
+	 elapsed / 1e9, ops * 1e9 / elapsed);
+  return errors == 0 && mismatch == 0 ? 0 : 2;
+}
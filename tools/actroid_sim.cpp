@@ -0,0 +1,87 @@
+/**
+ * @file actroid_sim.cpp
+ * @brief Simulated Actroid controller on a pseudo terminal
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ *
+ * Prints the name of the pseudo terminal, then serves the Actroid protocol
+ * on it until interrupted. Set the "port" configuration of the RTC (or the
+ * port of ActroidBase) to the printed name.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "SerialPort.h"
+#include "ActroidSimulator.h"
+
+using namespace ogata_lab;
+
+static volatile sig_atomic_t _interrupted = 0;
+
+static void _onSignal(int)
+{
+  _interrupted = 1;
+}
+
+static void _usage(const char* name)
+{
+  fprintf(stderr,
+	  "usage: %s [options]\n"
+	  "  -b <baud>     baud rate of the simulated link, 0 for no delay (115200)\n"
+	  "  -l <ms>       servo time constant (0)\n"
+	  "  -L <us>       controller latency before each reply (0)\n"
+	  "  -n <rate>     probability of NACK (0)\n"
+	  "  -d <rate>     probability of dropped reply (0)\n"
+	  "  -c <rate>     probability of corrupted reply byte (0)\n"
+	  "  -s <seed>     random seed of fault injection (1)\n",
+	  name);
+}
+
+int main(int argc, char** argv)
+{
+  ActroidSimulator simulator;
+  for (int i = 1;i < argc;i++) {
+    if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+      _usage(argv[0]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    switch (argv[i-1][1]) {
+    case 'b': simulator.setBaudrate(atoi(value)); break;
+    case 'l': simulator.setServoLag(atof(value)); break;
+    case 'L': simulator.setLatency(atoi(value)); break;
+    case 'n': simulator.setNackRate(atof(value)); break;
+    case 'd': simulator.setDropRate(atof(value)); break;
+    case 'c': simulator.setCorruptRate(atof(value)); break;
+    case 's': simulator.setSeed(strtoul(value, NULL, 10)); break;
+    default:
+      _usage(argv[0]);
+      return 1;
+    }
+  }
+
+  signal(SIGINT, _onSignal);
+  signal(SIGTERM, _onSignal);
+  try {
+    PtySimulator pty(&simulator);
+    printf("%s\n", pty.getSlaveName().c_str());
+    fflush(stdout);
+
+    pty.start();
+    while (!_interrupted) {
+      net::ysuga::Thread::sleep(100);
+    }
+    pty.stop();
+  } catch (net::ysuga::ComException& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  fprintf(stderr, "set %ld get %ld nack %ld drop %ld corrupt %ld frame error %ld\n",
+	  simulator.getSetCount(), simulator.getGetCount(), simulator.getNackCount(),
+	  simulator.getDropCount(), simulator.getCorruptCount(), simulator.getFrameErrorCount());
+  return 0;
+}
@@ -0,0 +1,398 @@
+/**
+ * @file actroidd.cpp
+ * @brief Daemon which owns the serial port of an Actroid
+ * @license GPL for commercial. LGPL for non-commercial.
+ * @date 2026/10/17
+ *
+ * Opens the serial port with ActroidBase and runs its I/O thread. Every
+ * period, the targets written by clients to the shared memory /<name>
+ * are handed to the thread and the newest angles are published there,
+ * so that controllers in any number of processes share one robot (see
+ * ActroidClient, or the daemon configuration of the RTC).
+ *
+ * Requests, one line each, are answered on the Unix socket
+ * /tmp/<name>.sock with "ok ..." or "error <message>":
+ *
+ *   status          port, connected, stale, io_cycle, connections
+ *   telemetry       nack, timeout, frame_error, resync, reconnect, suppressed
+ *   reopen <port>   close the serial port and open <port> instead
+ *   trajectory <linear|cubic> <count> <t0> <angles of 0> <t1> ...
+ *                   move along count waypoints, as ActroidBase::setTrajectory()
+ *   trajectory stop stop the trajectory where it is now
+ *   stop            exit
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include "ActroidBase.h"
+#include "SharedRegion.h"
+
+using namespace ogata_lab;
+using namespace net::ysuga;
+
+#define MAX_CONNECTIONS 16
+
+/**
+ * Bytes of requests or replies a connection may leave buffered; a client
+ * which does not read its replies is disconnected at this limit.
+ */
+#define MAX_BUFFERED 65536
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static volatile sig_atomic_t _interrupted = 0;
+
+static void _onSignal(int)
+{
+  _interrupted = 1;
+}
+
+static void _usage(const char* name)
+{
+  fprintf(stderr,
+	  "usage: %s -p <port> [options]\n"
+	  "  -p <port>     serial port of the controller\n"
+	  "  -n <name>     instance name: shared memory /<name>, socket /tmp/<name>.sock (actroid)\n"
+	  "  -i <ms>       period of target and angle exchange (1)\n"
+	  "  -t <ms>       deadline of each reply (200)\n"
+	  "  -w <n>        command window of the I/O thread (0)\n"
+	  "  -k <ms>       keep-alive interval (1000)\n"
+	  "  -r <ms>       longest reconnect backoff, 0 to exit on link errors (1000)\n"
+	  "  -P <prio>     SCHED_FIFO priority of the I/O thread (0)\n"
+	  "  -C <cpus>     CPUs of the I/O thread, e.g. 3 or 2-3 (any)\n",
+	  name);
+}
+
+/**
+ * Control socket: accepts connections and answers their requests.
+ */
+class ControlServer {
+private:
+  struct Connection {
+    int fd;
+    std::string received;
+    std::string sending;
+  };
+
+  std::string m_Path;
+  int m_Listen;
+  std::vector<Connection> m_Connections;
+  bool m_StopRequested;
+
+  std::string _handle(const std::string& line, ActroidBase& actroid);
+  bool _receive(Connection& c, ActroidBase& actroid);
+  bool _send(Connection& c);
+
+public:
+  ControlServer(const char* name) throw(ActroidException);
+  ~ControlServer();
+
+  /**
+   * Wait for requests up to timeoutMs and answer them.
+   */
+  void serve(const int timeoutMs, ActroidBase& actroid);
+
+  bool isStopRequested() const {
+    return m_StopRequested;
+  }
+};
+
+ControlServer::ControlServer(const char* name) throw(ActroidException) :
+  m_Path(SharedRegion::socketPath(name)), m_Listen(-1), m_StopRequested(false)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (m_Path.size() >= sizeof(addr.sun_path)) {
+    throw ActroidException("Instance name is too long.");
+  }
+  strcpy(addr.sun_path, m_Path.c_str());
+
+  if ((m_Listen = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    throw ActroidException("Can not create control socket.");
+  }
+  // a socket left by a daemon which crashed is replaced, a live one is not.
+  if (connect(m_Listen, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+    close(m_Listen);
+    throw ActroidException("actroidd of this name is already running.");
+  }
+  close(m_Listen);
+  unlink(m_Path.c_str());
+  m_Listen = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (m_Listen < 0 || bind(m_Listen, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(m_Listen, 4) < 0) {
+    if (m_Listen >= 0) {
+      close(m_Listen);
+    }
+    throw ActroidException("Can not bind control socket.");
+  }
+}
+
+ControlServer::~ControlServer()
+{
+  for (size_t i = 0;i < m_Connections.size();i++) {
+    close(m_Connections[i].fd);
+  }
+  close(m_Listen);
+  unlink(m_Path.c_str());
+}
+
+void ControlServer::serve(const int timeoutMs, ActroidBase& actroid)
+{
+  struct pollfd fds[MAX_CONNECTIONS + 1];
+  fds[0].fd = m_Listen;
+  fds[0].events = POLLIN;
+  fds[0].revents = 0;
+  int n = 1;
+  for (size_t i = 0;i < m_Connections.size();i++, n++) {
+    fds[n].fd = m_Connections[i].fd;
+    fds[n].events = m_Connections[i].sending.empty() ? POLLIN : POLLIN | POLLOUT;
+    fds[n].revents = 0;
+  }
+  if (poll(fds, n, timeoutMs) <= 0) {
+    return;
+  }
+
+  // connections are matched to fds by index, so new ones are appended last.
+  for (int i = n - 1;i >= 1;i--) {
+    if (!fds[i].revents) {
+      continue;
+    }
+    Connection& c = m_Connections[i - 1];
+    bool open = true;
+    if (fds[i].revents & ~POLLOUT) {
+      open = _receive(c, actroid);
+    }
+    if (open && !c.sending.empty()) {
+      open = _send(c);
+    }
+    if (!open) {
+      close(c.fd);
+      m_Connections.erase(m_Connections.begin() + (i - 1));
+    }
+  }
+
+  if (fds[0].revents & POLLIN) {
+    int fd = accept(m_Listen, NULL, NULL);
+    if (fd >= 0) {
+      // the exchange of targets and angles must not wait for a client.
+      if (m_Connections.size() >= MAX_CONNECTIONS || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+        close(fd);
+      } else {
+        Connection c;
+        c.fd = fd;
+        m_Connections.push_back(c);
+      }
+    }
+  }
+}
+
+/**
+ * Read what the client has sent and queue the replies to its requests.
+ * @return false if the connection is to be closed.
+ */
+bool ControlServer::_receive(Connection& c, ActroidBase& actroid)
+{
+  char buffer[4096];
+  ssize_t len;
+  while ((len = read(c.fd, buffer, sizeof(buffer))) > 0) {
+    c.received.append(buffer, len);
+    std::string::size_type end;
+    while ((end = c.received.find('\n')) != std::string::npos) {
+      c.sending += _handle(c.received.substr(0, end), actroid) + "\n";
+      c.received.erase(0, end + 1);
+    }
+    if (c.received.size() > MAX_BUFFERED || c.sending.size() > MAX_BUFFERED) {
+      return false;
+    }
+  }
+  return len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+/**
+ * Send as much of the queued replies as the socket takes.
+ * @return false if the connection is to be closed.
+ */
+bool ControlServer::_send(Connection& c)
+{
+  ssize_t len = send(c.fd, c.sending.c_str(), c.sending.size(), MSG_NOSIGNAL);
+  if (len < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  }
+  c.sending.erase(0, len);
+  return true;
+}
+
+std::string ControlServer::_handle(const std::string& line, ActroidBase& actroid)
+{
+  std::istringstream is(line);
+  std::string request;
+  is >> request;
+  std::ostringstream os;
+  try {
+    if (request == "status") {
+      os << "ok port=" << actroid.getPortName()
+         << " connected=" << (actroid.isConnected() ? 1 : 0)
+         << " stale=" << (actroid.isStale() ? 1 : 0)
+         << " io_cycle=" << actroid.getIoCycleCount()
+         << " connections=" << m_Connections.size();
+    } else if (request == "telemetry") {
+      Telemetry& telemetry = actroid.getTelemetry();
+      os << "ok nack=" << telemetry.getCount(COUNTER_NACK)
+         << " timeout=" << telemetry.getCount(COUNTER_TIMEOUT)
+         << " frame_error=" << telemetry.getCount(COUNTER_FRAME_ERROR)
+         << " resync=" << telemetry.getCount(COUNTER_RESYNC)
+         << " reconnect=" << telemetry.getCount(COUNTER_RECONNECT)
+         << " suppressed=" << actroid.getSuppressedFrameCount();
+    } else if (request == "reopen") {
+      std::string port;
+      if (!(is >> port)) {
+        return "error Port is missing.";
+      }
+      actroid.stopIoThread();
+      try {
+        actroid.reopen(port.c_str());
+      } catch (ActroidException& e) {
+        // the I/O thread keeps trying to open it.
+        os << "error " << e.what();
+      }
+      actroid.startIoThread();
+      if (os.str().empty()) {
+        os << "ok";
+      }
+    } else if (request == "trajectory") {
+      std::string interpolation;
+      is >> interpolation;
+      if (interpolation == "stop") {
+        actroid.stopTrajectory();
+        return "ok";
+      }
+      if (interpolation != "linear" && interpolation != "cubic") {
+        return "error Unknown interpolation.";
+      }
+      int count = 0;
+      if (!(is >> count) || count < 1 || count > TRAJECTORY_MAX_WAYPOINTS) {
+        return "error Invalid number of waypoints.";
+      }
+      double time[TRAJECTORY_MAX_WAYPOINTS];
+      double angles[TRAJECTORY_MAX_WAYPOINTS * ActroidBase::NUM_JOINT];
+      for (int i = 0;i < count;i++) {
+        is >> time[i];
+        for (int j = 0;j < ActroidBase::NUM_JOINT;j++) {
+          is >> angles[i * ActroidBase::NUM_JOINT + j];
+        }
+      }
+      if (!is) {
+        return "error Waypoints are missing or not numbers.";
+      }
+      actroid.setTrajectory(time, angles, count,
+                            interpolation == "linear" ? INTERPOLATION_LINEAR : INTERPOLATION_CUBIC);
+      os << "ok";
+    } else if (request == "stop") {
+      m_StopRequested = true;
+      os << "ok";
+    } else {
+      os << "error Unknown request.";
+    }
+  } catch (ActroidException& e) {
+    return std::string("error ") + e.what();
+  }
+  return os.str();
+}
+
+int main(int argc, char** argv)
+{
+  const char* port = NULL;
+  const char* name = "actroid";
+  const char* cpus = "";
+  int period = 1;
+  int timeout = DEFAULT_TIMEOUT_MS;
+  int window = 0;
+  int keepAlive = DEFAULT_KEEPALIVE_MS;
+  int reconnectMax = 1000;
+  int priority = 0;
+  for (int i = 1;i < argc;i++) {
+    if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+      _usage(argv[0]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    switch (argv[i-1][1]) {
+    case 'p': port = value; break;
+    case 'n': name = value; break;
+    case 'i': period = atoi(value); break;
+    case 't': timeout = atoi(value); break;
+    case 'w': window = atoi(value); break;
+    case 'k': keepAlive = atoi(value); break;
+    case 'r': reconnectMax = atoi(value); break;
+    case 'P': priority = atoi(value); break;
+    case 'C': cpus = value; break;
+    default:
+      _usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!port || period < 1) {
+    _usage(argv[0]);
+    return 1;
+  }
+
+  signal(SIGINT, _onSignal);
+  signal(SIGTERM, _onSignal);
+  signal(SIGPIPE, SIG_IGN);
+  try {
+    ControlServer server(name);
+    ActroidBase actroid(port);
+    actroid.setTimeout(timeout);
+    actroid.setCommandWindow(window);
+    actroid.setKeepAliveInterval(keepAlive);
+    actroid.setReconnectBackoff(DEFAULT_RECONNECT_MIN_MS, reconnectMax);
+    actroid.setIoThreadPriority(priority);
+    actroid.setIoThreadAffinity(cpus);
+    SharedRegion region(name, true, ActroidBase::NUM_JOINT);
+
+    double target[ActroidBase::NUM_JOINT];
+    double current[ActroidBase::NUM_JOINT];
+    double estimated[ActroidBase::NUM_JOINT];
+    double age[ActroidBase::NUM_JOINT];
+    double variance[ActroidBase::NUM_JOINT];
+    actroid.updateTargetAngles();
+    actroid.startIoThread();
+    fprintf(stderr, "[actroidd] %s serves %s\n", name, port);
+
+    while (!_interrupted && !server.isStopRequested()) {
+      server.serve(period, actroid);
+      if (region.readTargets(target)) {
+        // joints no client has set yet keep their targets.
+        for (int i = 0;i < ActroidBase::NUM_JOINT;i++) {
+          if (target[i] == target[i]) {
+            actroid.setTargetAngle(i, target[i]);
+          }
+        }
+        actroid.updateTargetAngles();
+      }
+      actroid.updateCurrentAngles();
+      actroid.getCurrentAngles(current, ActroidBase::NUM_JOINT);
+      actroid.getEstimatedAngles(estimated, age, variance, ActroidBase::NUM_JOINT);
+      region.publishCurrent(current, age, variance, actroid.isStale(), actroid.getIoCycleCount());
+    }
+    actroid.stopIoThread();
+  } catch (ActroidException& e) {
+    fprintf(stderr, "[actroidd] %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}